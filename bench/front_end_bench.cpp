@@ -0,0 +1,328 @@
+//----------------------------------------------------------------------
+// FILE: front_end_bench.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Measures the throughput (lines/sec) and peak memory of each
+// front end phase on generated programs of increasing size, failing
+// if a phase slows down too much as programs grow. With --incremental,
+// also compares full compiles with incremental ones.
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "lexer.h"
+#include "ast_parser.h"
+#include "bytecode.h"
+#include "semantic_checker.h"
+#include "code_generator.h"
+#include "incremental.h"
+#include "program_generator.h"
+#include "thread_pool.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+
+// the phases, in order
+const vector<string> PHASES = {"lex", "parse", "check", "generate"};
+
+struct Result {
+  size_t functions = 0;
+  size_t lines = 0;
+  // best time (seconds) and peak memory (KiB) of each phase
+  vector<double> seconds = vector<double>(PHASES.size(), 1e30);
+  vector<long> peak_kb = vector<long>(PHASES.size(), 0);
+};
+
+// the ways of compiling a program, in order (see measure_incremental)
+const vector<string> COMPILES = {"full", "cold", "unchanged", "edited"};
+
+struct IncrementalResult {
+  // best time (seconds) of each way of compiling
+  vector<double> seconds = vector<double>(COMPILES.size(), 1e30);
+  // functions recompiled after the edit
+  size_t recompiled = 0;
+};
+
+
+void usage()
+{
+  cout << "Usage: ./front_end_bench [option]..." << endl;
+  cout << "Options:" << endl;
+  cout << "  --sizes n,n,... numbers of functions to generate (default"
+       << " 100,1000,4000)" << endl;
+  cout << "  --structs n structs per 10 functions (default 1)" << endl;
+  cout << "  --statements n statements per block (default 6)" << endl;
+  cout << "  --depth n nesting depth of blocks and expressions (default 3)"
+       << endl;
+  cout << "  --literals p chance of each operand being a literal (default"
+       << " 0.3)" << endl;
+  cout << "  --seed n random seed (default 1)" << endl;
+  cout << "  --repeat n runs of each phase, keeping the fastest (default 3)"
+       << endl;
+  cout << "  --jobs n parses, checks, and compiles on n threads" << endl;
+  cout << "  --max-slowdown x fails if a phase's lines/sec at the largest size"
+       << " is x times" << endl;
+  cout << "    lower than at the smallest (default 3)" << endl;
+  cout << "  --dump file writes the largest program to the file" << endl;
+  cout << "  --incremental also times full compiles against incremental"
+       << " ones" << endl;
+}
+
+
+// reset the peak resident set size of the process (linux only, where
+// writing 5 to clear_refs resets VmHWM)
+void reset_peak_rss()
+{
+  ofstream clear("/proc/self/clear_refs");
+  clear << "5" << endl;
+}
+
+
+// the peak resident set size of the process in KiB (0 if unknown)
+long peak_rss_kb()
+{
+  ifstream status("/proc/self/status");
+  string line;
+  while (getline(status, line))
+    if (line.starts_with("VmHWM:"))
+      return strtol(line.c_str() + 6, nullptr, 10);
+  return 0;
+}
+
+
+// run each phase over the program, keeping the best times
+void measure(const string& program, size_t repeat, ThreadPool* pool,
+             Result& r)
+{
+  auto source = SourceBuffer::from_string(program);
+  for (size_t i = 0; i < repeat; ++i) {
+    auto time = [&](size_t phase, auto&& body) {
+      reset_peak_rss();
+      auto start = chrono::steady_clock::now();
+      body();
+      chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+      r.seconds[phase] = min(r.seconds[phase], elapsed.count());
+      r.peak_kb[phase] = max(r.peak_kb[phase], peak_rss_kb());
+    };
+    time(0, [&]() {
+      Lexer lexer(source);
+      while (lexer.next_token().type() != TokenType::EOS)
+        ;
+    });
+    unique_ptr<Program> p;
+    time(1, [&]() {
+      p = make_unique<Program>(ASTParser(Lexer(source), pool).parse());
+    });
+    time(2, [&]() {
+      SemanticChecker checker(pool);
+      p->accept(checker);
+    });
+    time(3, [&]() {
+      VM vm;
+      CodeGenerator generator(vm, pool);
+      p->accept(generator);
+    });
+  }
+}
+
+
+// time compiling the program and writing its bytecode (as on a compile
+// cache miss) in full, and incrementally: with no saved state (cold),
+// with the state of the same program (unchanged), and after adding a
+// line to a function in the middle (edited)
+void measure_incremental(const string& program, size_t repeat,
+                         ThreadPool* pool, IncrementalResult& r)
+{
+  string edited = program;
+  size_t end = edited.find("\n}\n", edited.size() / 2);
+  if (end != string::npos)
+    edited.insert(end, "\n");
+  fs::path dir = fs::temp_directory_path();
+  string name = "front_end_bench_" + to_string(getpid());
+  string state = (dir / (name + ".mypli")).string();
+  string image = (dir / (name + BYTECODE_EXT)).string();
+  for (size_t i = 0; i < repeat; ++i) {
+    auto time = [&](size_t compile, auto&& body) {
+      auto start = chrono::steady_clock::now();
+      body();
+      chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+      r.seconds[compile] = min(r.seconds[compile], elapsed.count());
+    };
+    auto incrementally = [&](const string& text) {
+      IncrementalCompiler compiler;
+      compiler.load(state);
+      ASTParser parser(Lexer(SourceBuffer::from_string(text),
+                             compiler.symbols()), pool);
+      parser.set_fingerprinting(true);
+      Program p = parser.parse();
+      VM vm;
+      compiler.compile(p, vm, pool);
+      Bytecode::write(vm, image);
+      compiler.save(state, image);
+      r.recompiled = compiler.recompiled();
+    };
+    time(0, [&]() {
+      Program p = ASTParser(Lexer(SourceBuffer::from_string(program)),
+                            pool).parse();
+      SemanticChecker checker(pool);
+      p.accept(checker);
+      VM vm;
+      CodeGenerator generator(vm, pool);
+      p.accept(generator);
+      Bytecode::write(vm, image);
+    });
+    error_code ec;
+    fs::remove(state, ec);
+    time(1, [&]() { incrementally(program); });
+    time(2, [&]() { incrementally(program); });
+    time(3, [&]() { incrementally(edited); });
+  }
+  error_code ec;
+  fs::remove(state, ec);
+  fs::remove(image, ec);
+}
+
+
+int main(int argc, char* argv[])
+{
+  vector<size_t> sizes = {100, 1000, 4000};
+  size_t structs_per_ten = 1;
+  ProgramGenerator::Shape shape;
+  unsigned seed = 1;
+  size_t repeat = 3;
+  size_t jobs = 1;
+  double max_slowdown = 3.0;
+  string dump = "";
+  bool incremental = false;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--help") {
+      usage();
+      return 0;
+    }
+    if (arg == "--incremental") {
+      incremental = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      usage();
+      return 1;
+    }
+    string value = argv[++i];
+    if (arg == "--sizes") {
+      sizes.clear();
+      stringstream list(value);
+      string size;
+      while (getline(list, size, ','))
+        sizes.push_back(stoul(size));
+    }
+    else if (arg == "--structs")
+      structs_per_ten = stoul(value);
+    else if (arg == "--statements")
+      shape.statements = stoul(value);
+    else if (arg == "--depth")
+      shape.depth = stoul(value);
+    else if (arg == "--literals")
+      shape.literal_density = stod(value);
+    else if (arg == "--seed")
+      seed = stoul(value);
+    else if (arg == "--repeat")
+      repeat = max(1ul, stoul(value));
+    else if (arg == "--jobs")
+      jobs = stoul(value);
+    else if (arg == "--max-slowdown")
+      max_slowdown = stod(value);
+    else if (arg == "--dump")
+      dump = value;
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (sizes.empty()) {
+    usage();
+    return 1;
+  }
+  sort(sizes.begin(), sizes.end());
+
+  unique_ptr<ThreadPool> pool = nullptr;
+  if (jobs != 1)
+    pool = make_unique<ThreadPool>(jobs);
+
+  cout << left << setw(10) << "functions" << setw(10) << "lines";
+  for (const string& phase : PHASES)
+    cout << setw(22) << (phase + " lines/s (KiB)");
+  cout << endl;
+  vector<Result> results;
+  // the generated programs (when comparing incremental compiles)
+  vector<string> programs;
+  try {
+    for (size_t size : sizes) {
+      shape.functions = size;
+      shape.structs = max<size_t>(1, size * structs_per_ten / 10);
+      string program = ProgramGenerator(shape, seed).generate();
+      if (dump != "" and size == sizes.back())
+        ofstream(dump) << program;
+      Result r;
+      r.functions = size;
+      r.lines = count(program.begin(), program.end(), '\n');
+      measure(program, repeat, pool.get(), r);
+      cout << setw(10) << r.functions << setw(10) << r.lines;
+      for (size_t i = 0; i < PHASES.size(); ++i) {
+        stringstream cell;
+        cell << (long)(r.lines / r.seconds[i]) << " (" << r.peak_kb[i] << ")";
+        cout << setw(22) << cell.str();
+      }
+      cout << endl;
+      results.push_back(r);
+      if (incremental)
+        programs.push_back(std::move(program));
+    }
+    // case: compare full and incremental compiles
+    if (incremental) {
+      cout << endl << setw(10) << "functions" << setw(10) << "lines";
+      for (const string& compile : COMPILES)
+        cout << setw(14) << (compile + " ms");
+      cout << "recompiled" << endl;
+      for (size_t i = 0; i < programs.size(); ++i) {
+        IncrementalResult r;
+        measure_incremental(programs[i], repeat, pool.get(), r);
+        cout << setw(10) << results[i].functions << setw(10)
+             << results[i].lines;
+        for (double seconds : r.seconds)
+          cout << setw(14) << fixed << setprecision(1) << seconds * 1000;
+        cout << r.recompiled << endl;
+      }
+    }
+  } catch (MyPLException& ex) {
+    cerr << ex.what() << endl;
+    return 1;
+  }
+
+  // case: compare the smallest and largest sizes
+  int status = 0;
+  const Result& small = results.front();
+  const Result& large = results.back();
+  for (size_t i = 0; i < PHASES.size() and results.size() > 1; ++i) {
+    double slowdown = (small.lines / small.seconds[i]) /
+      (large.lines / large.seconds[i]);
+    if (slowdown > max_slowdown) {
+      cout << "FAIL: " << PHASES[i] << " lines/s fell " << fixed
+           << setprecision(1) << slowdown << "x from " << small.functions
+           << " to " << large.functions << " functions" << endl;
+      status = 1;
+    }
+  }
+  return status;
+}
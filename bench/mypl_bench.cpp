@@ -0,0 +1,286 @@
+//----------------------------------------------------------------------
+// FILE: mypl_bench.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Runs the benchmark programs through the vm, reporting the
+// instructions executed, run time, and allocations of each, optionally
+// comparing them against (or saving them as) a baseline.
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "lexer.h"
+#include "ast_parser.h"
+#include "semantic_checker.h"
+#include "code_generator.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+
+// allocations made while counting is on (the vm runs on one thread)
+bool counting = false;
+uint64_t allocations = 0;
+uint64_t allocated_bytes = 0;
+
+void* operator new(size_t size)
+{
+  if (counting) {
+    ++allocations;
+    allocated_bytes += size;
+  }
+  void* p = malloc(size == 0 ? 1 : size);
+  if (p == nullptr)
+    throw bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+
+struct Result {
+  string name;
+  uint64_t instructions = 0;
+  // best run time (seconds)
+  double seconds = 0;
+  uint64_t allocations = 0;
+  uint64_t allocated_bytes = 0;
+  // hash of the program's output
+  string output;
+};
+
+
+void usage()
+{
+  cout << "Usage: ./mypl_bench [option]... [script-file]..." << endl;
+  cout << "Runs the given programs (default the programs in " << MYPL_BENCH_DIR
+       << ")" << endl;
+  cout << "Options:" << endl;
+  cout << "  --repeat n runs of each program, keeping the fastest (default 3)"
+       << endl;
+  cout << "  --baseline file compares against the results saved in the file"
+       << endl;
+  cout << "  --tolerance x fails if a program is x times slower than its"
+       << " baseline (default 1.5)" << endl;
+  cout << "  --save file saves the results to the file (as a new baseline)"
+       << endl;
+}
+
+
+// 64-bit FNV-1a of the text, in hex
+string hash_of(const string& text)
+{
+  uint64_t h = 14695981039346656037ull;
+  for (unsigned char c : text) {
+    h ^= c;
+    h *= 1099511628211ull;
+  }
+  stringstream s;
+  s << hex << setw(16) << setfill('0') << h;
+  return s.str();
+}
+
+
+// compile the program into the vm
+void compile(const string& path, VM& vm)
+{
+  auto source = SourceBuffer::from_file(path);
+  if (source == nullptr)
+    throw MyPLException::VMError("unable to read '" + path + "'");
+  Program p = ASTParser(Lexer(source)).parse();
+  SemanticChecker checker;
+  p.accept(checker);
+  CodeGenerator generator(vm);
+  p.accept(generator);
+}
+
+
+// run the program repeat times (each in a new vm), keeping the fastest
+Result measure(const string& path, size_t repeat)
+{
+  Result r;
+  r.name = fs::path(path).stem().string();
+  for (size_t i = 0; i < repeat; ++i) {
+    VM vm;
+    compile(path, vm);
+    stringstream out;
+    streambuf* saved = cout.rdbuf(out.rdbuf());
+    allocations = 0;
+    allocated_bytes = 0;
+    auto start = chrono::steady_clock::now();
+    counting = true;
+    try {
+      vm.run();
+    } catch (...) {
+      counting = false;
+      cout.rdbuf(saved);
+      throw;
+    }
+    counting = false;
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    cout.rdbuf(saved);
+    if (i == 0 or elapsed.count() < r.seconds)
+      r.seconds = elapsed.count();
+    r.instructions = vm.instruction_count();
+    r.allocations = allocations;
+    r.allocated_bytes = allocated_bytes;
+    r.output = hash_of(out.str());
+  }
+  return r;
+}
+
+
+// the results saved in a baseline file, by name
+map<string, Result> read_baseline(const string& path)
+{
+  map<string, Result> results;
+  ifstream in(path);
+  if (!in)
+    throw MyPLException::VMError("unable to read baseline '" + path + "'");
+  string line;
+  while (getline(in, line)) {
+    if (line == "" or line[0] == '#')
+      continue;
+    stringstream fields(line);
+    Result r;
+    fields >> r.name >> r.instructions >> r.seconds >> r.allocations
+           >> r.allocated_bytes >> r.output;
+    results[r.name] = r;
+  }
+  return results;
+}
+
+
+void write_baseline(const string& path, const vector<Result>& results)
+{
+  ofstream out(path);
+  out << "# name instructions seconds allocations allocated-bytes output-hash"
+      << endl;
+  for (const Result& r : results)
+    out << r.name << " " << r.instructions << " " << r.seconds << " "
+        << r.allocations << " " << r.allocated_bytes << " " << r.output
+        << endl;
+}
+
+
+// percent change from old to new (as text)
+string change(double old_value, double new_value)
+{
+  if (old_value == 0)
+    return new_value == 0 ? "+0%" : "new";
+  stringstream s;
+  double percent = (new_value - old_value) * 100 / old_value;
+  s << (percent >= 0 ? "+" : "") << fixed << setprecision(1) << percent << "%";
+  return s.str();
+}
+
+
+int main(int argc, char* argv[])
+{
+  size_t repeat = 3;
+  string baseline = "";
+  string save = "";
+  double tolerance = 1.5;
+  vector<string> paths;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--help") {
+      usage();
+      return 0;
+    }
+    if (!arg.starts_with("--")) {
+      paths.push_back(arg);
+      continue;
+    }
+    if (i + 1 >= argc) {
+      usage();
+      return 1;
+    }
+    string value = argv[++i];
+    if (arg == "--repeat")
+      repeat = max(1ul, stoul(value));
+    else if (arg == "--baseline")
+      baseline = value;
+    else if (arg == "--tolerance")
+      tolerance = stod(value);
+    else if (arg == "--save")
+      save = value;
+    else {
+      usage();
+      return 1;
+    }
+  }
+  if (paths.empty()) {
+    error_code ec;
+    for (const auto& f : fs::directory_iterator(MYPL_BENCH_DIR, ec))
+      if (f.path().extension() == ".mypl")
+        paths.push_back(f.path().string());
+    sort(paths.begin(), paths.end());
+  }
+
+  int status = 0;
+  try {
+    map<string, Result> base;
+    if (baseline != "")
+      base = read_baseline(baseline);
+    cout << left << setw(16) << "program" << right << setw(14) << "instructions"
+         << setw(12) << "seconds" << setw(12) << "Minstr/s" << setw(14)
+         << "allocations" << setw(16) << "alloc bytes";
+    if (baseline != "")
+      cout << "   vs baseline (time, instructions, allocations)";
+    cout << endl;
+    vector<Result> results;
+    for (const string& path : paths) {
+      Result r = measure(path, repeat);
+      cout << left << setw(16) << r.name << right << setw(14)
+           << r.instructions << setw(12) << fixed << setprecision(4)
+           << r.seconds << setw(12) << setprecision(2)
+           << (r.instructions / r.seconds / 1e6) << setw(14) << r.allocations
+           << setw(16) << r.allocated_bytes;
+      auto old = base.find(r.name);
+      if (old != base.end()) {
+        const Result& b = old->second;
+        cout << "   " << change(b.seconds, r.seconds) << ", "
+             << change(b.instructions, r.instructions) << ", "
+             << change(b.allocations, r.allocations);
+        if (r.output != b.output) {
+          cout << "  FAIL: output changed";
+          status = 1;
+        }
+        else if (r.seconds > b.seconds * tolerance) {
+          cout << "  FAIL: slower than baseline";
+          status = 1;
+        }
+      }
+      else if (baseline != "")
+        cout << "   (not in baseline)";
+      cout << endl;
+      results.push_back(r);
+    }
+    if (save != "")
+      write_baseline(save, results);
+  } catch (MyPLException& ex) {
+    cerr << ex.what() << endl;
+    return 1;
+  }
+  return status;
+}
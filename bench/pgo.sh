@@ -0,0 +1,31 @@
+#!/bin/sh
+#----------------------------------------------------------------------
+# FILE: pgo.sh
+# DATE: CPSC 326, Spring 2023
+# AUTH: Jackie Ramsey
+# DESC: Builds an optimized (release, LTO, and profile guided) mypl and
+# mypl_bench, training on the benchmark programs.
+#   usage: bench/pgo.sh [build-dir]   (default _pgo_build)
+#----------------------------------------------------------------------
+
+set -e
+src=$(cd "$(dirname "$0")/.." && pwd)
+build=${1:-$src/_pgo_build}
+profiles="$build/profiles"
+
+# instrumented build
+rm -rf "$profiles"
+cmake -S "$src" -B "$build" -DCMAKE_BUILD_TYPE=Release -DMYPL_LTO=ON \
+  -DMYPL_PGO=generate -DMYPL_PGO_DIR="$profiles"
+cmake --build "$build" -j --target mypl mypl_bench
+
+# training runs (each target's objects get their own profiles)
+"$build/mypl_bench" --repeat 1
+for f in "$src"/bench/programs/*.mypl; do
+  "$build/mypl" --no-cache "$f" > /dev/null
+done
+
+# optimized build
+cmake -S "$src" -B "$build" -DMYPL_PGO=use
+cmake --build "$build" -j --target mypl mypl_bench
+"$build/mypl_bench"
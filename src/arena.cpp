@@ -0,0 +1,85 @@
+//----------------------------------------------------------------------
+// FILE: arena.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Arena implementation
+//----------------------------------------------------------------------
+
+#include "arena.h"
+
+using namespace std;
+
+
+namespace {
+
+  // the current arena of each thread
+  thread_local Arena* current_arena = nullptr;
+
+}
+
+
+Arena::~Arena()
+{
+  // destroy in reverse order of construction
+  for (Cleanup* c = cleanups; c != nullptr; c = c->next)
+    c->destroy(c->object);
+}
+
+
+Arena* Arena::current()
+{
+  return current_arena;
+}
+
+
+Arena::Scope::Scope(Arena* arena)
+  : previous {current_arena}
+{
+  current_arena = arena;
+}
+
+
+Arena::Scope::~Scope()
+{
+  current_arena = previous;
+}
+
+
+void Arena::adopt(shared_ptr<Arena> other)
+{
+  adopted.push_back(other);
+}
+
+
+size_t Arena::size() const
+{
+  size_t total = used;
+  for (const shared_ptr<Arena>& other : adopted)
+    total += other->size();
+  return total;
+}
+
+
+size_t Arena::block_count() const
+{
+  return blocks.size();
+}
+
+
+void* Arena::allocate(size_t size, size_t align)
+{
+  size_t padding = (align - (size_t)curr % align) % align;
+  if (curr == nullptr or padding + size > remaining) {
+    // worst case padding for the fresh block
+    size_t block_size = max(BLOCK_SIZE, size + align);
+    blocks.push_back(make_unique_for_overwrite<char[]>(block_size));
+    curr = blocks.back().get();
+    remaining = block_size;
+    padding = (align - (size_t)curr % align) % align;
+  }
+  void* p = curr + padding;
+  curr += padding + size;
+  remaining -= padding + size;
+  used += size;
+  return p;
+}
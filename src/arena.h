@@ -0,0 +1,160 @@
+//----------------------------------------------------------------------
+// FILE: arena.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Bump allocator that owns a program's AST nodes. Nodes are
+// carved out of large blocks and all freed together with the arena.
+//----------------------------------------------------------------------
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+class Arena
+{
+public:
+
+  // bytes per block (larger objects get a block of their own)
+  static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+  Arena() = default;
+
+  // runs the destructors of all objects made in the arena
+  ~Arena();
+
+  // arenas are shared (via shared_ptr) but never copied
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // construct a new object in the arena (owned by the arena)
+  template<typename T, typename... Args>
+  T* make(Args&&... args);
+
+  // return uninitialized, suitably aligned storage (freed with the
+  // arena)
+  void* allocate(size_t size, size_t align);
+
+  // the arena that new ArenaAllocators on this thread use (or nullptr
+  // for the heap)
+  static Arena* current();
+
+  // makes an arena the current one for the lifetime of the scope
+  class Scope
+  {
+  public:
+    Scope(Arena* arena);
+    ~Scope();
+  private:
+    Arena* previous;
+  };
+
+  // keep another arena (e.g., of a separately parsed chunk) alive for
+  // as long as this one
+  void adopt(std::shared_ptr<Arena> other);
+
+  // total bytes handed out by the arena (including adopted arenas)
+  size_t size() const;
+
+  // number of blocks allocated from the heap
+  size_t block_count() const;
+
+private:
+
+  // a destructor to run when the arena is freed (stored in the arena
+  // right before the object)
+  struct Cleanup {
+    void (*destroy)(void*);
+    void* object;
+    Cleanup* next;
+  };
+
+  // the blocks, with the free space left in the last one
+  std::vector<std::unique_ptr<char[]>> blocks;
+  char* curr = nullptr;
+  size_t remaining = 0;
+  size_t used = 0;
+
+  // most recently made object needing a destructor
+  Cleanup* cleanups = nullptr;
+
+  // arenas owned by this one
+  std::vector<std::shared_ptr<Arena>> adopted;
+
+};
+
+
+// Standard allocator that takes storage from an arena (never freeing
+// it individually). Defaults to the current arena, and falls back to
+// the heap if there is none, so containers copied outside of a scope
+// don't point into an arena.
+template<typename T>
+class ArenaAllocator
+{
+public:
+
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  ArenaAllocator() : arena {Arena::current()} {}
+  ArenaAllocator(Arena* arena) : arena {arena} {}
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena {other.arena} {}
+
+  T* allocate(size_t n)
+  {
+    if (arena == nullptr)
+      return std::allocator<T>().allocate(n);
+    return (T*)arena->allocate(n * sizeof(T), alignof(T));
+  }
+
+  void deallocate(T* p, size_t n)
+  {
+    if (arena == nullptr)
+      std::allocator<T>().deallocate(p, n);
+  }
+
+  ArenaAllocator select_on_container_copy_construction() const
+  {
+    return ArenaAllocator();
+  }
+
+  template<typename U>
+  bool operator==(const ArenaAllocator<U>& other) const
+  {
+    return arena == other.arena;
+  }
+
+  // the arena to allocate from (or nullptr for the heap)
+  Arena* arena;
+
+};
+
+
+template<typename T, typename... Args>
+T* Arena::make(Args&&... args)
+{
+  if constexpr (std::is_trivially_destructible_v<T>)
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  else {
+    Cleanup* c = (Cleanup*)allocate(sizeof(Cleanup), alignof(Cleanup));
+    T* obj = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    // only registered once constructed (so a throwing constructor
+    // doesn't leave a half-built object to destroy)
+    c->destroy = [](void* p) {((T*)p)->~T();};
+    c->object = obj;
+    c->next = cleanups;
+    cleanups = c;
+    return obj;
+  }
+}
+
+
+#endif
@@ -7,7 +7,8 @@
 
 
 // NOTE: Guiding principle is to use heap as little as possible and
-// only use pointers when necessary
+// only use pointers when necessary. Nodes that are pointed to are
+// allocated from (and owned by) the program's arena.
 
 
 #ifndef AST_H
@@ -16,9 +17,17 @@
 #include <vector>
 #include <memory>
 #include <optional>
+#include "arena.h"
+#include "interner.h"
+#include "source_buffer.h"
 #include "token.h"
 
 
+// a list of child nodes (stored in the program's arena when parsed)
+template<typename T>
+using ASTList = std::vector<T, ArenaAllocator<T>>;
+
+
 // forward declarations
 class Program;
 class FunDef;
@@ -109,6 +118,12 @@ public:
 class Program : public ASTNode
 {
 public:
+  // the text that the program's tokens refer to
+  std::shared_ptr<const SourceBuffer> source;
+  // the symbols of the program's identifiers and type names
+  std::shared_ptr<Interner> symbols;
+  // owns the program's nodes and child lists
+  std::shared_ptr<Arena> arena = std::make_shared<Arena>();
   std::vector<StructDef> struct_defs;
   std::vector<FunDef> fun_defs;
   void accept(Visitor& v) { v.visit(*this); }
@@ -119,7 +134,10 @@ class DataType
 {
 public:
   bool is_array = false;
-  std::string type_name;
+  // the interned type name
+  Symbol type_id = Symbols::NONE;
+  std::string_view type_name(const Interner& symbols) const
+  {return symbols.name(type_id);}
 };
 
 
@@ -131,11 +149,25 @@ public:
   Token first_token() {return var_name;}
 };
 
+// the tokens of a top-level definition (filled in when the parser is
+// fingerprinting)
+class Fingerprint
+{
+public:
+  // hash of the source text from the first token through the last,
+  // and the first token's column (0 if not fingerprinted)
+  uint64_t tokens = 0;
+  // the identifiers in the tokens
+  std::vector<Symbol> names;
+};
+
+
 class StructDef : public ASTNode
 {
 public:
   Token struct_name;
-  std::vector<VarDef> fields;
+  ASTList<VarDef> fields;
+  Fingerprint fingerprint;
   void accept(Visitor& v) { v.visit(*this); }  
 };
 
@@ -145,8 +177,9 @@ class FunDef : public ASTNode
 public:
   DataType return_type;
   Token fun_name;
-  std::vector<VarDef> params;
-  std::vector<std::shared_ptr<Stmt>> stmts;
+  ASTList<VarDef> params;
+  ASTList<Stmt*> stmts;
+  Fingerprint fingerprint;
   void accept(Visitor& v) { v.visit(*this); }  
 };
 
@@ -160,9 +193,9 @@ class Expr : public ASTNode
 {
 public:
   bool negated = false;
-  std::shared_ptr<ExprTerm> first = nullptr;
+  ExprTerm* first = nullptr;
   std::optional<Token> op = std::nullopt;
-  std::shared_ptr<Expr> rest = nullptr;
+  Expr* rest = nullptr;
   void accept(Visitor& v) { v.visit(*this); }  
   Token first_token() {return first->first_token();}
 };
@@ -170,7 +203,7 @@ public:
 class SimpleTerm : public ExprTerm
 {
 public:
-  std::shared_ptr<RValue> rvalue = nullptr;
+  RValue* rvalue = nullptr;
   void accept(Visitor& v) { v.visit(*this); }
   Token first_token() {return rvalue->first_token();}
 };
@@ -215,7 +248,7 @@ public:
 class VarRValue : public RValue
 {
 public:
-  std::vector<VarRef> path;
+  ASTList<VarRef> path;
   void accept(Visitor& v) { v.visit(*this); }        
   Token first_token() {return path[0].var_name;}
 };
@@ -238,7 +271,7 @@ class WhileStmt : public Stmt
 {
 public:
   Expr condition;
-  std::vector<std::shared_ptr<Stmt>> stmts;
+  ASTList<Stmt*> stmts;
   void accept(Visitor& v) { v.visit(*this); }  
 };
 
@@ -255,7 +288,7 @@ public:
 class AssignStmt : public Stmt
 {
 public:
-  std::vector<VarRef> lvalue;
+  ASTList<VarRef> lvalue;
   Expr expr;
   void accept(Visitor& v) { v.visit(*this); }  
 };
@@ -267,7 +300,7 @@ public:
   VarDeclStmt var_decl;
   Expr condition;
   AssignStmt assign_stmt;
-  std::vector<std::shared_ptr<Stmt>> stmts;
+  ASTList<Stmt*> stmts;
   void accept(Visitor& v) { v.visit(*this); }  
 };
 
@@ -276,7 +309,7 @@ class BasicIf
 {
 public:
   Expr condition;
-  std::vector<std::shared_ptr<Stmt>> stmts;
+  ASTList<Stmt*> stmts;
 };
 
 
@@ -284,8 +317,8 @@ class IfStmt : public Stmt
 {
 public:
   BasicIf if_part;
-  std::vector<BasicIf> else_ifs;
-  std::vector<std::shared_ptr<Stmt>> else_stmts;
+  ASTList<BasicIf> else_ifs;
+  ASTList<Stmt*> else_stmts;
   void accept(Visitor& v) { v.visit(*this); }  
 };
 
@@ -294,7 +327,7 @@ class CallExpr : public Stmt, public RValue
 {
 public:
   Token fun_name;
-  std::vector<Expr> args;
+  ASTList<Expr> args;
   void accept(Visitor& v) { v.visit(*this); }  
   Token first_token() {return fun_name;}
 };
@@ -307,7 +340,7 @@ class CaseStmt
 {
 public:
   SimpleRValue const_expr;
-  std::vector<std::shared_ptr<Stmt>> stmts;
+  ASTList<Stmt*> stmts;
   std::optional<Token> op = std::nullopt;
 };
 
@@ -316,8 +349,8 @@ class SwitchStmt : public Stmt
 {
 public:
   SimpleRValue switch_expr;
-  std::vector<CaseStmt> cases;
-  std::vector<std::shared_ptr<Stmt>> defaults;
+  ASTList<CaseStmt> cases;
+  ASTList<Stmt*> defaults;
   void accept(Visitor& v) { v.visit(*this); }  
 };
 
@@ -6,24 +6,63 @@
 //----------------------------------------------------------------------
 
 #include "ast_parser.h"
+#include "fnv_hash.h"
 #include "iostream"
 
 using namespace std;
 
-ASTParser::ASTParser(const Lexer &a_lexer)
-    : lexer{a_lexer}
+// smallest chunk worth parsing on its own thread
+const size_t MIN_CHUNK_SIZE = 64 * 1024;
+
+ASTParser::ASTParser(const Lexer &a_lexer, ThreadPool *a_pool)
+    : lexer{a_lexer}, pool{a_pool}
+{
+}
+
+void ASTParser::set_fingerprinting(bool on)
 {
+  fingerprinting = on;
+}
+
+void ASTParser::begin_fingerprint(Fingerprint &f)
+{
+  if (!fingerprinting)
+    return;
+  fingerprint = &f;
+  // (the first token is a word, so its lexeme is its source text)
+  fingerprint_start = lexer.offset() - curr_token.lexeme().size();
+  fingerprint_column = curr_token.column();
+}
+
+void ASTParser::end_fingerprint()
+{
+  if (fingerprint == nullptr)
+    return;
+  // the source text covers the tokens and their relative positions,
+  // which the frame's line table depends on
+  FnvHash h;
+  h.add_number(fingerprint_column);
+  h.add(lexer.source()->text().substr(fingerprint_start,
+                                      fingerprint_end - fingerprint_start));
+  fingerprint->tokens = h.value();
+  fingerprint = nullptr;
 }
 
 void ASTParser::advance()
 {
+  if (fingerprint != nullptr)
+  {
+    if (curr_token.type() == TokenType::ID)
+      fingerprint->names.push_back(curr_token.symbol());
+    fingerprint_end = lexer.offset();
+  }
   curr_token = lexer.next_token();
 }
 
-void ASTParser::eat(TokenType t, const string &msg)
+void ASTParser::eat(TokenType t, string_view msg)
 {
   if (!match(t))
-    error(msg);
+    error(string(msg));
   advance();
 }
 
@@ -42,7 +81,7 @@ bool ASTParser::match(initializer_list<TokenType> types)
 
 void ASTParser::error(const string &msg)
 {
-  string s = msg + " found '" + curr_token.lexeme() + "' ";
+  string s = msg + " found '" + string(curr_token.lexeme()) + "' ";
   s += "at line " + to_string(curr_token.line()) + ", ";
   s += "column " + to_string(curr_token.column());
   throw MyPLException::ParserError(s);
@@ -58,7 +97,13 @@ bool ASTParser::bin_op()
 
 Program ASTParser::parse()
 {
+  if (pool != nullptr && pool->size() > 1)
+    return parse_chunks();
   Program p;
+  p.source = lexer.source();
+  p.symbols = lexer.symbols();
+  arena = p.arena.get();
+  Arena::Scope scope(arena);
   advance();
   while (!match(TokenType::EOS))
   {
@@ -71,25 +116,69 @@ Program ASTParser::parse()
   return p;
 }
 
+Program ASTParser::parse_chunks()
+{
+  // a few chunks per worker to even out the load
+  size_t n = min(pool->size() * 4, lexer.source()->size() / MIN_CHUNK_SIZE);
+  vector<Lexer> chunks = lexer.split(n);
+  if (chunks.size() == 1)
+  {
+    ASTParser parser(lexer);
+    parser.set_fingerprinting(fingerprinting);
+    return parser.parse();
+  }
+  // each chunk is parsed into its own program (and arena), and the
+  // error reported is the first one in the source
+  vector<Program> parts(chunks.size());
+  vector<exception_ptr> errors(chunks.size());
+  pool->run(chunks.size(), [&](size_t, size_t i) {
+    try {
+      ASTParser parser(chunks[i]);
+      parser.set_fingerprinting(fingerprinting);
+      parts[i] = parser.parse();
+    } catch (MyPLException &ex) {
+      errors[i] = current_exception();
+    }
+  });
+  for (exception_ptr &error : errors)
+    if (error)
+      rethrow_exception(error);
+  Program p;
+  p.source = lexer.source();
+  p.symbols = lexer.symbols();
+  for (Program &part : parts)
+  {
+    for (StructDef &s : part.struct_defs)
+      p.struct_defs.push_back(std::move(s));
+    for (FunDef &f : part.fun_defs)
+      p.fun_defs.push_back(std::move(f));
+    p.arena->adopt(part.arena);
+  }
+  return p;
+}
+
 void ASTParser::struct_def(Program &p)
 {
   StructDef s;
+  begin_fingerprint(s.fingerprint);
   eat(TokenType::STRUCT, "expecting struct statement");
   s.struct_name = curr_token;
   eat(TokenType::ID, "expecting id");
   eat(TokenType::LBRACE, "expecting lbrace");
   fields(s);
   eat(TokenType::RBRACE, "expecting rbrace");
-  p.struct_defs.push_back(s);
+  end_fingerprint();
+  p.struct_defs.push_back(std::move(s));
 }
 
 void ASTParser::fun_def(Program &p)
 {
   FunDef f;
+  begin_fingerprint(f.fingerprint);
   DataType d;
   if (match(TokenType::VOID_TYPE))
   {
-    d.type_name = "void";
+    d.type_id = Symbols::VOID;
     f.return_type = d;
     eat(TokenType::VOID_TYPE, "expecting void");
   }
@@ -110,7 +199,8 @@ void ASTParser::fun_def(Program &p)
     stmt(f.stmts);
   }
   eat(TokenType::RBRACE, "expecting rbrace");
-  p.fun_defs.push_back(f);
+  end_fingerprint();
+  p.fun_defs.push_back(std::move(f));
 }
 
 void ASTParser::fields(StructDef &s)
@@ -171,7 +261,7 @@ void ASTParser::params(FunDef &f)
 void ASTParser::data_type(DataType& d) 
 {
   if(match(TokenType::ID)) {
-    d.type_name = curr_token.lexeme();
+    d.type_id = curr_token.symbol();
     advance();
   }
   else if(match(TokenType::ARRAY)) {
@@ -179,16 +269,16 @@ void ASTParser::data_type(DataType& d)
     advance();
 
     if(match(TokenType::ID)) {
-      d.type_name = curr_token.lexeme();
+      d.type_id = curr_token.symbol();
       advance();
     }
     else{
-      d.type_name = curr_token.lexeme();
+      d.type_id = curr_token.symbol();
       base_type();
     }
   }
   else {
-    d.type_name = curr_token.lexeme();
+    d.type_id = curr_token.symbol();
     base_type();
   }
 }
@@ -202,62 +292,66 @@ void ASTParser::base_type()
 }
 
 
-void ASTParser::stmt(std::vector<std::shared_ptr<Stmt>>& s) 
+void ASTParser::stmt(ASTList<Stmt*>& s) 
 {
   if(match(TokenType::SWITCH)) {
-    SwitchStmt i;
-    switch_stmt(i);
-    s.push_back(std::make_shared<SwitchStmt>(i));
+    SwitchStmt* i = arena->make<SwitchStmt>();
+    switch_stmt(*i);
+    s.push_back(i);
   }
   else if(match(TokenType::IF)) {
-    IfStmt i;
-    if_stmt(i);
-    s.push_back(std::make_shared<IfStmt>(i));
+    IfStmt* i = arena->make<IfStmt>();
+    if_stmt(*i);
+    s.push_back(i);
   }
   else if(match(TokenType::WHILE)) {
-    WhileStmt w;
-    while_stmt(w);
-    s.push_back(std::make_shared<WhileStmt>(w));
+    WhileStmt* w = arena->make<WhileStmt>();
+    while_stmt(*w);
+    s.push_back(w);
   }
   else if(match(TokenType::FOR)) {
-    ForStmt f;
-    for_stmt(f);
-    s.push_back(std::make_shared<ForStmt>(f));
+    ForStmt* f = arena->make<ForStmt>();
+    for_stmt(*f);
+    s.push_back(f);
   }
   else if(match(TokenType::RETURN)) {
-    ReturnStmt r;
-    ret_stmt(r);
-    s.push_back(std::make_shared<ReturnStmt>(r));
+    ReturnStmt* r = arena->make<ReturnStmt>();
+    ret_stmt(*r);
+    s.push_back(r);
   }
   else if(match({TokenType::INT_TYPE, TokenType::DOUBLE_TYPE, TokenType::BOOL_TYPE, TokenType::CHAR_TYPE, TokenType::STRING_TYPE, TokenType::ARRAY})) {
-    VarDeclStmt v;
-    vdecl_stmt(v);
-    s.push_back(std::make_shared<VarDeclStmt>(v));
+    VarDeclStmt* v = arena->make<VarDeclStmt>();
+    vdecl_stmt(*v);
+    s.push_back(v);
   }
   else if(match(TokenType::ID)) {
     Token t = curr_token;
     advance();
     if(match(TokenType::LPAREN)){
-      CallExpr c;
-      c.fun_name = t;
-      call_expr(c);
-      s.push_back(std::make_shared<CallExpr>(c));
+      CallExpr* c = arena->make<CallExpr>();
+      c->fun_name = t;
+      call_expr(*c);
+      s.push_back(c);
     }
     else if(match(TokenType::ID)) {
-      VarDeclStmt v;
-      v.var_def.data_type.type_name = t.lexeme();
-      vdecl_stmt(v);
-      s.push_back(std::make_shared<VarDeclStmt>(v));
+      VarDeclStmt* v = arena->make<VarDeclStmt>();
+      v->var_def.data_type.type_id = t.symbol();
+      vdecl_stmt(*v);
+      s.push_back(v);
     }
     else {
-      AssignStmt a;
+      AssignStmt* a = arena->make<AssignStmt>();
       VarRef l;
       l.var_name = t;
-      a.lvalue.push_back(l);
-      assign_stmt(a);
-      s.push_back(std::make_shared<AssignStmt>(a));
+      a->lvalue.push_back(std::move(l));
+      assign_stmt(*a);
+      s.push_back(a);
     }
   }
+  else {
+    // (otherwise the statement loops would never advance)
+    error("expecting statement");
+  }
 }
 
 
@@ -279,7 +373,7 @@ void ASTParser::assign_stmt(AssignStmt& a) {
 }
 
 
-void ASTParser::lvalue(std::vector<VarRef>& p) 
+void ASTParser::lvalue(ASTList<VarRef>& p) 
 {
   while(match(TokenType::DOT) || match(TokenType::LBRACKET)) {
     if(match(TokenType::DOT)) {
@@ -290,15 +384,10 @@ void ASTParser::lvalue(std::vector<VarRef>& p)
       p.push_back(r);
     }
     else if(match(TokenType::LBRACKET)) {
-      VarRef r;
-      r = p.back();
-      p.pop_back();
+      VarRef& r = p.back();
       eat(TokenType::LBRACKET, "expecting lbracket");
-      Expr e;
-      expr(e);
-      r.array_expr = e;
+      expr(r.array_expr.emplace());
       eat(TokenType::RBRACKET, "expecting rbracket");
-      p.push_back(r);
     }
   }
 }
@@ -319,7 +408,7 @@ void ASTParser::if_stmt(IfStmt& i)
   }
 
   eat(TokenType::RBRACE, "expecting rbrace");
-  i.if_part = b;
+  i.if_part = std::move(b);
   if_stmt_tail(i);
 }
 
@@ -340,7 +429,7 @@ void ASTParser::if_stmt_tail(IfStmt& i)
     }
 
     eat(TokenType::RBRACE, "expecting rbrace");
-    i.else_ifs.push_back(b);
+    i.else_ifs.push_back(std::move(b));
     if_stmt_tail(i);
   }
   else if(match(TokenType::ELSE)) 
@@ -403,15 +492,11 @@ void ASTParser::call_expr(CallExpr& c)
   eat(TokenType::LPAREN, "expecting lparen");
   if(!match(TokenType::RPAREN))
   {
-    Expr e;
-    expr(e);
-    c.args.push_back(e);
+    expr(c.args.emplace_back());
 
     while(match(TokenType::COMMA)) {
       eat(TokenType::COMMA, "expecting comma");
-      Expr e2;
-      expr(e2);
-      c.args.push_back(e2);
+      expr(c.args.emplace_back());
     }
   }
   eat(TokenType::RPAREN, "expecting rparen");
@@ -436,69 +521,69 @@ void ASTParser::expr(Expr& e)
   else if(match(TokenType::LPAREN))
   {
     eat(TokenType::LPAREN, "expecting lparen");
-    ComplexTerm c;
-    expr(c.expr);
+    ComplexTerm* c = arena->make<ComplexTerm>();
+    expr(c->expr);
     eat(TokenType::RPAREN, "expecting rparen");
-    e.first = std::make_shared<ComplexTerm>(c);
+    e.first = c;
   } 
   else
   {
-    SimpleTerm s;
-    rvalue(s.rvalue);
-    e.first = std::make_shared<SimpleTerm>(s);
+    SimpleTerm* s = arena->make<SimpleTerm>();
+    rvalue(s->rvalue);
+    e.first = s;
   }
 
   if(bin_op())
   {
     e.op = curr_token;
     advance();
-    Expr r;
-    expr(r);
-    e.rest = std::make_shared<Expr>(r);
+    Expr* r = arena->make<Expr>();
+    expr(*r);
+    e.rest = r;
   }
 }
 
 
-void ASTParser::rvalue(std::shared_ptr<RValue>& r)
+void ASTParser::rvalue(RValue*& r)
 {
   if(match(TokenType::NULL_VAL))
   {
-    SimpleRValue s;
-    s.value = curr_token;
-    r = std::make_shared<SimpleRValue>(s);
+    SimpleRValue* s = arena->make<SimpleRValue>();
+    s->value = curr_token;
+    r = s;
     advance();
   }
   else if(match(TokenType::NEW))
   {
-    NewRValue n;
-    new_rvalue(n);
-    r = std::make_shared<NewRValue>(n);
+    NewRValue* n = arena->make<NewRValue>();
+    new_rvalue(*n);
+    r = n;
   }
   else if(match(TokenType::ID))
   {
     Token t = curr_token;
     advance();
     if(match(TokenType::LPAREN)){
-      CallExpr c;
-      c.fun_name = t;
-      call_expr(c);
-      r = std::make_shared<CallExpr>(c);
+      CallExpr* c = arena->make<CallExpr>();
+      c->fun_name = t;
+      call_expr(*c);
+      r = c;
     }
     else 
     {
-      VarRValue a;
+      VarRValue* a = arena->make<VarRValue>();
       VarRef v;
       v.var_name = t;
-      a.path.push_back(v);
-      var_rvalue(a.path);
-      r = std::make_shared<VarRValue>(a);
+      a->path.push_back(std::move(v));
+      var_rvalue(a->path);
+      r = a;
     }
   }
   else
   {
-    SimpleRValue s;
-    base_rvalue(s);
-    r = std::make_shared<SimpleRValue>(s);
+    SimpleRValue* s = arena->make<SimpleRValue>();
+    base_rvalue(*s);
+    r = s;
   }
 }
 
@@ -512,9 +597,7 @@ void ASTParser::new_rvalue(NewRValue& n)
 
     if(match(TokenType::LBRACKET)) {
       eat(TokenType::LBRACKET, "expecting lbracket");
-      Expr e;
-      expr(e);
-      n.array_expr = e;
+      expr(n.array_expr.emplace());
 
       eat(TokenType::RBRACKET, "expecting rbracket");
     }
@@ -524,9 +607,7 @@ void ASTParser::new_rvalue(NewRValue& n)
     base_type();
 
     eat(TokenType::LBRACKET, "expecting lbracket");
-    Expr e;
-    expr(e);
-    n.array_expr = e;
+    expr(n.array_expr.emplace());
     eat(TokenType::RBRACKET, "expecting rbracket");
   }
 }
@@ -541,7 +622,7 @@ void ASTParser::base_rvalue(SimpleRValue& s)
 }
 
 
-void ASTParser::var_rvalue(std::vector<VarRef>& p)
+void ASTParser::var_rvalue(ASTList<VarRef>& p)
 {
   while (match(TokenType::DOT) || match(TokenType::LBRACKET)) 
   {
@@ -553,15 +634,10 @@ void ASTParser::var_rvalue(std::vector<VarRef>& p)
       p.push_back(v);
     }
     else if (match(TokenType::LBRACKET)) {
-      VarRef v;
-      v = p.back();
-      p.pop_back();
+      VarRef& v = p.back();
       eat(TokenType::LBRACKET, "expecting lbracket");
-      Expr e;
-      expr(e);
-      v.array_expr = e;
+      expr(v.array_expr.emplace());
       eat(TokenType::RBRACKET, "expecting rbracket");
-      p.push_back(v);
     }
   }
 }
@@ -601,7 +677,7 @@ void ASTParser::case_stmt(SwitchStmt& s)
     }
 
 
-    s.cases.push_back(c);
+    s.cases.push_back(std::move(c));
     
     if (match(TokenType::CASE)) {
       case_stmt(s);
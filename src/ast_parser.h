@@ -11,26 +11,55 @@
 #include "mypl_exception.h"
 #include "lexer.h"
 #include "ast.h"
+#include "thread_pool.h"
 
 
 class ASTParser
 {
 public:
 
-  // crate a new recursive descent parer
-  ASTParser(const Lexer& lexer);
+  // crate a new recursive descent parer (that parses chunks of the
+  // source in parallel on the pool if given)
+  ASTParser(const Lexer& lexer, ThreadPool* pool = nullptr);
 
   // run the parser
   Program parse();
+
+  // fingerprint the tokens of each definition as it is parsed (for
+  // incremental compiles, see IncrementalCompiler)
+  void set_fingerprinting(bool on);
   
 private:
   
   Lexer lexer;
   Token curr_token;
+
+  // workers for parsing chunks (or nullptr to parse serially)
+  ThreadPool* pool;
+
+  // where the nodes of the program being parsed are allocated
+  Arena* arena = nullptr;
+
+  // true if definitions are fingerprinted, the fingerprint of the one
+  // being parsed (or nullptr), the source offset and column of its
+  // first token, and the offset just past the last token eaten
+  bool fingerprinting = false;
+  Fingerprint* fingerprint = nullptr;
+  size_t fingerprint_start = 0;
+  int fingerprint_column = 0;
+  size_t fingerprint_end = 0;
+
+  // start fingerprinting a definition at the current token, and finish
+  // (after its last token has been eaten)
+  void begin_fingerprint(Fingerprint& f);
+  void end_fingerprint();
   
+  // parse each chunk of top-level definitions on the pool
+  Program parse_chunks();
+
   // helper functions
   void advance();
-  void eat(TokenType t, const std::string& msg);
+  void eat(TokenType t, std::string_view msg);
   bool match(TokenType t);
   bool match(std::initializer_list<TokenType> types);
   void error(const std::string& msg);
@@ -45,10 +74,10 @@ private:
   void params(FunDef &f);
   void data_type(DataType& d);
   void base_type();
-  void stmt(std::vector<std::shared_ptr<Stmt>>& s);
+  void stmt(ASTList<Stmt*>& s);
   void vdecl_stmt(VarDeclStmt& v);
   void assign_stmt(AssignStmt& a);
-  void lvalue(std::vector<VarRef>& p);
+  void lvalue(ASTList<VarRef>& p);
   void if_stmt(IfStmt& i);
   void if_stmt_tail(IfStmt& i);
   void while_stmt(WhileStmt& w);
@@ -56,10 +85,10 @@ private:
   void call_expr(CallExpr& c);
   void ret_stmt(ReturnStmt& r);
   void expr(Expr& e);
-  void rvalue(std::shared_ptr<RValue>& r);
+  void rvalue(RValue*& r);
   void new_rvalue(NewRValue& n);
   void base_rvalue(SimpleRValue& s);
-  void var_rvalue(std::vector<VarRef>& p);
+  void var_rvalue(ASTList<VarRef>& p);
 
   void switch_stmt(SwitchStmt& s);
   void case_stmt(SwitchStmt& S);
@@ -0,0 +1,93 @@
+//----------------------------------------------------------------------
+// FILE: bundle.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Bundled executable writer and loader
+//----------------------------------------------------------------------
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+#include "bundle.h"
+#include "bytecode.h"
+#include "mypl_exception.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+
+string Bundle::self_path()
+{
+  error_code ec;
+  fs::path p = fs::read_symlink("/proc/self/exe", ec);
+  return ec ? "" : p.string();
+}
+
+
+void Bundle::write(const VM& vm, const string& runtime_path,
+                   const string& out_path)
+{
+  ifstream in(runtime_path, ios::binary);
+  if (!in)
+    throw MyPLException::BytecodeError("unable to read runtime '" +
+                                       runtime_path + "'");
+  string runtime(istreambuf_iterator<char>(in), {});
+
+  // never bundle a bundle, strip any program already appended
+  if (runtime.size() >= sizeof(BundleTrailer)) {
+    BundleTrailer t;
+    memcpy(&t, runtime.data() + runtime.size() - sizeof(t), sizeof(t));
+    if (memcmp(t.magic, BUNDLE_MAGIC, sizeof(t.magic)) == 0 and
+        t.payload_offset <= runtime.size())
+      runtime.resize(t.payload_offset);
+  }
+
+  // the image is 8-byte aligned within the file so it can be used
+  // directly from the mapping
+  while (runtime.size() % 8 != 0)
+    runtime += '\0';
+  string image = Bytecode::serialize(vm);
+  BundleTrailer trailer {runtime.size(), image.size(), {}};
+  memcpy(trailer.magic, BUNDLE_MAGIC, sizeof(trailer.magic));
+
+  ofstream out(out_path, ios::binary | ios::trunc);
+  if (!out)
+    throw MyPLException::BytecodeError("unable to open '" + out_path +
+                                       "' for writing");
+  out.write(runtime.data(), runtime.size());
+  out.write(image.data(), image.size());
+  out.write((const char*)&trailer, sizeof(trailer));
+  out.close();
+  if (!out)
+    throw MyPLException::BytecodeError("unable to write '" + out_path + "'");
+  error_code ec;
+  fs::permissions(out_path, fs::perms::owner_all | fs::perms::group_read |
+                  fs::perms::group_exec | fs::perms::others_read |
+                  fs::perms::others_exec, ec);
+}
+
+
+bool Bundle::load(VM& vm, const string& exe_path)
+{
+  if (exe_path == "")
+    return false;
+  ifstream in(exe_path, ios::binary | ios::ate);
+  if (!in)
+    return false;
+  uint64_t size = in.tellg();
+  if (size < sizeof(BundleTrailer))
+    return false;
+  BundleTrailer t;
+  in.seekg(size - sizeof(t));
+  if (!in.read((char*)&t, sizeof(t)) or
+      memcmp(t.magic, BUNDLE_MAGIC, sizeof(t.magic)) != 0)
+    return false;
+  if (t.payload_offset > size - sizeof(t) or
+      size - sizeof(t) - t.payload_offset != t.payload_size)
+    throw MyPLException::BytecodeError("corrupt bundle trailer in '" +
+                                       exe_path + "'");
+  Bytecode::load(vm, exe_path, t.payload_offset, t.payload_size);
+  return true;
+}
@@ -0,0 +1,53 @@
+//----------------------------------------------------------------------
+// FILE: bundle.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Standalone executables made of a copy of the mypl runtime
+// with a compiled program appended to it. The layout of a bundle is:
+//
+//   [runtime executable][padding][bytecode image][trailer]
+//
+// where the trailer (at the very end of the file) records where the
+// bytecode image starts and how big it is.
+//----------------------------------------------------------------------
+
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <cstdint>
+#include <string>
+#include "vm.h"
+
+
+// marks the end of a bundled executable
+const char BUNDLE_MAGIC[8] = {'M', 'Y', 'P', 'L', 'B', 'N', 'D', 'L'};
+
+
+struct BundleTrailer
+{
+  uint64_t payload_offset;
+  uint64_t payload_size;
+  char magic[8];
+};
+
+
+class Bundle
+{
+public:
+
+  // the path of the currently running executable
+  static std::string self_path();
+
+  // write a copy of the runtime executable with the compiled program
+  // in the vm appended to it (the output is made executable)
+  static void write(const VM& vm, const std::string& runtime_path,
+                    const std::string& out_path);
+
+  // if the executable has a program appended, load it into the vm
+  // and return true (otherwise returns false and leaves vm unchanged)
+  static bool load(VM& vm, const std::string& exe_path);
+
+};
+
+
+#endif
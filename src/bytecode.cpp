@@ -0,0 +1,386 @@
+//----------------------------------------------------------------------
+// FILE: bytecode.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Bytecode file writer and (mmap-based) loader
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bytecode.h"
+#include "mypl_exception.h"
+
+using namespace std;
+
+
+namespace {
+
+  const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+  // helper to round a section offset up to the record alignment
+  size_t align8(size_t n)
+  {
+    return (n + 7) & ~size_t(7);
+  }
+
+  void error(const string& msg)
+  {
+    throw MyPLException::BytecodeError(msg);
+  }
+
+  // helper to build the deduplicated string pool while serializing
+  class StringPool
+  {
+  public:
+    uint32_t add(const string& s)
+    {
+      auto it = ids.find(s);
+      if (it != ids.end())
+        return it->second;
+      uint32_t id = entries.size();
+      entries.push_back({(uint32_t)data.size(), (uint32_t)s.size()});
+      data += s;
+      ids[s] = id;
+      return id;
+    }
+    vector<BytecodeString> entries;
+    string data;
+  private:
+    unordered_map<string, uint32_t> ids;
+  };
+
+  // append the records in the vector to the image at the given offset
+  template<typename T>
+  void put(string& image, size_t offset, const vector<T>& records)
+  {
+    if (!records.empty())
+      memcpy(image.data() + offset, records.data(), records.size() * sizeof(T));
+  }
+
+  // checks that count records of type T starting at offset are in bounds
+  template<typename T>
+  const T* section(const char* data, size_t size, uint64_t offset,
+                   uint32_t count)
+  {
+    if (offset % alignof(T) != 0 or offset > size or
+        (size - offset) / sizeof(T) < count)
+      error("truncated or misaligned section");
+    return reinterpret_cast<const T*>(data + offset);
+  }
+
+  // read-only mapping of a whole file, unmapped on destruction
+  class MappedFile
+  {
+  public:
+    MappedFile(const string& path)
+    {
+      int fd = open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+        error("unable to open '" + path + "'");
+      struct stat st;
+      if (fstat(fd, &st) != 0) {
+        close(fd);
+        error("unable to stat '" + path + "'");
+      }
+      size = st.st_size;
+      if (size > 0)
+        addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (addr == MAP_FAILED)
+        error("unable to map '" + path + "'");
+    }
+    ~MappedFile()
+    {
+      if (addr != nullptr and addr != MAP_FAILED)
+        munmap(addr, size);
+    }
+    const char* data() const { return static_cast<const char*>(addr); }
+    void* addr = nullptr;
+    size_t size = 0;
+  };
+
+}
+
+
+string Bytecode::serialize(const VM& vm)
+{
+  StringPool pool;
+  vector<BytecodeFrame> frames;
+  vector<BytecodeStruct> structs;
+  vector<uint32_t> fields;
+  vector<BytecodeInstr> instrs;
+  vector<BytecodeLine> lines;
+  // the pool index of each interned name (looked up once per symbol)
+  vector<uint32_t> symbol_ids;
+  const Interner& symbols = *vm.symbols();
+  auto symbol_id = [&](Symbol id) {
+    if (id >= symbol_ids.size())
+      symbol_ids.resize(id + 1, UINT32_MAX);
+    if (symbol_ids[id] == UINT32_MAX)
+      symbol_ids[id] = pool.add(string(symbols.name(id)));
+    return symbol_ids[id];
+  };
+
+  // sort by name so the same program always produces the same bytes
+  vector<const VMFrameInfo*> frame_infos;
+  for (const auto& [name, info] : vm.frames())
+    frame_infos.push_back(&info);
+  sort(frame_infos.begin(), frame_infos.end(),
+       [](auto a, auto b) {return a->function_name < b->function_name;});
+  vector<const VMStructInfo*> struct_infos;
+  for (const auto& [name, info] : vm.structs())
+    struct_infos.push_back(&info);
+  sort(struct_infos.begin(), struct_infos.end(),
+       [](auto a, auto b) {return a->struct_name < b->struct_name;});
+
+  size_t instr_count = 0;
+  size_t line_count = 0;
+  for (const VMFrameInfo* info : frame_infos) {
+    instr_count += info->instructions.size();
+    line_count += info->lines.size();
+  }
+  frames.reserve(frame_infos.size());
+  instrs.reserve(instr_count);
+  lines.reserve(line_count);
+
+  for (const VMFrameInfo* info : frame_infos) {
+    BytecodeFrame f {pool.add(info->function_name), (uint32_t)info->arg_count,
+                     (uint32_t)instrs.size(),
+                     (uint32_t)info->instructions.size(),
+                     (uint32_t)lines.size(), (uint32_t)info->lines.size()};
+    frames.push_back(f);
+    for (const VMLine& l : info->lines)
+      lines.push_back({(uint32_t)l.pc, (uint32_t)l.line, (uint32_t)l.column});
+    for (const VMInstr& instr : info->instructions) {
+      BytecodeInstr r {};
+      r.opcode = (uint8_t)instr.opcode();
+      r.tag = (uint8_t)BytecodeTag::NONE;
+      optional<VMValue> operand = instr.operand();
+      if (operand.has_value()) {
+        const VMValue& v = operand.value();
+        if (VMInstr::has_symbol_operand(instr.opcode()) and
+            holds_alternative<int>(v)) {
+          r.tag = (uint8_t)BytecodeTag::SYMBOL;
+          r.int_val = symbol_id(get<int>(v));
+        }
+        else if (holds_alternative<int>(v)) {
+          r.tag = (uint8_t)BytecodeTag::INT;
+          r.int_val = get<int>(v);
+        }
+        else if (holds_alternative<double>(v)) {
+          r.tag = (uint8_t)BytecodeTag::DOUBLE;
+          r.double_val = get<double>(v);
+        }
+        else if (holds_alternative<bool>(v)) {
+          r.tag = (uint8_t)BytecodeTag::BOOL;
+          r.int_val = get<bool>(v);
+        }
+        else if (holds_alternative<string>(v)) {
+          r.tag = (uint8_t)BytecodeTag::STRING;
+          r.int_val = pool.add(get<string>(v));
+        }
+        else
+          r.tag = (uint8_t)BytecodeTag::NULLPTR;
+      }
+      instrs.push_back(r);
+    }
+  }
+
+  for (const VMStructInfo* info : struct_infos) {
+    BytecodeStruct s {pool.add(info->struct_name), (uint32_t)fields.size(),
+                      (uint32_t)info->fields.size(), 0};
+    structs.push_back(s);
+    for (const string& field : info->fields)
+      fields.push_back(pool.add(field));
+  }
+
+  // lay out the sections
+  BytecodeHeader h {};
+  memcpy(h.magic, BYTECODE_MAGIC, sizeof(h.magic));
+  h.version = BYTECODE_VERSION;
+  h.byte_order = BYTE_ORDER_MARK;
+  h.frame_count = frames.size();
+  h.struct_count = structs.size();
+  h.field_count = fields.size();
+  h.string_count = pool.entries.size();
+  h.instr_count = instrs.size();
+  h.pool_size = pool.data.size();
+  h.line_count = lines.size();
+  size_t offset = align8(sizeof(BytecodeHeader));
+  h.frames_offset = offset;
+  offset = align8(offset + frames.size() * sizeof(BytecodeFrame));
+  h.structs_offset = offset;
+  offset = align8(offset + structs.size() * sizeof(BytecodeStruct));
+  h.fields_offset = offset;
+  offset = align8(offset + fields.size() * sizeof(uint32_t));
+  h.strings_offset = offset;
+  offset = align8(offset + pool.entries.size() * sizeof(BytecodeString));
+  h.instrs_offset = offset;
+  offset = align8(offset + instrs.size() * sizeof(BytecodeInstr));
+  h.lines_offset = offset;
+  offset = align8(offset + lines.size() * sizeof(BytecodeLine));
+  h.pool_offset = offset;
+  offset += pool.data.size();
+
+  string image(offset, '\0');
+  memcpy(image.data(), &h, sizeof(h));
+  put(image, h.frames_offset, frames);
+  put(image, h.structs_offset, structs);
+  put(image, h.fields_offset, fields);
+  put(image, h.strings_offset, pool.entries);
+  put(image, h.instrs_offset, instrs);
+  put(image, h.lines_offset, lines);
+  memcpy(image.data() + h.pool_offset, pool.data.data(), pool.data.size());
+  return image;
+}
+
+
+void Bytecode::write(const VM& vm, const string& path)
+{
+  string image = serialize(vm);
+  ofstream out(path, ios::binary | ios::trunc);
+  if (!out)
+    error("unable to open '" + path + "' for writing");
+  out.write(image.data(), image.size());
+  if (!out)
+    error("unable to write '" + path + "'");
+}
+
+
+void Bytecode::load(VM& vm, const char* data, size_t size)
+{
+  if (size < sizeof(BytecodeHeader))
+    error("file too small to be bytecode");
+  BytecodeHeader h;
+  memcpy(&h, data, sizeof(h));
+  if (memcmp(h.magic, BYTECODE_MAGIC, sizeof(h.magic)) != 0)
+    error("not a bytecode file");
+  if (h.byte_order != BYTE_ORDER_MARK)
+    error("bytecode was written on a host with different byte order");
+  if (h.version != BYTECODE_VERSION)
+    error("unsupported bytecode version " + to_string(h.version) +
+          " (expecting " + to_string(BYTECODE_VERSION) + ")");
+
+  auto frames = section<BytecodeFrame>(data, size, h.frames_offset,
+                                       h.frame_count);
+  auto structs = section<BytecodeStruct>(data, size, h.structs_offset,
+                                         h.struct_count);
+  auto fields = section<uint32_t>(data, size, h.fields_offset, h.field_count);
+  auto strings = section<BytecodeString>(data, size, h.strings_offset,
+                                         h.string_count);
+  Interner& symbols = *vm.symbols();
+  auto instrs = section<BytecodeInstr>(data, size, h.instrs_offset,
+                                       h.instr_count);
+  auto lines = section<BytecodeLine>(data, size, h.lines_offset,
+                                     h.line_count);
+  const char* pool = section<char>(data, size, h.pool_offset, h.pool_size);
+
+  // materialize each pooled string once
+  vector<string> pooled;
+  pooled.reserve(h.string_count);
+  for (uint32_t i = 0; i < h.string_count; ++i) {
+    const BytecodeString& s = strings[i];
+    if (s.offset > h.pool_size or h.pool_size - s.offset < s.length)
+      error("string out of bounds");
+    pooled.emplace_back(pool + s.offset, s.length);
+  }
+  auto str = [&](uint64_t id) -> const string& {
+    if (id >= pooled.size())
+      error("bad string index");
+    return pooled[id];
+  };
+
+  for (uint32_t i = 0; i < h.frame_count; ++i) {
+    const BytecodeFrame& f = frames[i];
+    if (f.first_instr > h.instr_count or
+        h.instr_count - f.first_instr < f.instr_count)
+      error("frame instructions out of bounds");
+    if (f.first_line > h.line_count or
+        h.line_count - f.first_line < f.line_count)
+      error("frame lines out of bounds");
+    VMFrameInfo info;
+    info.function_name = str(f.name);
+    info.arg_count = f.arg_count;
+    info.instructions.reserve(f.instr_count);
+    for (uint32_t j = 0; j < f.instr_count; ++j) {
+      const BytecodeInstr& r = instrs[f.first_instr + j];
+      if (r.opcode > (uint8_t)OpCode::NOP)
+        error("bad opcode " + to_string(r.opcode));
+      VMInstr instr((OpCode)r.opcode);
+      switch ((BytecodeTag)r.tag) {
+      case BytecodeTag::NONE:
+        break;
+      case BytecodeTag::INT:
+        instr.set_operand((int)r.int_val);
+        break;
+      case BytecodeTag::DOUBLE:
+        instr.set_operand(r.double_val);
+        break;
+      case BytecodeTag::BOOL:
+        instr.set_operand(r.int_val != 0);
+        break;
+      case BytecodeTag::STRING:
+        instr.set_operand(str(r.int_val));
+        break;
+      case BytecodeTag::NULLPTR:
+        instr.set_operand(nullptr);
+        break;
+      case BytecodeTag::SYMBOL:
+        instr.set_operand((int)symbols.intern(str(r.int_val)));
+        break;
+      default:
+        error("bad operand tag " + to_string(r.tag));
+      }
+      info.instructions.push_back(instr);
+    }
+    info.lines.reserve(f.line_count);
+    for (uint32_t j = 0; j < f.line_count; ++j) {
+      const BytecodeLine& l = lines[f.first_line + j];
+      info.lines.push_back({(int)l.pc, (int)l.line, (int)l.column});
+    }
+    vm.add(std::move(info));
+  }
+
+  for (uint32_t i = 0; i < h.struct_count; ++i) {
+    const BytecodeStruct& s = structs[i];
+    if (s.first_field > h.field_count or
+        h.field_count - s.first_field < s.field_count)
+      error("struct fields out of bounds");
+    VMStructInfo info;
+    info.struct_name = str(s.name);
+    for (uint32_t j = 0; j < s.field_count; ++j)
+      info.fields.push_back(str(fields[s.first_field + j]));
+    vm.add(info);
+  }
+}
+
+
+void Bytecode::load(VM& vm, const string& path)
+{
+  MappedFile file(path);
+  load(vm, file.data(), file.size);
+}
+
+
+void Bytecode::load(VM& vm, const string& path, size_t offset, size_t size)
+{
+  MappedFile file(path);
+  if (offset % 8 != 0 or offset > file.size or file.size - offset < size)
+    error("embedded bytecode out of bounds in '" + path + "'");
+  load(vm, file.data() + offset, size);
+}
+
+
+bool Bytecode::is_bytecode(const string& path)
+{
+  ifstream in(path, ios::binary);
+  char magic[sizeof(BYTECODE_MAGIC)];
+  if (!in.read(magic, sizeof(magic)))
+    return false;
+  return memcmp(magic, BYTECODE_MAGIC, sizeof(magic)) == 0;
+}
@@ -0,0 +1,139 @@
+//----------------------------------------------------------------------
+// FILE: bytecode.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Serialized (on-disk) MyPL bytecode format. A bytecode file is
+// a fixed header followed by flat, 8-byte aligned record sections
+// that can be used directly from an mmap'd image.
+//----------------------------------------------------------------------
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "vm.h"
+
+
+// bumped whenever the layout of any record below changes
+const uint32_t BYTECODE_VERSION = 3;
+
+// every bytecode file starts with these bytes
+const char BYTECODE_MAGIC[8] = {'M', 'Y', 'P', 'L', 'B', 'C', '\r', '\n'};
+
+// the standard file extension for compiled programs
+const std::string BYTECODE_EXT = ".myplc";
+
+
+// The following are the on-disk records (all plain-old data)
+
+
+struct BytecodeHeader
+{
+  char magic[8];
+  uint32_t version;
+  // 0x01020304 as written by the producing host (detects endianness)
+  uint32_t byte_order;
+  uint32_t frame_count;
+  uint32_t struct_count;
+  uint32_t field_count;
+  uint32_t string_count;
+  uint32_t instr_count;
+  uint32_t pool_size;
+  uint32_t line_count;
+  uint32_t reserved;
+  // byte offsets (from start of file) of each section
+  uint64_t frames_offset;
+  uint64_t structs_offset;
+  uint64_t fields_offset;
+  uint64_t strings_offset;
+  uint64_t instrs_offset;
+  uint64_t pool_offset;
+  uint64_t lines_offset;
+};
+
+
+struct BytecodeFrame
+{
+  uint32_t name;          // string index
+  uint32_t arg_count;
+  uint32_t first_instr;   // index into the instruction section
+  uint32_t instr_count;
+  uint32_t first_line;    // index into the line section
+  uint32_t line_count;
+};
+
+
+// a run of a frame's instructions from the same source line
+struct BytecodeLine
+{
+  uint32_t pc;
+  uint32_t line;
+  uint32_t column;
+};
+
+
+struct BytecodeStruct
+{
+  uint32_t name;          // string index
+  uint32_t first_field;   // index into the field section
+  uint32_t field_count;
+  uint32_t reserved;
+};
+
+
+struct BytecodeString
+{
+  uint32_t offset;        // byte offset into the string pool
+  uint32_t length;
+};
+
+
+// operand kinds (mirrors the VMValue alternatives, plus interned names
+// which are stored by string since symbols are only valid in-process)
+enum class BytecodeTag : uint8_t {NONE, INT, DOUBLE, BOOL, STRING, NULLPTR,
+                                  SYMBOL};
+
+
+struct BytecodeInstr
+{
+  uint8_t opcode;
+  uint8_t tag;            // a BytecodeTag
+  uint16_t reserved;
+  uint32_t reserved2;
+  union {
+    int64_t int_val;      // INT, BOOL, STRING and SYMBOL (string index)
+    double double_val;    // DOUBLE
+  };
+};
+
+
+class Bytecode
+{
+public:
+
+  // serialize the frames and struct shapes of the vm into a byte image
+  static std::string serialize(const VM& vm);
+
+  // write the vm as a bytecode file (replaces any existing file)
+  static void write(const VM& vm, const std::string& path);
+
+  // add the frames and struct shapes in the given image to the vm
+  static void load(VM& vm, const char* data, size_t size);
+
+  // mmap the given bytecode file and load it into the vm
+  static void load(VM& vm, const std::string& path);
+
+  // mmap the given file and load the bytecode image stored at offset
+  // (which must be 8-byte aligned) with the given size
+  static void load(VM& vm, const std::string& path, size_t offset,
+                   size_t size);
+
+  // true if the file starts with the bytecode magic bytes
+  static bool is_bytecode(const std::string& path);
+
+};
+
+
+#endif
@@ -12,42 +12,110 @@ using namespace std;
 
 
 // helper function to replace all occurrences of old string with new
+// (in one pass, the replacements themselves are not searched)
 void replace_all(string& s, const string& old_str, const string& new_str)
 {
-  while (s.find(old_str) != string::npos)
-    s.replace(s.find(old_str), old_str.size(), new_str);
+  size_t pos = s.find(old_str);
+  if (pos == string::npos)
+    return;
+  string result;
+  result.reserve(s.size());
+  size_t start = 0;
+  while (pos != string::npos) {
+    result.append(s, start, pos - start);
+    result += new_str;
+    start = pos + old_str.size();
+    pos = s.find(old_str, start);
+  }
+  result.append(s, start);
+  s = std::move(result);
 }
 
 
-CodeGenerator::CodeGenerator(VM& vm)
-  : vm(vm)
+CodeGenerator::CodeGenerator(VM& vm, ThreadPool* pool)
+  : vm(vm), pool(pool)
 {
 }
 
 
-void CodeGenerator::visit(Program& p)
+void CodeGenerator::generate_lazily(shared_ptr<Program> program, VM& vm,
+                                    shared_ptr<SemanticChecker> checker)
 {
+  auto generator = make_shared<CodeGenerator>(vm);
+  generator->lazy = true;
+  program->accept(*generator);
+  vm.set_loader([program, checker, generator](Symbol name) {
+    auto entry = generator->fun_defs.find(name);
+    if (entry == generator->fun_defs.end())
+      return;
+    FunDef& f = *entry->second;
+    if (checker != nullptr)
+      f.accept(*checker);
+    generator->vm.add(generator->generate(f));
+  });
+}
+
+
+void CodeGenerator::declare(Program& p)
+{
+  vm.set_symbols(p.symbols);
   for (auto& struct_def : p.struct_defs)
     struct_def.accept(*this);
-  for (auto& fun_def : p.fun_defs)
-    fun_def.accept(*this);
+}
+
+
+void CodeGenerator::visit(Program& p)
+{
+  declare(p);
+  if (lazy) {
+    for (auto& fun_def : p.fun_defs) {
+      fun_defs[fun_def.fun_name.symbol()] = &fun_def;
+      VMFrameInfo stub;
+      stub.function_name = fun_def.fun_name.lexeme();
+      stub.arg_count = fun_def.params.size();
+      stub.stub = true;
+      vm.add(std::move(stub));
+    }
+    return;
+  }
+  if (pool == nullptr or pool->size() == 1) {
+    for (auto& fun_def : p.fun_defs)
+      fun_def.accept(*this);
+    return;
+  }
+  // each worker generates into its own frames, which are then added in
+  // program order so the vm is the same as when generated serially
+  vector<CodeGenerator> workers(pool->size(), *this);
+  vector<VMFrameInfo> frames(p.fun_defs.size());
+  pool->run(p.fun_defs.size(), [&](size_t worker, size_t i) {
+    frames[i] = workers[worker].generate(p.fun_defs[i]);
+  });
+  for (VMFrameInfo& frame : frames)
+    vm.add(std::move(frame));
 }
 
 
 void CodeGenerator::visit(FunDef& f)
+{
+  vm.add(generate(f));
+}
+
+
+VMFrameInfo CodeGenerator::generate(FunDef& f)
 {
   VMFrameInfo new_frame;
   new_frame.function_name = f.fun_name.lexeme();
   new_frame.arg_count = f.params.size();
   curr_frame = new_frame;
   var_table.push_environment();
+  mark(f.fun_name);
 
   for(int i = 0; i < f.params.size(); i++) {
     curr_frame.instructions.push_back(VMInstr::STORE(i));
-    var_table.add(f.params[i].var_name.lexeme());
+    var_table.add(f.params[i].var_name.symbol());
   }
 
-  for(auto s : f.stmts) {
+  for(auto& s : f.stmts) {
     s->accept(*this);
   }
 
@@ -57,18 +125,38 @@ void CodeGenerator::visit(FunDef& f)
   }
 
   var_table.pop_environment();
-  vm.add(curr_frame);
+  return std::move(curr_frame);
+}
+
+
+void CodeGenerator::mark(const Token& t)
+{
+  vector<VMLine>& lines = curr_frame.lines;
+  int pc = curr_frame.instructions.size();
+  // case: no instructions of the last run were generated
+  if (!lines.empty() and lines.back().pc == pc)
+    lines.pop_back();
+  if (!lines.empty() and lines.back().line == t.line())
+    return;
+  lines.push_back({pc, t.line(), t.column()});
 }
 
 
 void CodeGenerator::visit(StructDef& s)
 {
-  struct_defs[s.struct_name.lexeme()] = s;
+  struct_defs[s.struct_name.symbol()] = &s;
+  VMStructInfo info;
+  info.struct_name = s.struct_name.lexeme();
+  for(auto& f : s.fields) {
+    info.fields.push_back(string(f.var_name.lexeme()));
+  }
+  vm.add(info);
 }
 
 
 void CodeGenerator::visit(ReturnStmt& s)
 {
+  mark(s.expr.first_token());
   s.expr.accept(*this);
   curr_frame.instructions.push_back(VMInstr::RET());
 }
@@ -77,18 +165,20 @@ void CodeGenerator::visit(ReturnStmt& s)
 void CodeGenerator::visit(WhileStmt& s)
 {
   int index = curr_frame.instructions.size();
+  mark(s.condition.first_token());
   s.condition.accept(*this);
 
   int jmp_index = curr_frame.instructions.size();
   curr_frame.instructions.push_back(VMInstr::JMPF(-1));
   var_table.push_environment();
 
-  for(auto st : s.stmts) {
+  for(auto& st : s.stmts) {
     st->accept(*this);
   }
 
   var_table.pop_environment();
 
+  mark(s.condition.first_token());
   curr_frame.instructions.push_back(VMInstr::JMP(index));
   curr_frame.instructions.push_back(VMInstr::NOP());
   int curr_index = curr_frame.instructions.size() - 1;
@@ -103,13 +193,14 @@ void CodeGenerator::visit(ForStmt& s)
 
   int index = curr_frame.instructions.size();
 
+  mark(s.condition.first_token());
   s.condition.accept(*this);
 
   int jmpf_index = curr_frame.instructions.size();
   curr_frame.instructions.push_back(VMInstr::JMPF(-1));
 
   var_table.push_environment();
-  for(auto st : s.stmts) {
+  for(auto& st : s.stmts) {
     st->accept(*this);
   }
   var_table.pop_environment();
@@ -118,6 +209,7 @@ void CodeGenerator::visit(ForStmt& s)
 
   var_table.pop_environment();
 
+  mark(s.condition.first_token());
   curr_frame.instructions.push_back(VMInstr::JMP(index));
   curr_frame.instructions.push_back(VMInstr::NOP());
   int curr_index = curr_frame.instructions.size() - 1;
@@ -130,6 +222,7 @@ void CodeGenerator::visit(IfStmt& s)
   vector<int> jmp;
   vector<int> jmpf;
 
+  mark(s.if_part.condition.first_token());
   s.if_part.condition.accept(*this);
   jmpf.push_back(curr_frame.instructions.size());
   curr_frame.instructions.push_back(VMInstr::JMPF(-1));
@@ -148,7 +241,8 @@ void CodeGenerator::visit(IfStmt& s)
   curr_frame.instructions.at(jmpf[0]).set_operand(jmpf[1]);
 
   int counter = 0;
-  for(auto ei : s.else_ifs){
+  for(auto& ei : s.else_ifs){
+    mark(ei.condition.first_token());
     ei.condition.accept(*this);
     counter += 2;
 
@@ -169,9 +263,11 @@ void CodeGenerator::visit(IfStmt& s)
     curr_frame.instructions.at(jmpf[counter]).set_operand(jmpf[counter + 1]);
   }
 
-  for(auto e : s.else_stmts){
+  var_table.push_environment();
+  for(auto& e : s.else_stmts){
     e->accept(*this);
   }
+  var_table.pop_environment();
 
   int index = curr_frame.instructions.size();
   curr_frame.instructions.push_back(VMInstr::NOP());
@@ -184,19 +280,21 @@ void CodeGenerator::visit(IfStmt& s)
 
 void CodeGenerator::visit(VarDeclStmt& s)
 {
+  mark(s.var_def.var_name);
   s.expr.accept(*this);
-  var_table.add(s.var_def.var_name.lexeme());
-  curr_frame.instructions.push_back(VMInstr::STORE(var_table.get(s.var_def.var_name.lexeme())));
+  var_table.add(s.var_def.var_name.symbol());
+  curr_frame.instructions.push_back(VMInstr::STORE(var_table.get(s.var_def.var_name.symbol())));
 }
 
 
 void CodeGenerator::visit(AssignStmt& s)
 {
-  curr_frame.instructions.push_back(VMInstr::LOAD(var_table.get(s.lvalue.at(0).var_name.lexeme())));
+  mark(s.lvalue.at(0).var_name);
+  curr_frame.instructions.push_back(VMInstr::LOAD(var_table.get(s.lvalue.at(0).var_name.symbol())));
   
   for(int i = 0; i < s.lvalue.size(); ++i) {
     if(i > 0) {
-      curr_frame.instructions.push_back(VMInstr::GETF(s.lvalue[i].var_name.lexeme()));
+      curr_frame.instructions.push_back(VMInstr::GETF(s.lvalue[i].var_name.symbol()));
     }
 
     if(s.lvalue[i].array_expr.has_value()) {
@@ -208,42 +306,45 @@ void CodeGenerator::visit(AssignStmt& s)
   curr_frame.instructions.pop_back();
   s.expr.accept(*this);
 
+  mark(s.lvalue.at(0).var_name);
   if(s.lvalue.size() > 1 && s.lvalue.back().array_expr == nullopt) {
-    curr_frame.instructions.push_back(VMInstr::SETF(s.lvalue.back().var_name.lexeme()));
+    curr_frame.instructions.push_back(VMInstr::SETF(s.lvalue.back().var_name.symbol()));
   }
   else if(s.lvalue.back().array_expr != nullopt) {
     curr_frame.instructions.push_back(VMInstr::SETI());
   }
   else {
-    curr_frame.instructions.push_back(VMInstr::STORE(var_table.get(s.lvalue.back().var_name.lexeme())));
+    curr_frame.instructions.push_back(VMInstr::STORE(var_table.get(s.lvalue.back().var_name.symbol())));
   }
 }
 
 
 void CodeGenerator::visit(CallExpr& e)
 {
-  for(auto e : e.args) {
+  mark(e.fun_name);
+  for(auto& e : e.args) {
     e.accept(*this);
   }
   
-  if(e.fun_name.lexeme() == "print")
+  mark(e.fun_name);
+  if(e.fun_name.symbol() == Symbols::PRINT)
     curr_frame.instructions.push_back(VMInstr::WRITE());
-  else if(e.fun_name.lexeme() == "input")
+  else if(e.fun_name.symbol() == Symbols::INPUT)
     curr_frame.instructions.push_back(VMInstr::READ());
-  else if(e.fun_name.lexeme() == "get")
+  else if(e.fun_name.symbol() == Symbols::GET)
     curr_frame.instructions.push_back(VMInstr::GETC());
-  else if(e.fun_name.lexeme() == "length")
+  else if(e.fun_name.symbol() == Symbols::LENGTH)
     curr_frame.instructions.push_back(VMInstr::SLEN());
-  else if(e.fun_name.lexeme() == "to_int")
+  else if(e.fun_name.symbol() == Symbols::TO_INT)
     curr_frame.instructions.push_back(VMInstr::TOINT());
-  else if(e.fun_name.lexeme() == "to_double")
+  else if(e.fun_name.symbol() == Symbols::TO_DOUBLE)
     curr_frame.instructions.push_back(VMInstr::TODBL());
-  else if(e.fun_name.lexeme() == "to_string")
+  else if(e.fun_name.symbol() == Symbols::TO_STRING)
     curr_frame.instructions.push_back(VMInstr::TOSTR());
-  else if(e.fun_name.lexeme() == "concat")
+  else if(e.fun_name.symbol() == Symbols::CONCAT)
     curr_frame.instructions.push_back(VMInstr::CONCAT());
   else 
-    curr_frame.instructions.push_back(VMInstr::CALL(e.fun_name.lexeme()));
+    curr_frame.instructions.push_back(VMInstr::CALL(e.fun_name.symbol()));
 }
 
 
@@ -254,29 +355,30 @@ void CodeGenerator::visit(Expr& e)
   if(e.op.has_value()) {
     e.rest->accept(*this);
 
-    if(e.op->lexeme() == "+") 
+    mark(*e.op);
+    if(e.op->type() == TokenType::PLUS) 
       curr_frame.instructions.push_back(VMInstr::ADD());
-    else if(e.op->lexeme() == "-") 
+    else if(e.op->type() == TokenType::MINUS) 
       curr_frame.instructions.push_back(VMInstr::SUB());
-    else if(e.op->lexeme() == "*") 
+    else if(e.op->type() == TokenType::TIMES) 
       curr_frame.instructions.push_back(VMInstr::MUL());
-    else if(e.op->lexeme() == "/") 
+    else if(e.op->type() == TokenType::DIVIDE) 
       curr_frame.instructions.push_back(VMInstr::DIV());
-    else if(e.op->lexeme() == "and") 
+    else if(e.op->type() == TokenType::AND) 
       curr_frame.instructions.push_back(VMInstr::AND());
-    else if(e.op->lexeme() == "or") 
+    else if(e.op->type() == TokenType::OR) 
       curr_frame.instructions.push_back(VMInstr::OR());
-    else if(e.op->lexeme() == "<=") 
+    else if(e.op->type() == TokenType::LESS_EQ) 
       curr_frame.instructions.push_back(VMInstr::CMPLE());
-    else if(e.op->lexeme() == "<") 
+    else if(e.op->type() == TokenType::LESS) 
       curr_frame.instructions.push_back(VMInstr::CMPLT());
-    else if(e.op->lexeme() == ">=") 
+    else if(e.op->type() == TokenType::GREATER_EQ) 
       curr_frame.instructions.push_back(VMInstr::CMPGE());
-    else if(e.op->lexeme() == ">") 
+    else if(e.op->type() == TokenType::GREATER) 
       curr_frame.instructions.push_back(VMInstr::CMPGT());
-    else if(e.op->lexeme() == "==") 
+    else if(e.op->type() == TokenType::EQUAL) 
       curr_frame.instructions.push_back(VMInstr::CMPEQ());
-    else if(e.op->lexeme() == "!=") 
+    else if(e.op->type() == TokenType::NOT_EQUAL) 
       curr_frame.instructions.push_back(VMInstr::CMPNE());
   }
   if(e.negated == true) {
@@ -298,12 +400,13 @@ void CodeGenerator::visit(ComplexTerm& t)
 
 void CodeGenerator::visit(SimpleRValue& v)
 {
+  mark(v.value);
   if(v.value.type() == TokenType::INT_VAL) {
-    int new_val = stoi(v.value.lexeme());
+    int new_val = stoi(string(v.value.lexeme()));
     curr_frame.instructions.push_back(VMInstr::PUSH(new_val));
   }
   else if(v.value.type() == TokenType::DOUBLE_VAL) {
-    double new_val = stod(v.value.lexeme());
+    double new_val = stod(string(v.value.lexeme()));
     curr_frame.instructions.push_back(VMInstr::PUSH(new_val));
   }
   else if (v.value.type() == TokenType::NULL_VAL) {
@@ -318,13 +421,13 @@ void CodeGenerator::visit(SimpleRValue& v)
     }
   }
   else if(v.value.type() == TokenType::STRING_VAL) {
-    string s = v.value.lexeme();
+    string s(v.value.lexeme());
     replace_all(s, "\\n", "\n");
     replace_all(s, "\\t ", "\t");
     curr_frame.instructions.push_back(VMInstr::PUSH(s));
   }
   else if(v.value.type() == TokenType::CHAR_VAL) {
-    string s = v.value.lexeme();
+    string s(v.value.lexeme());
     replace_all(s, "\\n", "\n");
     replace_all(s, "\\t", "\t");
     curr_frame.instructions.push_back(VMInstr::PUSH(s));
@@ -333,21 +436,26 @@ void CodeGenerator::visit(SimpleRValue& v)
 
 void CodeGenerator::visit(NewRValue& v)
 {
+  mark(v.type);
   if(v.array_expr.has_value()) {
     v.array_expr->accept(*this);
+    mark(v.type);
 
     curr_frame.instructions.push_back(VMInstr::PUSH(nullptr));
     curr_frame.instructions.push_back(VMInstr::ALLOCA());
   }
   else {
-    curr_frame.instructions.push_back(VMInstr::ALLOCS());
+    curr_frame.instructions.push_back(VMInstr::ALLOCS(v.type.symbol()));
 
-    for(auto& f : struct_defs[v.type.lexeme()].fields) {
+    auto def = struct_defs.find(v.type.symbol());
+    if(def == struct_defs.end())
+      return;
+    for(auto& f : def->second->fields) {
       curr_frame.instructions.push_back(VMInstr::DUP());
-      curr_frame.instructions.push_back(VMInstr::ADDF(f.var_name.lexeme()));
+      curr_frame.instructions.push_back(VMInstr::ADDF(f.var_name.symbol()));
       curr_frame.instructions.push_back(VMInstr::DUP());
       curr_frame.instructions.push_back(VMInstr::PUSH(nullptr));
-      curr_frame.instructions.push_back(VMInstr::SETF(f.var_name.lexeme()));
+      curr_frame.instructions.push_back(VMInstr::SETF(f.var_name.symbol()));
     }
   }
 }
@@ -355,11 +463,12 @@ void CodeGenerator::visit(NewRValue& v)
 
 void CodeGenerator::visit(VarRValue& v)
 {
-  curr_frame.instructions.push_back(VMInstr::LOAD(var_table.get(v.path.at(0).var_name.lexeme())));
+  mark(v.path.at(0).var_name);
+  curr_frame.instructions.push_back(VMInstr::LOAD(var_table.get(v.path.at(0).var_name.symbol())));
 
   for(int i = 0; i < v.path.size(); i++) {
     if(i > 0) {
-      curr_frame.instructions.push_back(VMInstr::GETF(v.path[i].var_name.lexeme()));
+      curr_frame.instructions.push_back(VMInstr::GETF(v.path[i].var_name.symbol()));
     }
 
     if(v.path[i].array_expr.has_value()) {
@@ -376,14 +485,16 @@ void CodeGenerator::visit(SwitchStmt& s) {
     vector<int> jmp;
     vector<int> jmpf;
 
+    // the switch value is kept in an unnamed variable
+    mark(s.switch_expr.value);
     s.switch_expr.accept(*this);
-    var_table.add(s.switch_expr.value.lexeme());
-    curr_frame.instructions.push_back(VMInstr::STORE(var_table.get(s.switch_expr.value.lexeme())));
+    var_table.add(Symbols::NONE);
+    curr_frame.instructions.push_back(VMInstr::STORE(var_table.get(Symbols::NONE)));
 
     int counter = 0;
     bool break_exist = false;
     bool break_dne = false;
-    for(auto b : s.cases) {
+    for(auto& b : s.cases) {
       if(break_exist) {
 
       }
@@ -391,7 +502,7 @@ void CodeGenerator::visit(SwitchStmt& s) {
         b.const_expr.accept(*this);
 
         if(break_dne == false) {
-          curr_frame.instructions.push_back(VMInstr::LOAD(var_table.get(s.switch_expr.value.lexeme())));
+          curr_frame.instructions.push_back(VMInstr::LOAD(var_table.get(Symbols::NONE)));
           curr_frame.instructions.push_back(VMInstr::CMPEQ());
           jmpf.push_back(curr_frame.instructions.size());
           curr_frame.instructions.push_back(VMInstr::JMPF(-1));
@@ -402,7 +513,7 @@ void CodeGenerator::visit(SwitchStmt& s) {
         }
 
         var_table.push_environment();
-        for(auto st : b.stmts) {
+        for(auto& st : b.stmts) {
           st->accept(*this);
         }
         var_table.pop_environment();
@@ -423,9 +534,11 @@ void CodeGenerator::visit(SwitchStmt& s) {
       }
     }
 
-    for(auto st : s.defaults) {
+    var_table.push_environment();
+    for(auto& st : s.defaults) {
       st->accept(*this);
     }
+    var_table.pop_environment();
 
     int index = curr_frame.instructions.size();
     curr_frame.instructions.push_back(VMInstr::NOP());
@@ -9,16 +9,42 @@
 #ifndef CODE_GENERATOR_H
 #define CODE_GENERATOR_H
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include "ast.h"
+#include "semantic_checker.h"
+#include "thread_pool.h"
 #include "var_table.h"
 #include "vm.h"
 
 
+// bumped whenever the generated code changes (invalidates cached code)
+const int CODE_GENERATOR_VERSION = 5;
+
+
 class CodeGenerator : public Visitor {
 public:
-  CodeGenerator(VM& vm);
+  // generates function bodies in parallel on the pool if given (frames
+  // are still added to the vm in program order)
+  CodeGenerator(VM& vm, ThreadPool* pool = nullptr);
+
+  // add the program's structs to the vm, leaving the functions to be
+  // generated individually (visit(Program) does both). The vm must
+  // have no code yet or the program's symbols (see VM::set_symbols).
+  void declare(Program& p);
+
+  // add the program's structs and stubs for its functions to the vm,
+  // which generates each function the first time it is called
+  // (checking its body first if given a checker that has declared the
+  // program). The vm keeps the program and checker alive.
+  static void generate_lazily(std::shared_ptr<Program> program, VM& vm,
+                              std::shared_ptr<SemanticChecker> checker = nullptr);
+
+  // the frame for the function (without adding it to the vm), after
+  // declare
+  VMFrameInfo generate(FunDef& f);
+
   void visit(Program& p);
   void visit(FunDef& f);
   void visit(StructDef& s);
@@ -42,10 +68,18 @@ public:
 private:
 
   VM& vm;
+  ThreadPool* pool;
   VMFrameInfo curr_frame;
   int next_var_index = 0;  
   VarTable var_table;
-  std::unordered_map<std::string,StructDef> struct_defs;
+  std::unordered_map<Symbol,StructDef*> struct_defs;
+
+  // functions whose bodies are generated on demand (lazy mode only)
+  bool lazy = false;
+  std::unordered_map<Symbol,FunDef*> fun_defs;
+
+  // attribute the instructions generated next to the token's line
+  void mark(const Token& t);
 
 };
 
@@ -0,0 +1,219 @@
+//----------------------------------------------------------------------
+// FILE: compile_cache.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Compilation cache implementation
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+#include <unistd.h>
+#include "compile_cache.h"
+#include "bytecode.h"
+#include "code_generator.h"
+#include "incremental.h"
+#include "mypl_exception.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+
+namespace {
+
+  // SHA-256 (FIPS 180-4) of the given bytes as a hex string
+  string sha256(const string& msg)
+  {
+    static const uint32_t K[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+      0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+      0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+      0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+      0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+      0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+      0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+      0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+      0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+    uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                     0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    auto rotr = [](uint32_t x, int n) {return (x >> n) | (x << (32 - n));};
+
+    // pad to a multiple of 64 bytes with the bit length at the end
+    string data = msg;
+    uint64_t bits = (uint64_t)msg.size() * 8;
+    data += (char)0x80;
+    while (data.size() % 64 != 56)
+      data += (char)0;
+    for (int i = 7; i >= 0; --i)
+      data += (char)(bits >> (i * 8));
+
+    for (size_t chunk = 0; chunk < data.size(); chunk += 64) {
+      uint32_t w[64];
+      for (int i = 0; i < 16; ++i) {
+        const unsigned char* p = (const unsigned char*)&data[chunk + i * 4];
+        w[i] = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+      }
+      for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr(w[i-15], 7) ^ rotr(w[i-15], 18) ^ (w[i-15] >> 3);
+        uint32_t s1 = rotr(w[i-2], 17) ^ rotr(w[i-2], 19) ^ (w[i-2] >> 10);
+        w[i] = w[i-16] + s0 + w[i-7] + s1;
+      }
+      uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+      uint32_t e = h[4], f = h[5], g = h[6], k = h[7];
+      for (int i = 0; i < 64; ++i) {
+        uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+        uint32_t ch = (e & f) ^ (~e & g);
+        uint32_t t1 = k + s1 + ch + K[i] + w[i];
+        uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+        uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t t2 = s0 + maj;
+        k = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+      }
+      h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+      h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+    }
+
+    const char* hex = "0123456789abcdef";
+    string digest = "";
+    for (uint32_t word : h)
+      for (int i = 28; i >= 0; i -= 4)
+        digest += hex[(word >> i) & 0xf];
+    return digest;
+  }
+
+}
+
+
+CompileCache::CompileCache(const string& dir, uintmax_t max_bytes)
+  : dir {dir}, max_bytes {max_bytes}
+{
+  error_code ec;
+  fs::create_directories(dir, ec);
+}
+
+
+string CompileCache::default_dir()
+{
+  if (const char* d = getenv("MYPL_CACHE_DIR"))
+    return d;
+  if (const char* d = getenv("XDG_CACHE_HOME"))
+    return string(d) + "/mypl";
+  if (const char* d = getenv("HOME"))
+    return string(d) + "/.cache/mypl";
+  return "";
+}
+
+
+string CompileCache::key(const string& source)
+{
+  // length-prefix the versions so they can't run into the source
+  string versions = to_string(CODE_GENERATOR_VERSION) + "." +
+    to_string(BYTECODE_VERSION);
+  return sha256(to_string(versions.size()) + ":" + versions + source);
+}
+
+
+string CompileCache::path(const string& key) const
+{
+  return dir + "/" + key + BYTECODE_EXT;
+}
+
+
+bool CompileCache::lookup(const string& key, VM& vm)
+{
+  string entry = path(key);
+  error_code ec;
+  if (!fs::exists(entry, ec))
+    return false;
+  try {
+    // (loaded with the vm's symbols, which the frames refer to)
+    VM loaded;
+    loaded.set_symbols(vm.symbols());
+    Bytecode::load(loaded, entry);
+    for (const auto& [name, info] : loaded.frames())
+      vm.add(info);
+    for (const auto& [name, info] : loaded.structs())
+      vm.add(info);
+  } catch (MyPLException& ex) {
+    fs::remove(entry, ec);
+    return false;
+  }
+  // touch the entry so eviction sees it as recently used
+  fs::last_write_time(entry, fs::file_time_type::clock::now(), ec);
+  return true;
+}
+
+
+void CompileCache::store(const string& key, const VM& vm)
+{
+  // write to a unique temporary file in the same directory and rename
+  // it into place, so readers only ever see complete entries
+  random_device rd;
+  string tmp = dir + "/." + key + "." + to_string(getpid()) + "." +
+    to_string(rd()) + ".tmp";
+  string image = Bytecode::serialize(vm);
+  {
+    ofstream out(tmp, ios::binary | ios::trunc);
+    if (!out)
+      return;
+    out.write(image.data(), image.size());
+    out.close();
+    if (!out) {
+      error_code ec;
+      fs::remove(tmp, ec);
+      return;
+    }
+  }
+  error_code ec;
+  fs::rename(tmp, path(key), ec);
+  if (ec) {
+    fs::remove(tmp, ec);
+    return;
+  }
+  evict(path(key));
+}
+
+
+void CompileCache::evict(const string& keep)
+{
+  struct Entry {
+    fs::path path;
+    fs::file_time_type time;
+    uintmax_t size;
+  };
+  vector<Entry> entries;
+  uintmax_t total = 0;
+  error_code ec;
+  for (const auto& f : fs::directory_iterator(dir, ec)) {
+    if (f.path().extension() != BYTECODE_EXT and
+        f.path().extension() != INCREMENTAL_EXT)
+      continue;
+    error_code fec;
+    uintmax_t size = f.file_size(fec);
+    fs::file_time_type time = f.last_write_time(fec);
+    if (fec)
+      continue;
+    entries.push_back({f.path(), time, size});
+    total += size;
+  }
+  if (total <= max_bytes)
+    return;
+  sort(entries.begin(), entries.end(),
+       [](const Entry& a, const Entry& b) {return a.time < b.time;});
+  // another process may evict the same entries concurrently, which is
+  // harmless (remove just fails)
+  for (const Entry& e : entries) {
+    if (total <= max_bytes)
+      break;
+    if (e.path == keep)
+      continue;
+    fs::remove(e.path, ec);
+    total -= e.size;
+  }
+}
@@ -0,0 +1,64 @@
+//----------------------------------------------------------------------
+// FILE: compile_cache.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Content-addressed on-disk cache of compiled bytecode, shared
+// by all mypl processes on a host.
+//----------------------------------------------------------------------
+
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include "vm.h"
+
+
+class CompileCache
+{
+public:
+
+  // default bound on the total size of the cache directory
+  static const uintmax_t DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+
+  // create a cache over the given directory (created if needed)
+  CompileCache(const std::string& dir, uintmax_t max_bytes = DEFAULT_MAX_BYTES);
+
+  // the cache directory from MYPL_CACHE_DIR, XDG_CACHE_HOME, or HOME
+  // (or empty string if none are set)
+  static std::string default_dir();
+
+  // the cache key for the source text (also covers the compiler and
+  // bytecode versions). No option changes the code generated (parallel
+  // and incremental compiles generate the same frames, and lazy ones
+  // aren't cached), so none are part of the key.
+  static std::string key(const std::string& source);
+
+  // load the cached program for key into the vm, returns false on a
+  // miss (a corrupt entry is removed and treated as a miss)
+  bool lookup(const std::string& key, VM& vm);
+
+  // atomically add the compiled program in the vm under the key, then
+  // evict least recently used entries (and incremental compile state
+  // files) until under the size bound
+  void store(const std::string& key, const VM& vm);
+
+  // the path of the entry for the given key
+  std::string path(const std::string& key) const;
+
+private:
+
+  // the cache directory
+  std::string dir;
+
+  // bound on the total bytes of all entries
+  uintmax_t max_bytes;
+
+  // remove least recently used entries and state files until under
+  // max_bytes, except for the given (just stored) entry
+  void evict(const std::string& keep);
+
+};
+
+
+#endif
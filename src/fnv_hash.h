@@ -0,0 +1,64 @@
+//----------------------------------------------------------------------
+// FILE: fnv_hash.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: 64-bit FNV-1a hash for fingerprinting source definitions
+//----------------------------------------------------------------------
+
+#ifndef FNV_HASH_H
+#define FNV_HASH_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+
+class FnvHash
+{
+public:
+
+  // add a part (parts are separated, so different splits can't collide)
+  void add(std::string_view s)
+  {
+    for (unsigned char c : s)
+      mix(c);
+    mix(0xff);
+  }
+
+  // add a number (as its 8 bytes)
+  void add_number(uint64_t n)
+  {
+    for (int i = 0; i < 64; i += 8)
+      mix((n >> i) & 0xff);
+  }
+
+  // the hash so far
+  uint64_t value() const
+  {
+    return hash;
+  }
+
+  // the hash so far as 16 hex digits
+  std::string hex() const
+  {
+    const char* digits = "0123456789abcdef";
+    std::string s = "";
+    for (int i = 60; i >= 0; i -= 4)
+      s += digits[(hash >> i) & 0xf];
+    return s;
+  }
+
+private:
+
+  uint64_t hash = 14695981039346656037ull;
+
+  void mix(unsigned char c)
+  {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+
+};
+
+
+#endif
@@ -0,0 +1,207 @@
+//----------------------------------------------------------------------
+// FILE: heap_profiler.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: HeapProfiler implementation
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <csignal>
+#include <iomanip>
+#include <vector>
+#include "heap_profiler.h"
+
+using namespace std;
+
+
+namespace {
+
+  // set by the signal handler, checked (and cleared) at allocations
+  volatile sig_atomic_t signaled = 0;
+
+  void on_signal(int)
+  {
+    signaled = 1;
+  }
+
+}
+
+
+void HeapProfiler::add(Site& site, uint64_t objects, uint64_t bytes)
+{
+  for (Tally* tally : {&site.tally, &totals}) {
+    tally->objects += objects;
+    tally->bytes += bytes;
+    tally->live_objects += objects;
+    tally->live_bytes += bytes;
+  }
+}
+
+
+void HeapProfiler::remove(Site& site, uint64_t objects, uint64_t bytes)
+{
+  for (Tally* tally : {&site.tally, &totals}) {
+    tally->live_objects -= objects;
+    tally->live_bytes -= bytes;
+  }
+}
+
+
+void HeapProfiler::allocate(int oid, const VMFrameInfo& info, int pc,
+                            const string& type, size_t bytes)
+{
+  Site& site = sites[{info.function_name, pc}];
+  if (site.function == "") {
+    site.function = info.function_name;
+    site.pc = pc;
+    site.line = info.line(pc);
+    site.type = type;
+  }
+  // case: an object id reused (e.g., after the heap was reset)
+  free(oid);
+  objects[oid] = {&site, bytes};
+  add(site, 1, bytes);
+
+  if (signaled and signal_out) {
+    signaled = 0;
+    report(*signal_out);
+  }
+}
+
+
+void HeapProfiler::grow(int oid, size_t bytes)
+{
+  auto object = objects.find(oid);
+  if (object == objects.end())
+    return;
+  object->second.bytes += bytes;
+  add(*object->second.site, 0, bytes);
+}
+
+
+void HeapProfiler::free(int oid)
+{
+  auto object = objects.find(oid);
+  if (object == objects.end())
+    return;
+  remove(*object->second.site, 1, object->second.bytes);
+  objects.erase(object);
+}
+
+
+void HeapProfiler::free_all()
+{
+  for (auto& [key, site] : sites) {
+    site.tally.live_objects = 0;
+    site.tally.live_bytes = 0;
+  }
+  totals.live_objects = 0;
+  totals.live_bytes = 0;
+  objects.clear();
+}
+
+
+string HeapProfiler::site(int oid) const
+{
+  auto object = objects.find(oid);
+  if (object == objects.end())
+    return "";
+  return object->second.site->function + ":" +
+    to_string(object->second.site->pc);
+}
+
+
+uint64_t HeapProfiler::total_bytes() const
+{
+  return totals.bytes;
+}
+
+
+uint64_t HeapProfiler::live_bytes() const
+{
+  return totals.live_bytes;
+}
+
+
+void HeapProfiler::report_on(int signal, ostream& out)
+{
+  signal_out = &out;
+  std::signal(signal, on_signal);
+}
+
+
+namespace {
+
+  // the rows with the most bytes first (ties by name), at most top
+  template<typename T, typename Name>
+  vector<const T*> hottest(const vector<const T*>& rows, size_t top,
+                           Name name)
+  {
+    vector<const T*> sorted = rows;
+    sort(sorted.begin(), sorted.end(), [&](const T* a, const T* b) {
+      if (a->tally.bytes != b->tally.bytes)
+        return a->tally.bytes > b->tally.bytes;
+      return name(a) < name(b);
+    });
+    if (sorted.size() > top)
+      sorted.resize(top);
+    return sorted;
+  }
+
+}
+
+
+void HeapProfiler::report(ostream& out, size_t top) const
+{
+  auto columns = [&](const Tally& tally) {
+    out << setw(12) << tally.objects << setw(14) << tally.bytes
+        << setw(12) << tally.live_objects << setw(14) << tally.live_bytes;
+  };
+  auto header = [&](const string& title, const string& name) {
+    out << endl << title << " (top " << top << " by bytes)" << endl;
+    out << setw(12) << "objects" << setw(14) << "bytes" << setw(12)
+        << "live" << setw(14) << "live bytes" << "  " << name << endl;
+  };
+
+  out << endl << "Heap: " << totals.objects << " objects, " << totals.bytes
+      << " bytes allocated (" << totals.live_objects << " objects, "
+      << totals.live_bytes << " bytes live)" << endl;
+
+  vector<const Site*> site_rows;
+  for (const auto& [key, site] : sites)
+    site_rows.push_back(&site);
+  header("Allocation sites", "site");
+  auto site_name = [](const Site* s) {
+    return s->function + ":" + to_string(s->pc);
+  };
+  for (const Site* s : hottest(site_rows, top, site_name)) {
+    columns(s->tally);
+    out << "  " << site_name(s);
+    if (s->line > 0)
+      out << " (line " << s->line << ")";
+    out << " " << s->type << endl;
+  }
+
+  struct Type {
+    string name;
+    Tally tally;
+  };
+  unordered_map<string, Type> types;
+  for (const auto& [key, site] : sites) {
+    Type& type = types[site.type];
+    type.name = site.type;
+    type.tally.objects += site.tally.objects;
+    type.tally.bytes += site.tally.bytes;
+    type.tally.live_objects += site.tally.live_objects;
+    type.tally.live_bytes += site.tally.live_bytes;
+  }
+  vector<const Type*> type_rows;
+  for (const auto& [name, type] : types)
+    type_rows.push_back(&type);
+  header("Types", "type");
+  for (const Type* t : hottest(type_rows, top,
+                               [](const Type* t) { return t->name; })) {
+    columns(t->tally);
+    out << "  " << t->name << endl;
+  }
+}
@@ -0,0 +1,94 @@
+//----------------------------------------------------------------------
+// FILE: heap_profiler.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Heap profile of a vm run. Each struct and array object is
+// tagged with the function and instruction (the allocation site) that
+// created it, and the objects and bytes allocated (in total, and still
+// live) are tallied per site and per type.
+//----------------------------------------------------------------------
+
+#ifndef HEAP_PROFILER_H
+#define HEAP_PROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "vm_frame.h"
+
+
+class HeapProfiler
+{
+public:
+
+  // the vm calls these as it runs (see VM::set_heap_profiler): the
+  // instruction at pc of the function allocates the object of the type
+  // ("array" for arrays) and size, the object grows (e.g., adds a
+  // field), and objects are freed
+  void allocate(int oid, const VMFrameInfo& info, int pc,
+                const std::string& type, size_t bytes);
+  void grow(int oid, size_t bytes);
+  void free(int oid);
+  void free_all();
+
+  // the allocation site of the object as "function:pc" (empty if not
+  // allocated while profiling)
+  std::string site(int oid) const;
+
+  // the bytes allocated in total, and still live
+  uint64_t total_bytes() const;
+  uint64_t live_bytes() const;
+
+  // write the sites and types allocating the most bytes (with their
+  // objects and bytes in total and still live)
+  void report(std::ostream& out, size_t top = 20) const;
+
+  // write a report to out at the next allocation after the signal
+  // arrives (e.g., SIGUSR1, to see a long run's heap as it grows)
+  void report_on(int signal, std::ostream& out);
+
+private:
+
+  struct Tally {
+    uint64_t objects = 0;
+    uint64_t bytes = 0;
+    uint64_t live_objects = 0;
+    uint64_t live_bytes = 0;
+  };
+
+  struct Site {
+    std::string function;
+    int pc = 0;
+    int line = 0;
+    std::string type;
+    Tally tally;
+  };
+
+  struct Object {
+    Site* site;
+    size_t bytes;
+  };
+
+  // sites keyed by function name and pc (frames run copies of their
+  // function's info, so its address doesn't identify it)
+  std::map<std::pair<std::string, int>, Site> sites;
+
+  std::unordered_map<int, Object> objects;
+
+  Tally totals;
+
+  // where to report on a signal (nullptr if not asked for)
+  std::ostream* signal_out = nullptr;
+
+  // the tallies of the site and of every site
+  void add(Site& site, uint64_t objects, uint64_t bytes);
+  void remove(Site& site, uint64_t objects, uint64_t bytes);
+
+};
+
+
+#endif
@@ -0,0 +1,311 @@
+//----------------------------------------------------------------------
+// FILE: incremental.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Incremental compiler implementation
+//----------------------------------------------------------------------
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <unordered_set>
+#include <vector>
+#include <unistd.h>
+#include "incremental.h"
+#include "bytecode.h"
+#include "code_generator.h"
+#include "fnv_hash.h"
+#include "mypl_exception.h"
+#include "semantic_checker.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+
+namespace {
+
+  string type_string(const DataType& t, const Interner& symbols)
+  {
+    return (t.is_array ? "array " : "") + string(t.type_name(symbols));
+  }
+
+  // state files start with this line
+  const string STATE_HEADER = "mypl incremental " +
+    to_string(CODE_GENERATOR_VERSION) + "\n";
+
+}
+
+
+unordered_map<string, string> IncrementalCompiler::fingerprints(const Program& p)
+{
+  // the hash of each struct's tokens
+  unordered_map<Symbol, uint64_t> own;
+  unordered_map<Symbol, const StructDef*> defs;
+  for (const StructDef& s : p.struct_defs) {
+    FnvHash h;
+    h.add("struct");
+    h.add(s.struct_name.lexeme());
+    h.add_number(s.fingerprint.tokens);
+    own[s.struct_name.symbol()] = h.value();
+    defs[s.struct_name.symbol()] = &s;
+  }
+  // each struct's hash also covers the structs it names, transitively
+  // (a field path like q.p.y depends on every struct along it), summed
+  // since symbol order can differ between runs
+  unordered_map<Symbol, uint64_t> structs;
+  for (const auto& [id, hash] : own) {
+    uint64_t sum = 0;
+    unordered_set<Symbol> seen = {id};
+    vector<Symbol> pending = {id};
+    while (!pending.empty()) {
+      Symbol next = pending.back();
+      pending.pop_back();
+      sum += own[next];
+      for (Symbol name : defs[next]->fingerprint.names)
+        if (defs.contains(name) and seen.insert(name).second)
+          pending.push_back(name);
+    }
+    structs[id] = sum;
+  }
+  // the hash of each function's signature (with the structs it names)
+  unordered_map<Symbol, uint64_t> signatures;
+  for (const FunDef& f : p.fun_defs) {
+    FnvHash h;
+    h.add("function");
+    h.add(f.fun_name.lexeme());
+    h.add(type_string(f.return_type, *p.symbols));
+    for (const VarDef& param : f.params)
+      h.add(type_string(param.data_type, *p.symbols));
+    uint64_t types = 0;
+    unordered_set<Symbol> named;
+    auto name_type = [&](Symbol id) {
+      auto s = structs.find(id);
+      if (s != structs.end() and named.insert(id).second)
+        types += s->second;
+    };
+    name_type(f.return_type.type_id);
+    for (const VarDef& param : f.params)
+      name_type(param.data_type.type_id);
+    h.add_number(types);
+    signatures[f.fun_name.symbol()] = h.value();
+  }
+  unordered_map<string, string> result;
+  // the index of the function each symbol was last counted for
+  vector<size_t> counted;
+  for (size_t i = 0; i < p.fun_defs.size(); ++i) {
+    const FunDef& f = p.fun_defs[i];
+    string name(f.fun_name.lexeme());
+    if (f.fingerprint.tokens == 0) {
+      result[name] = "";
+      continue;
+    }
+    // the hashes are summed since symbol order can differ between runs
+    // (names that are neither are variables or undefined, which the
+    // function's own tokens already cover)
+    uint64_t dependencies = 0;
+    auto depend = [&](Symbol id) {
+      if (id >= counted.size())
+        counted.resize(id + 1, p.fun_defs.size());
+      if (counted[id] == i)
+        return;
+      counted[id] = i;
+      auto s = structs.find(id);
+      if (s != structs.end())
+        dependencies += s->second;
+      auto signature = signatures.find(id);
+      if (signature != signatures.end())
+        dependencies += signature->second;
+    };
+    depend(f.return_type.type_id);
+    for (Symbol id : f.fingerprint.names)
+      depend(id);
+    FnvHash h;
+    h.add_number(f.fingerprint.tokens);
+    h.add_number(signatures[f.fun_name.symbol()]);
+    h.add_number(dependencies);
+    result[name] = h.hex();
+  }
+  return result;
+}
+
+
+void IncrementalCompiler::compile(Program& p, VM& vm, ThreadPool* pool)
+{
+  // (the saved frames refer to the program's symbols)
+  saved->set_symbols(p.symbols);
+  SemanticChecker checker;
+  checker.declare(p);
+  CodeGenerator generator(vm);
+  generator.declare(p);
+  unordered_map<string, string> current = fingerprints(p);
+  // the functions to check and generate, in program order
+  vector<FunDef*> changed;
+  for (FunDef& f : p.fun_defs) {
+    const string& fingerprint = current[string(f.fun_name.lexeme())];
+    auto old = functions.find(string(f.fun_name.lexeme()));
+    if (fingerprint == "" or old == functions.end() or
+        old->second.fingerprint != fingerprint)
+      changed.push_back(&f);
+  }
+  vector<VMFrameInfo> generated(changed.size());
+  if (pool == nullptr or pool->size() == 1) {
+    for (size_t i = 0; i < changed.size(); ++i) {
+      changed[i]->accept(checker);
+      generated[i] = generator.generate(*changed[i]);
+    }
+  }
+  else {
+    // as in SemanticChecker and CodeGenerator, each worker has its own
+    // copies, and the error reported is the first in program order
+    vector<SemanticChecker> checkers(pool->size(), checker);
+    vector<CodeGenerator> generators(pool->size(), generator);
+    vector<exception_ptr> errors(changed.size());
+    pool->run(changed.size(), [&](size_t worker, size_t i) {
+      try {
+        changed[i]->accept(checkers[worker]);
+        generated[i] = generators[worker].generate(*changed[i]);
+      } catch (MyPLException& ex) {
+        errors[i] = current_exception();
+      }
+    });
+    for (exception_ptr& error : errors)
+      if (error)
+        rethrow_exception(error);
+  }
+  // the compile can no longer fail, so the state is updated in place
+  unordered_map<string, Entry> compiled;
+  size_t next = 0;
+  for (FunDef& f : p.fun_defs) {
+    string name(f.fun_name.lexeme());
+    int line = f.fun_name.line();
+    if (next < changed.size() and changed[next] == &f) {
+      vm.add(generated[next]);
+      saved->add(std::move(generated[next++]));
+      compiled[name] = {current[name], line};
+      dirty = true;
+      continue;
+    }
+    Entry entry = functions[name];
+    const VMFrameInfo& frame = saved->frames().at(name);
+    if (entry.line == line)
+      vm.add(frame);
+    else {
+      // the function moved up or down the file
+      VMFrameInfo moved = frame;
+      for (VMLine& l : moved.lines)
+        l.line += line - entry.line;
+      vm.add(moved);
+      saved->add(std::move(moved));
+      entry.line = line;
+      dirty = true;
+    }
+    compiled[name] = entry;
+  }
+  // case: functions were removed
+  if (saved->frames().size() > compiled.size()) {
+    auto kept = make_unique<VM>();
+    kept->set_symbols(saved->symbols());
+    for (const auto& [name, entry] : compiled)
+      kept->add(saved->frames().at(name));
+    saved = std::move(kept);
+    dirty = true;
+  }
+  functions = std::move(compiled);
+  recompiled_count = changed.size();
+}
+
+
+shared_ptr<Interner> IncrementalCompiler::symbols() const
+{
+  return saved->symbols();
+}
+
+
+size_t IncrementalCompiler::recompiled() const
+{
+  return recompiled_count;
+}
+
+
+void IncrementalCompiler::save(const string& path, const string& image_path)
+{
+  if (!dirty)
+    return;
+  // the file is the length of the bytecode image (0 if it is in the
+  // image file), the (8-byte aligned) image of the frames, the header,
+  // the image file's path (if any), then a line per function with its
+  // fingerprint
+  string table = STATE_HEADER;
+  if (image_path != "")
+    table += image_path + "\n";
+  for (const auto& [name, entry] : functions)
+    table += name + " " + entry.fingerprint + " " + to_string(entry.line) +
+      "\n";
+  string image = image_path == "" ? Bytecode::serialize(*saved) : "";
+  uint64_t image_size = image.size();
+  random_device rd;
+  string tmp = path + "." + to_string(getpid()) + "." + to_string(rd()) +
+    ".tmp";
+  {
+    ofstream out(tmp, ios::binary | ios::trunc);
+    if (!out)
+      return;
+    out.write((const char*)&image_size, sizeof(image_size));
+    out.write(image.data(), image.size());
+    out.write(table.data(), table.size());
+    out.close();
+    if (!out) {
+      error_code ec;
+      fs::remove(tmp, ec);
+      return;
+    }
+  }
+  error_code ec;
+  fs::rename(tmp, path, ec);
+  if (ec)
+    fs::remove(tmp, ec);
+  else
+    dirty = false;
+}
+
+
+bool IncrementalCompiler::load(const string& path)
+{
+  functions.clear();
+  shared_ptr<Interner> symbols = saved->symbols();
+  saved = make_unique<VM>();
+  saved->set_symbols(symbols);
+  dirty = false;
+  ifstream in(path, ios::binary);
+  uint64_t image_size = 0;
+  if (!in.read((char*)&image_size, sizeof(image_size)))
+    return false;
+  in.seekg(sizeof(image_size) + image_size);
+  string header;
+  string image_path;
+  if (!getline(in, header) or header + "\n" != STATE_HEADER or
+      (image_size == 0 and !getline(in, image_path)))
+    return false;
+  try {
+    if (image_size == 0)
+      Bytecode::load(*saved, image_path);
+    else
+      Bytecode::load(*saved, path, sizeof(image_size), image_size);
+  } catch (MyPLException& ex) {
+    saved = make_unique<VM>();
+    saved->set_symbols(symbols);
+    return false;
+  }
+  string name;
+  string fingerprint;
+  int line;
+  while (in >> name >> fingerprint >> line)
+    if (saved->frames().contains(name))
+      functions[name] = {fingerprint, line};
+  return true;
+}
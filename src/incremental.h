@@ -0,0 +1,84 @@
+//----------------------------------------------------------------------
+// FILE: incremental.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Incremental compiler that keeps the code of each function
+// between compiles, and only re-checks and re-generates functions
+// whose fingerprint (tokens plus the signatures they use) changed.
+// Programs must be parsed with fingerprinting on, and lexed with the
+// compiler's symbols.
+//----------------------------------------------------------------------
+
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "ast.h"
+#include "thread_pool.h"
+#include "vm.h"
+
+
+// the standard file extension for saved state
+const std::string INCREMENTAL_EXT = ".mypli";
+
+
+class IncrementalCompiler
+{
+public:
+
+  // check and compile the program into the vm, reusing the frames of
+  // unchanged functions from the last successful compile (a failed
+  // compile leaves the saved state as it was), checking and generating
+  // the changed functions in parallel on the pool if given
+  void compile(Program& p, VM& vm, ThreadPool* pool = nullptr);
+
+  // the interner to lex programs with, which the saved frames' symbols
+  // come from (the first program compiled sets it if not yet used)
+  std::shared_ptr<Interner> symbols() const;
+
+  // number of functions checked and generated by the last compile
+  size_t recompiled() const;
+
+  // save the fingerprints and frames of the last compile to a file
+  // (replacing it atomically), unless they are unchanged since they
+  // were loaded or last saved. Given the bytecode file that the vm of
+  // the last compile is written to (e.g., its compile cache entry),
+  // only the fingerprints are saved, and the frames are read from it.
+  void save(const std::string& path, const std::string& image_path = "");
+
+  // restore the state saved to the file, returns false (leaving the
+  // state empty) if there is none or it (or the bytecode file it refers
+  // to) is unreadable
+  bool load(const std::string& path);
+
+  // the fingerprint of each function in the program, keyed by name: a
+  // hash of the function's tokens, its own signature, and the
+  // signatures of the functions (and tokens of the structs) it names
+  // ("" for functions parsed without fingerprinting)
+  static std::unordered_map<std::string, std::string>
+  fingerprints(const Program& p);
+
+private:
+
+  struct Entry {
+    std::string fingerprint;
+    // the line the function's name is on
+    int line;
+  };
+
+  // the compiled functions by name, and their frames (kept in a vm so
+  // they can be loaded and saved without copying)
+  std::unordered_map<std::string, Entry> functions;
+  std::unique_ptr<VM> saved = std::make_unique<VM>();
+
+  size_t recompiled_count = 0;
+
+  // true if the functions differ from the ones loaded or last saved
+  bool dirty = false;
+
+};
+
+
+#endif
@@ -0,0 +1,66 @@
+//----------------------------------------------------------------------
+// FILE: interner.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Interner implementation
+//----------------------------------------------------------------------
+
+#include <mutex>
+#include "interner.h"
+
+using namespace std;
+
+
+Interner::Interner()
+{
+  // must match the Symbols constants
+  for (string_view name : {"", "int", "double", "char", "string", "bool",
+                           "void", "main", "return", "print", "input",
+                           "to_string", "to_int", "to_double", "length",
+                           "get", "concat"})
+    intern(name);
+}
+
+
+Symbol Interner::intern(string_view name)
+{
+  {
+    shared_lock<shared_mutex> lock(mutex);
+    auto entry = symbols.find(name);
+    if (entry != symbols.end())
+      return entry->second;
+  }
+  unique_lock<shared_mutex> lock(mutex);
+  // another thread may have added it while unlocked
+  auto entry = symbols.find(name);
+  if (entry != symbols.end())
+    return entry->second;
+  Symbol symbol = names.size();
+  names.emplace_back(name);
+  symbols[names.back()] = symbol;
+  return symbol;
+}
+
+
+Symbol Interner::find(string_view name) const
+{
+  shared_lock<shared_mutex> lock(mutex);
+  auto entry = symbols.find(name);
+  return entry == symbols.end() ? Symbols::NONE : entry->second;
+}
+
+
+string_view Interner::name(Symbol symbol) const
+{
+  shared_lock<shared_mutex> lock(mutex);
+  if (symbol >= names.size())
+    return "";
+  return names[symbol];
+}
+
+
+size_t Interner::size() const
+{
+  shared_lock<shared_mutex> lock(mutex);
+  return names.size();
+}
@@ -0,0 +1,90 @@
+//----------------------------------------------------------------------
+// FILE: interner.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Table of interned identifiers. Each distinct name gets a dense
+// integer symbol, so the front end and vm compare and index by symbol
+// instead of hashing strings. A lexer creates one (or is given one),
+// the program it parses carries it, and the module compiled from the
+// program keeps it, so the symbols live as long as their module.
+//----------------------------------------------------------------------
+
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+
+// the id of an interned name
+typedef uint32_t Symbol;
+
+
+// names that are interned up front (in this order) so they have fixed
+// symbols
+namespace Symbols {
+  const Symbol NONE = 0;         // the empty name
+  // base types (INT through BOOL) and void
+  const Symbol INT = 1;
+  const Symbol DOUBLE = 2;
+  const Symbol CHAR = 3;
+  const Symbol STRING = 4;
+  const Symbol BOOL = 5;
+  const Symbol VOID = 6;
+  // special names
+  const Symbol MAIN = 7;
+  const Symbol RETURN = 8;
+  // built-in functions (PRINT through CONCAT)
+  const Symbol PRINT = 9;
+  const Symbol INPUT = 10;
+  const Symbol TO_STRING = 11;
+  const Symbol TO_INT = 12;
+  const Symbol TO_DOUBLE = 13;
+  const Symbol LENGTH = 14;
+  const Symbol GET = 15;
+  const Symbol CONCAT = 16;
+}
+
+
+class Interner
+{
+public:
+
+  // an interner holding just the names with fixed symbols
+  Interner();
+
+  // the symbol for the name (assigning the next one if new)
+  Symbol intern(std::string_view name);
+
+  // the symbol for the name (Symbols::NONE if it was never interned)
+  Symbol find(std::string_view name) const;
+
+  // the name of the symbol (empty if not a symbol)
+  std::string_view name(Symbol symbol) const;
+
+  // the number of symbols assigned so far
+  size_t size() const;
+
+  Interner(const Interner&) = delete;
+  Interner& operator=(const Interner&) = delete;
+
+private:
+
+  // guards both tables, as chunks of a program are lexed in parallel
+  // (lookups only take a shared lock)
+  mutable std::shared_mutex mutex;
+
+  // names indexed by symbol (a deque so they never move)
+  std::deque<std::string> names;
+
+  // symbols keyed by views of the names above
+  std::unordered_map<std::string_view, Symbol> symbols;
+
+};
+
+
+#endif
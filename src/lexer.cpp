@@ -1,392 +1,616 @@
-//----------------------------------------------------------------------
-// FILE: lexer.cpp
-// DATE: CPSC 326, Spring 2023
-// NAME: 
-// DESC: 
-//----------------------------------------------------------------------
-
-#include "lexer.h"
-
-using namespace std;
-
-
-Lexer::Lexer(istream& input_stream)
-  : input {input_stream}, column {0}, line {1}
-{}
-
-
-char Lexer::read()
-{
-  ++column;
-  return input.get();
-}
-
-
-char Lexer::peek()
-{
-  return input.peek();
-}
-
-
-void Lexer::error(const string& msg, int line, int column) const
-{
-  throw MyPLException::LexerError(msg + " at line " + to_string(line) +
-                                  ", column " + to_string(column));
-}
-
-
-Token Lexer::next_token()
-{ 
-  //check for whitespace, tabs, newlines and comments
-  while((isspace(input.peek()))||(input.peek() == '#')){
-    if(peek() == '#'){
-      while((input.peek() != '\n')&&(input.peek() != EOF)){
-        read();
-      }
-    }
-    else{
-      if(peek() == '\n'){
-        ++line;
-        column = 0;
-      }
-      else{
-        ++column;
-      }
-      input.get();
-    }
-  }
-  
-  //check for EOF
-  if(peek() == EOF){
-
-    ++column;
-    return Token(TokenType::EOS,"end-of-stream",line,column);
-  }
-
-  //check for single characters and two characters
-  if(peek() == ':'){
-    read();
-    return Token(TokenType::COLON,":",line,column); 
-  }
-  
-  if(peek() == '.'){
-    read();
-    return Token(TokenType::DOT,".",line,column); 
-  }
-  if(peek() == ','){
-    read();
-    return Token(TokenType::COMMA,",",line,column); 
-  }
-  if(peek() == ';'){
-    read();
-    return Token(TokenType::SEMICOLON,";",line,column); 
-  }
-  if(peek() == '('){
-    read();
-    return Token(TokenType::LPAREN,"(",line,column); 
-  }
-  if(peek() == ')'){
-    read();
-    return Token(TokenType::RPAREN,")",line,column); 
-  }
-  if(peek() == '{'){
-    read();
-    return Token(TokenType::LBRACE,"{",line,column); 
-  }
-  if(peek() == '}'){
-    read();
-    return Token(TokenType::RBRACE,"}",line,column); 
-  }
-  if(peek() == '['){
-    read();
-    return Token(TokenType::LBRACKET,"[",line,column); 
-  }
-  if(peek() == ']'){
-    read();
-    return Token(TokenType::RBRACKET,"]",line,column); 
-  }
-  if(peek() == '+'){
-    read();
-    return Token(TokenType::PLUS,"+",line,column); 
-  }
-  if(peek() == '-'){
-    read();
-    return Token(TokenType::MINUS,"-",line,column); 
-  }
-  if(peek() == '*'){
-    read();
-    return Token(TokenType::TIMES,"*",line,column); 
-  }
-  if(peek() == '/'){
-    read();
-    return Token(TokenType::DIVIDE,"/",line,column); 
-  }
-  if(peek() == '<'){
-    read();
-    if(peek() == '='){
-      read();
-      return Token(TokenType::LESS_EQ, "<=", line,column-1);
-    }
-    return Token(TokenType::LESS,"<",line,column); 
-  }
-  if(peek() == '>'){
-    read();
-    if(peek() == '='){
-      read();
-      return Token(TokenType::GREATER_EQ, ">=", line,column-1);
-    }
-    return Token(TokenType::GREATER,">",line,column); 
-  }
-  if(peek() == '!'){
-    read();
-    if(peek() != '='){
-      string s(1,peek());
-      error("expecting '!=' found '!" + s + "'", line,column);
-    }
-    else{
-      read();
-      return Token(TokenType::NOT_EQUAL,"!=",line,column-1);
-    }
-  }
-  if(peek() == '='){
-    read();
-    if(input.peek() == '='){
-      read();
-      return Token(TokenType::EQUAL, "==", line,column-1);
-    }
-    return Token(TokenType::ASSIGN,"=",line,column); 
-  }
-  // check for characters
-  if(peek() == '\''){
-    string char_val = "";
-    bool slashes = false;
-    int num_chars = 0;
-    string additional = "";
-    read();
-    if(peek() == '\n' ){
-      read();
-      error("found end-of-line in character",line,column);      
-    }
-    while((peek() != '\'')&&(peek() != EOF)){
-      if(peek() == '\\' ){
-        char_val += "\\";
-        slashes = true;
-        --num_chars;
-      }
-      ++num_chars;
-      if(num_chars > 1){
-        string s(1,peek());
-        additional += s;
-      }
-      string s(1,peek());
-      read();
-      char_val += s;
-    }
-    if(peek() != '\''){
-      ++column;
-      error("found end-of-file in character",line,column);
-    }
-    if(num_chars > 1){
-      error("expecting ' found " + additional, line,column);
-    }
-    read();
-    if(num_chars == 0){
-      error("empty character", line,column);
-    }
-    if(slashes){
-      return Token(TokenType::CHAR_VAL,char_val,line,column-3);
-    }
-    return Token(TokenType::CHAR_VAL,char_val,line,column-2);
-  }
-  if(peek() == '\"'){
-    string string_val = "";
-    bool slashes = false;
-    int num_chars = 0;
-    read();
-    while((peek() != '\"')&&(peek() != EOF)){
-      if(peek() == '\n' ){
-        read();
-        error("found end-of-line in string",line,column);      
-      }
-      if(peek() == '\\' ){
-        string_val += "\\";
-        slashes = true;
-        --num_chars;
-        --column;
-      }
-      ++num_chars;
-      if((peek() != '\\')&&(peek() != '\"')){
-        string s(1,peek());
-        string_val += s;
-      }
-      read();
-    }
-    if(peek() != '\"'){
-      ++column;
-      error("found end-of-file in string",line,column-num_chars);
-    }
-    read();
-    ++num_chars;
-    return Token(TokenType::STRING_VAL,string_val,line,column-num_chars);
-  }
-
-  //check for integer or double
-  if(isdigit(peek())){
-    int dot = 0; 
-    string before = "";
-    string after = "";
-    bool dont_continue = false;
-    while((dot <= 1)&&(!isspace(peek()))&&(peek() != EOF)){
-      if(peek() == '.'){
-        if(dot == 0){
-          dot += 1;
-        }else{
-          break;
-        }
-      }
-      if((isalpha(peek()))&&(dot == 1)&&(after == "")){
-        read();
-        error("missing digit in '" + before + ".'", line,column);
-      }
-      if((isdigit(peek()))&&(dot == 0)){
-        ++column;
-        int i = input.peek() - '0';
-        before += to_string(i);
-      }else if((isdigit(peek()))&&(dot == 1)){
-        ++column;
-        int i = peek() - '0';
-        after += to_string(i);
-      }else if(peek() != '.'){
-        break;
-      }
-      else{
-        ++column;
-      }
-      input.get();
-    }
-    if((before[0] == '0' )&&(before.length() > 1 )&&(dot == 0 )){
-      error("leading zero in number", line, column-before.length() +1);
-    }
-    if(dot == 0){
-      return Token(TokenType::INT_VAL,before,line,column-before.length()+1);
-    }else{
-      if((dot == 1)&&(after.length() == 0)){
-        error("missing digit in '" + before + ".'", line,column);
-      }
-      return Token(TokenType::DOUBLE_VAL,before + "." + after,line,column-after.length()-before.length());
-    }
-  }
-
-  //check for reserved words
-  if(isalpha(peek())){
-    string val = "";
-    bool has_digit = false;
-    //check if it forms null or new
-    while((!isspace(peek()))&&(peek() != EOF)&&(peek() != '\n')){
-      if(!isalpha(peek())&&(peek() != '_')&&(!isdigit(peek()))){
-        break;
-      }
-      if(isalpha(peek())){
-        val += peek();
-      }
-      else{
-        val += peek();
-        has_digit = true;
-      }
-      read();
-    }
-    //identifier
-    if(has_digit){
-      return Token(TokenType::ID, val, line, column-val.length()+1);
-    }
-    //reserved words null, new, not
-    if(val == "null"){
-      return Token(TokenType::NULL_VAL, "null", line, column-val.length()+1);
-    }
-    if(val == "new"){
-      return Token(TokenType::NEW, "new", line, column-val.length()+1);
-    }
-    if(val == "not"){
-      return Token(TokenType::NOT, "not", line, column-val.length()+1);
-    }
-    //reserved words true false if else
-    if(val == "if"){
-      return Token(TokenType::IF,"if", line, column-val.length()+1);
-    }
-    if(val == "or"){
-      return Token(TokenType::OR, "or", line, column-val.length()+1);
-    }
-    if((val == "true")||(val =="false")){
-      return Token(TokenType::BOOL_VAL, val, line, column-val.length()+1);
-    }
-    if(val == "elseif"){
-      return Token(TokenType::ELSEIF, "elseif", line, column-val.length()+1);
-    }
-    if(val == "else"){
-      return Token(TokenType::ELSE, "else", line, column-val.length()+1);
-    }
-    if(val == "int"){
-      return Token(TokenType::INT_TYPE, "int", line, column-val.length()+1);
-    }
-    if(val == "double"){
-      return Token(TokenType::DOUBLE_TYPE, "double", line, column-val.length()+1);
-    }
-    if(val == "char"){
-      return Token(TokenType::CHAR_TYPE, "char", line, column-val.length()+1);
-    }
-    if(val == "string"){
-      return Token(TokenType::STRING_TYPE, "string", line, column-val.length()+1);
-    }
-    if(val == "bool"){
-      return Token(TokenType::BOOL_TYPE, "bool", line, column-val.length()+1);
-    }
-    if(val == "void"){
-      return Token(TokenType::VOID_TYPE, "void", line, column-val.length()+1);
-    }
-    if(val == "and"){
-      return Token(TokenType::AND, "and", line, column-val.length()+1);
-    }
-    if(val == "for"){
-      return Token(TokenType::FOR, "for", line, column-val.length()+1);
-    }
-    if(val == "or"){
-      return Token(TokenType::OR, "or", line, column-val.length()+1);
-    }
-    if(val == "while"){
-      return Token(TokenType::WHILE, "while", line, column-val.length()+1);
-    }
-    if(val == "struct"){
-      return Token(TokenType::STRUCT, "struct", line, column-val.length()+1);
-    }
-    if(val == "array"){
-      return Token(TokenType::ARRAY, "array", line, column-val.length()+1);
-    }
-    if(val == "return"){
-      return Token(TokenType::RETURN, "return", line, column-val.length()+1);
-    }
-
-    // project words
-    if(val == "switch"){
-      return Token(TokenType::SWITCH, "switch", line, column-val.length()+1);
-    }
-    if(val == "case"){
-      return Token(TokenType::CASE, "case", line, column-val.length()+1);
-    }
-    if(val == "break"){
-      return Token(TokenType::BREAK, "break", line, column-val.length()+1);
-    }
-    if(val == "default"){
-      return Token(TokenType::DEFAULT, "default", line, column-val.length()+1);
-    }
-
-    return Token(TokenType::ID, val, line, column-val.length()+1);
-  }
-
-  string s(1,peek());
-  read();
-  error("unexpected character '" + s + "'", line,column);
-  return Token(TokenType::ID, s, line, column);
-
-}
-  
-
+//----------------------------------------------------------------------
+// FILE: lexer.cpp
+// DATE: CPSC 326, Spring 2023
+// NAME:
+// DESC:
+//----------------------------------------------------------------------
+
+#include <cctype>
+#include <cstring>
+#include "lexer.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define LEXER_SIMD 1
+#endif
+
+using namespace std;
+
+
+namespace {
+
+  //--------------------------------------------------------------------
+  // Scanning helpers: each returns the length of the run of matching
+  // characters starting at p, 16 bytes at a time when SSE2 is
+  // available (with a byte-at-a-time tail)
+  //--------------------------------------------------------------------
+
+#ifdef LEXER_SIMD
+
+  // byte lanes of x within [lo, hi] (unsigned) are set to 0xff
+  inline __m128i in_range(__m128i x, char lo, char hi)
+  {
+    __m128i d = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(hi - lo)), d);
+  }
+
+  // byte lanes of x equal to c are set to 0xff
+  inline __m128i equal(__m128i x, char c)
+  {
+    return _mm_cmpeq_epi8(x, _mm_set1_epi8(c));
+  }
+
+  // bit i set if lane i of m is set
+  inline unsigned bits(__m128i m)
+  {
+    return _mm_movemask_epi8(m);
+  }
+
+#endif
+
+  inline bool is_blank(char c)
+  {
+    return c == ' ' or c == '\t' or c == '\r';
+  }
+
+  inline bool is_alpha(char c)
+  {
+    return (unsigned char)((c | 0x20) - 'a') < 26;
+  }
+
+  inline bool is_digit(char c)
+  {
+    return (unsigned char)(c - '0') < 10;
+  }
+
+  // spaces, tabs, and carriage returns (each is one column wide)
+  size_t blank_run(const char* p, const char* end)
+  {
+    const char* s = p;
+#ifdef LEXER_SIMD
+    while (end - p >= 16) {
+      __m128i x = _mm_loadu_si128((const __m128i*)p);
+      __m128i m = _mm_or_si128(_mm_or_si128(equal(x, ' '), equal(x, '\t')),
+                               equal(x, '\r'));
+      unsigned stop = ~bits(m) & 0xffff;
+      if (stop)
+        return p - s + __builtin_ctz(stop);
+      p += 16;
+    }
+#endif
+    while (p < end and is_blank(*p))
+      ++p;
+    return p - s;
+  }
+
+  // letters, digits, and underscores (non_alpha is set if the run has
+  // a digit or underscore)
+  size_t word_run(const char* p, const char* end, bool& non_alpha)
+  {
+    const char* s = p;
+#ifdef LEXER_SIMD
+    while (end - p >= 16) {
+      __m128i x = _mm_loadu_si128((const __m128i*)p);
+      __m128i alpha = in_range(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 'z');
+      __m128i other = _mm_or_si128(in_range(x, '0', '9'), equal(x, '_'));
+      unsigned word = bits(_mm_or_si128(alpha, other));
+      unsigned stop = ~word & 0xffff;
+      unsigned len = stop ? __builtin_ctz(stop) : 16;
+      if (bits(other) & ((1u << len) - 1))
+        non_alpha = true;
+      p += len;
+      if (stop)
+        return p - s;
+    }
+#endif
+    while (p < end and (is_alpha(*p) or is_digit(*p) or *p == '_')) {
+      if (!is_alpha(*p))
+        non_alpha = true;
+      ++p;
+    }
+    return p - s;
+  }
+
+  // decimal digits
+  size_t digit_run(const char* p, const char* end)
+  {
+    const char* s = p;
+#ifdef LEXER_SIMD
+    while (end - p >= 16) {
+      __m128i x = _mm_loadu_si128((const __m128i*)p);
+      unsigned stop = ~bits(in_range(x, '0', '9')) & 0xffff;
+      if (stop)
+        return p - s + __builtin_ctz(stop);
+      p += 16;
+    }
+#endif
+    while (p < end and is_digit(*p))
+      ++p;
+    return p - s;
+  }
+
+  // string literal contents, up to a closing quote or newline (counts
+  // the backslashes in the run)
+  size_t string_run(const char* p, const char* end, size_t& backslashes)
+  {
+    const char* s = p;
+#ifdef LEXER_SIMD
+    while (end - p >= 16) {
+      __m128i x = _mm_loadu_si128((const __m128i*)p);
+      unsigned stop = bits(_mm_or_si128(equal(x, '"'), equal(x, '\n')));
+      unsigned len = stop ? __builtin_ctz(stop) : 16;
+      backslashes += __builtin_popcount(bits(equal(x, '\\')) &
+                                        ((1u << len) - 1));
+      p += len;
+      if (stop)
+        return p - s;
+    }
+#endif
+    while (p < end and *p != '"' and *p != '\n') {
+      if (*p == '\\')
+        ++backslashes;
+      ++p;
+    }
+    return p - s;
+  }
+
+  //--------------------------------------------------------------------
+  // Reserved words: perfect hash on (length, first char, last char)
+  //--------------------------------------------------------------------
+
+  struct Keyword
+  {
+    const char* word;
+    TokenType type;
+  };
+
+  const int KEYWORD_TABLE_SIZE = 64;
+
+  constexpr unsigned keyword_hash(const char* s, size_t n)
+  {
+    return (n * 2 + (unsigned char)s[0] * 12 + (unsigned char)s[n - 1]) &
+      (KEYWORD_TABLE_SIZE - 1);
+  }
+
+  struct KeywordTable
+  {
+    Keyword slots[KEYWORD_TABLE_SIZE] = {};
+
+    // true if two words hash to the same slot (the later one would
+    // replace the earlier)
+    bool collides = false;
+
+    constexpr KeywordTable()
+    {
+      const Keyword words[] = {
+        {"null", TokenType::NULL_VAL}, {"new", TokenType::NEW},
+        {"not", TokenType::NOT}, {"if", TokenType::IF},
+        {"or", TokenType::OR}, {"true", TokenType::BOOL_VAL},
+        {"false", TokenType::BOOL_VAL}, {"elseif", TokenType::ELSEIF},
+        {"else", TokenType::ELSE}, {"int", TokenType::INT_TYPE},
+        {"double", TokenType::DOUBLE_TYPE}, {"char", TokenType::CHAR_TYPE},
+        {"string", TokenType::STRING_TYPE}, {"bool", TokenType::BOOL_TYPE},
+        {"void", TokenType::VOID_TYPE}, {"and", TokenType::AND},
+        {"for", TokenType::FOR}, {"while", TokenType::WHILE},
+        {"struct", TokenType::STRUCT}, {"array", TokenType::ARRAY},
+        {"return", TokenType::RETURN},
+        // project words
+        {"switch", TokenType::SWITCH}, {"case", TokenType::CASE},
+        {"break", TokenType::BREAK}, {"default", TokenType::DEFAULT}
+      };
+      for (const Keyword& k : words) {
+        size_t n = 0;
+        while (k.word[n] != '\0')
+          ++n;
+        Keyword& slot = slots[keyword_hash(k.word, n)];
+        if (slot.word != nullptr)
+          collides = true;
+        slot = k;
+      }
+    }
+  };
+
+  constexpr KeywordTable KEYWORDS;
+
+  static_assert(!KEYWORDS.collides,
+                "reserved words collide in the keyword hash (change "
+                "keyword_hash or KEYWORD_TABLE_SIZE)");
+
+  // true (and sets type) if the n characters at s are a reserved word
+  bool keyword(const char* s, size_t n, TokenType& type)
+  {
+    const Keyword& k = KEYWORDS.slots[keyword_hash(s, n)];
+    if (k.word == nullptr or strncmp(k.word, s, n) != 0 or k.word[n] != '\0')
+      return false;
+    type = k.type;
+    return true;
+  }
+
+}
+
+
+Lexer::Lexer(istream& input_stream, shared_ptr<Interner> symbols)
+  : Lexer(SourceBuffer::from_stream(input_stream), symbols)
+{}
+
+
+Lexer::Lexer(shared_ptr<const SourceBuffer> source,
+             shared_ptr<Interner> symbols)
+  : buffer {source}, interner {symbols}, begin {source->data()},
+    end {begin + source->size()}, curr {begin}, line {1}, column {0}
+{
+  if (!interner)
+    interner = make_shared<Interner>();
+}
+
+
+shared_ptr<const SourceBuffer> Lexer::source() const
+{
+  return buffer;
+}
+
+
+shared_ptr<Interner> Lexer::symbols() const
+{
+  return interner;
+}
+
+
+size_t Lexer::offset() const
+{
+  return curr - begin;
+}
+
+
+vector<Lexer> Lexer::split(size_t n) const
+{
+  vector<Lexer> lexers {*this};
+  if (n <= 1)
+    return lexers;
+  size_t target = (end - curr) / n;
+  // mirrors the column counting of next_token (one per byte, except
+  // backslashes in strings)
+  const char* p = curr;
+  int depth = 0;
+  int ln = line;
+  int col = column;
+  while (p < end and lexers.size() < n) {
+    char c = *p;
+    if (c == '\n') {
+      ++ln;
+      col = 0;
+      ++p;
+    }
+    else if (c == '#') {
+      const char* eol = (const char*)memchr(p, '\n', end - p);
+      if (eol == nullptr)
+        eol = end;
+      col += eol - p;
+      p = eol;
+    }
+    else if (c == '"') {
+      size_t backslashes = 0;
+      size_t len = string_run(p + 1, end, backslashes);
+      // case: bad string, so leave the rest to one lexer
+      if (p + 1 + len == end or p[1 + len] != '"')
+        break;
+      col += len - backslashes + 2;
+      p += len + 2;
+    }
+    else if (c == '\'') {
+      const char* close = (const char*)memchr(p + 1, '\'', end - p - 1);
+      // case: bad character (they can't span lines)
+      if (close == nullptr or memchr(p + 1, '\n', close - p - 1) != nullptr)
+        break;
+      col += close - p + 1;
+      p = close + 1;
+    }
+    else if (c == '{') {
+      ++depth;
+      ++col;
+      ++p;
+    }
+    else if (c == '}') {
+      // case: unbalanced, so leave the rest to one lexer
+      if (depth == 0)
+        break;
+      --depth;
+      ++col;
+      ++p;
+      Lexer& last = lexers.back();
+      if (depth == 0 and (size_t)(p - last.curr) >= target and
+          (size_t)(end - p) >= target) {
+        last.end = p;
+        Lexer next = *this;
+        next.curr = p;
+        next.line = ln;
+        next.column = col;
+        lexers.push_back(next);
+      }
+    }
+    else {
+      ++col;
+      ++p;
+    }
+  }
+  return lexers;
+}
+
+
+char Lexer::read()
+{
+  ++column;
+  return curr < end ? *curr++ : EOF;
+}
+
+
+char Lexer::peek()
+{
+  return curr < end ? *curr : EOF;
+}
+
+
+void Lexer::error(const string& msg, int line, int column) const
+{
+  throw MyPLException::LexerError(msg + " at line " + to_string(line) +
+                                  ", column " + to_string(column));
+}
+
+
+void Lexer::skip_space()
+{
+  while (curr < end) {
+    size_t n = blank_run(curr, end);
+    curr += n;
+    column += n;
+    if (curr == end)
+      break;
+    if (*curr == '\n') {
+      ++line;
+      column = 0;
+      ++curr;
+    }
+    else if (*curr == '#') {
+      // comments run to the end of the line
+      const char* eol = (const char*)memchr(curr, '\n', end - curr);
+      if (eol == nullptr)
+        eol = end;
+      column += eol - curr;
+      curr = eol;
+    }
+    else if (isspace((unsigned char)*curr)) {
+      ++column;
+      ++curr;
+    }
+    else
+      break;
+  }
+}
+
+
+Token Lexer::next_token()
+{
+  //check for whitespace, tabs, newlines and comments
+  skip_space();
+
+  //check for EOF
+  if(curr == end){
+
+    ++column;
+    return Token::view(TokenType::EOS, "end-of-stream",line,column);
+  }
+
+  //check for single characters and two characters
+  switch(peek()) {
+  case ':':
+    read();
+    return Token::view(TokenType::COLON, ":",line,column);
+  case '.':
+    read();
+    return Token::view(TokenType::DOT, ".",line,column);
+  case ',':
+    read();
+    return Token::view(TokenType::COMMA, ",",line,column);
+  case ';':
+    read();
+    return Token::view(TokenType::SEMICOLON, ";",line,column);
+  case '(':
+    read();
+    return Token::view(TokenType::LPAREN, "(",line,column);
+  case ')':
+    read();
+    return Token::view(TokenType::RPAREN, ")",line,column);
+  case '{':
+    read();
+    return Token::view(TokenType::LBRACE, "{",line,column);
+  case '}':
+    read();
+    return Token::view(TokenType::RBRACE, "}",line,column);
+  case '[':
+    read();
+    return Token::view(TokenType::LBRACKET, "[",line,column);
+  case ']':
+    read();
+    return Token::view(TokenType::RBRACKET, "]",line,column);
+  case '+':
+    read();
+    return Token::view(TokenType::PLUS, "+",line,column);
+  case '-':
+    read();
+    return Token::view(TokenType::MINUS, "-",line,column);
+  case '*':
+    read();
+    return Token::view(TokenType::TIMES, "*",line,column);
+  case '/':
+    read();
+    return Token::view(TokenType::DIVIDE, "/",line,column);
+  case '<':
+    read();
+    if(peek() == '='){
+      read();
+      return Token::view(TokenType::LESS_EQ, "<=", line,column-1);
+    }
+    return Token::view(TokenType::LESS, "<",line,column);
+  case '>':
+    read();
+    if(peek() == '='){
+      read();
+      return Token::view(TokenType::GREATER_EQ, ">=", line,column-1);
+    }
+    return Token::view(TokenType::GREATER, ">",line,column);
+  case '!':
+    read();
+    if(peek() != '='){
+      string s(1,peek());
+      error("expecting '!=' found '!" + s + "'", line,column);
+    }
+    read();
+    return Token::view(TokenType::NOT_EQUAL, "!=",line,column-1);
+  case '=':
+    read();
+    if(peek() == '='){
+      read();
+      return Token::view(TokenType::EQUAL, "==", line,column-1);
+    }
+    return Token::view(TokenType::ASSIGN, "=",line,column);
+  case '\'':
+    return char_token();
+  case '"':
+    return string_token();
+  }
+
+  //check for integer or double
+  if(is_digit(peek()))
+    return number_token();
+
+  //check for reserved words and identifiers
+  if(is_alpha(peek()))
+    return word_token();
+
+  string s(1,peek());
+  read();
+  error("unexpected character '" + s + "'", line,column);
+  return Token(TokenType::ID, s, line, column);
+
+}
+
+
+Token Lexer::char_token()
+{
+  string char_val = "";
+  bool slashes = false;
+  int num_chars = 0;
+  string additional = "";
+  read();
+  if(peek() == '\n' ){
+    read();
+    error("found end-of-line in character",line,column);
+  }
+  while((peek() != '\'')&&(peek() != EOF)){
+    if(peek() == '\\' ){
+      char_val += "\\";
+      slashes = true;
+      --num_chars;
+    }
+    ++num_chars;
+    if(num_chars > 1){
+      string s(1,peek());
+      additional += s;
+    }
+    string s(1,peek());
+    read();
+    char_val += s;
+  }
+  if(peek() != '\''){
+    ++column;
+    error("found end-of-file in character",line,column);
+  }
+  if(num_chars > 1){
+    error("expecting ' found " + additional, line,column);
+  }
+  read();
+  if(num_chars == 0){
+    error("empty character", line,column);
+  }
+  if(slashes){
+    return Token(TokenType::CHAR_VAL,char_val,line,column-3);
+  }
+  return Token(TokenType::CHAR_VAL,char_val,line,column-2);
+}
+
+
+Token Lexer::string_token()
+{
+  // backslashes are kept in the lexeme but take up no column
+  read();
+  const char* start = curr;
+  size_t backslashes = 0;
+  size_t n = string_run(curr, end, backslashes);
+  curr += n;
+  int num_chars = n - backslashes;
+  column += num_chars;
+  if(peek() == '\n'){
+    read();
+    error("found end-of-line in string",line,column);
+  }
+  if(peek() != '\"'){
+    ++column;
+    error("found end-of-file in string",line,column-num_chars);
+  }
+  read();
+  ++num_chars;
+  return Token::view(TokenType::STRING_VAL,string_view(start,n),line,column-num_chars);
+}
+
+
+Token Lexer::number_token()
+{
+  const char* start = curr;
+  size_t before = digit_run(curr, end);
+  curr += before;
+  column += before;
+  bool dot = false;
+  size_t after = 0;
+  if(peek() == '.'){
+    dot = true;
+    ++curr;
+    ++column;
+    if(is_alpha(peek())){
+      read();
+      error("missing digit in '" + string(start, before) + ".'", line,column);
+    }
+    after = digit_run(curr, end);
+    curr += after;
+    column += after;
+  }
+  if((start[0] == '0')&&(before > 1)&&(!dot)){
+    error("leading zero in number", line, column-before+1);
+  }
+  if(!dot){
+    return Token::view(TokenType::INT_VAL,string_view(start,before),line,column-before+1);
+  }
+  if(after == 0){
+    error("missing digit in '" + string(start, before) + ".'", line,column);
+  }
+  return Token::view(TokenType::DOUBLE_VAL,string_view(start,curr-start),line,
+               column-after-before);
+}
+
+
+Token Lexer::word_token()
+{
+  const char* start = curr;
+  bool non_alpha = false;
+  size_t n = word_run(curr, end, non_alpha);
+  curr += n;
+  column += n;
+  //reserved words never contain digits or underscores
+  TokenType type = TokenType::ID;
+  if(!non_alpha)
+    keyword(start, n, type);
+  string_view lexeme(start, n);
+  Symbol symbol = Symbols::NONE;
+  if(type == TokenType::ID)
+    symbol = interner->intern(lexeme);
+  return Token::view(type, lexeme, line, column-n+1, symbol);
+}
@@ -9,26 +9,63 @@
 #define LEXER_H
 
 #include <istream>
+#include <memory>
 #include <string>
+#include <vector>
+#include "interner.h"
 #include "mypl_exception.h"
+#include "source_buffer.h"
 #include "token.h"
 
 
 class Lexer {
 public:
 
-  // Construct a new lexer from the given input stream
-  Lexer(std::istream& input_stream);
+  // Construct a new lexer over the rest of the given input stream
+  // (the stream is read into a buffer up front), interning identifiers
+  // into the given interner (a new one if null)
+  Lexer(std::istream& input_stream,
+        std::shared_ptr<Interner> symbols = nullptr);
+
+  // Construct a new lexer over the given source buffer
+  Lexer(std::shared_ptr<const SourceBuffer> source,
+        std::shared_ptr<Interner> symbols = nullptr);
 
   // Return the next available token in the input stream. Returns the
   // EOS (end of stream) token if no more tokens exist in the input
   // stream.
   Token next_token();
 
+  // the buffer being scanned
+  std::shared_ptr<const SourceBuffer> source() const;
+
+  // the interner holding the identifiers' symbols
+  std::shared_ptr<Interner> symbols() const;
+
+  // the offset in the source just past the last token returned
+  size_t offset() const;
+
+  // split the rest of the input into at most n lexers, in source order,
+  // that each cover whole top-level definitions (cuts are made after a
+  // '}' that closes a definition, skipping strings, characters, and
+  // comments). Each lexer starts at the line and column of its cut and
+  // shares this lexer's interner.
+  std::vector<Lexer> split(size_t n) const;
+
 private:
 
-  // input stream
-  std::istream& input;
+  // the source text (shared by copies of the lexer)
+  std::shared_ptr<const SourceBuffer> buffer;
+
+  // the identifiers' symbols (shared by copies of the lexer)
+  std::shared_ptr<Interner> interner;
+
+  // start and end of the source text
+  const char* begin;
+  const char* end;
+
+  // next character to read
+  const char* curr;
 
   // current line
   int line;
@@ -44,6 +81,15 @@ private:
   // without incrementing column number
   char peek();
 
+  // skip whitespace and comments, tracking line and column
+  void skip_space();
+
+  // helpers for the multi-character tokens (each starts at curr)
+  Token char_token();
+  Token string_token();
+  Token number_token();
+  Token word_token();
+
   // create and throw a MyPLException object (exits lexer)
   void error(const std::string& msg, int line, int column) const;
   
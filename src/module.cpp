@@ -0,0 +1,116 @@
+//----------------------------------------------------------------------
+// FILE: module.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Module implementation
+//----------------------------------------------------------------------
+
+#include "module.h"
+#include "vm.h"
+#include "ast_parser.h"
+#include "bytecode.h"
+#include "code_generator.h"
+#include "lexer.h"
+#include "mypl_exception.h"
+#include "semantic_checker.h"
+#include "source_buffer.h"
+
+using namespace std;
+
+
+namespace {
+
+  // run the full front end over the source, adding it to the vm
+  void generate(VM& vm, shared_ptr<const SourceBuffer> source)
+  {
+    Lexer lexer(source, vm.symbols());
+    ASTParser parser(lexer);
+    Program p = parser.parse();
+    SemanticChecker checker;
+    checker.set_require_main(false);
+    p.accept(checker);
+    CodeGenerator generator(vm);
+    p.accept(generator);
+  }
+
+}
+
+
+const unordered_map<string, VMFrameInfo>& Module::frames() const
+{
+  return frame_info;
+}
+
+
+const unordered_map<string, VMStructInfo>& Module::structs() const
+{
+  return struct_info;
+}
+
+
+const VMFrameInfo& Module::function(Symbol name) const
+{
+  static const VMFrameInfo undefined{};
+  if (name >= frame_index.size() or frame_index[name] == nullptr)
+    return undefined;
+  return *frame_index[name];
+}
+
+
+shared_ptr<Interner> Module::symbols() const
+{
+  return interner;
+}
+
+
+void Module::add(VMFrameInfo&& frame)
+{
+  Symbol name = interner->intern(frame.function_name);
+  // elements of an unordered map never move, so the index stays valid
+  VMFrameInfo& info = frame_info[frame.function_name];
+  info = std::move(frame);
+  if (name >= frame_index.size())
+    frame_index.resize(name + 1, nullptr);
+  frame_index[name] = &info;
+}
+
+
+void Module::add(const VMStructInfo& info)
+{
+  struct_info[info.struct_name] = info;
+}
+
+
+void Module::load(VM& vm, const string& path)
+{
+  if (Bytecode::is_bytecode(path)) {
+    Bytecode::load(vm, path);
+    return;
+  }
+  shared_ptr<const SourceBuffer> source = SourceBuffer::from_file(path);
+  if (source == nullptr)
+    throw MyPLException::VMError("unable to read module '" + path + "'");
+  generate(vm, source);
+}
+
+
+void Module::compile(VM& vm, const string& source)
+{
+  generate(vm, SourceBuffer::from_string(source));
+}
+
+
+shared_ptr<const Module> Module::load(const string& path)
+{
+  VM vm;
+  load(vm, path);
+  return vm.module();
+}
+
+
+shared_ptr<const Module> Module::compile(const string& source)
+{
+  VM vm;
+  compile(vm, source);
+  return vm.module();
+}
@@ -0,0 +1,82 @@
+//----------------------------------------------------------------------
+// FILE: module.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: The compiled code of a MyPL program (its frame templates,
+// with their constants, and struct shapes). A vm adds code to its own
+// module as a program loads. Once shared (VM::module) the module is
+// immutable, so any number of vms (isolates, each with only its own
+// heap and call stack) can run it at once on different threads. The
+// module owns the interner its code's symbols come from, so they live
+// (and are freed) with it.
+//----------------------------------------------------------------------
+
+#ifndef MODULE_H
+#define MODULE_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "interner.h"
+#include "vm_frame.h"
+
+class VM;
+
+
+class Module
+{
+public:
+
+  Module() = default;
+
+  // frames are indexed by address, so modules are never copied
+  Module(const Module&) = delete;
+  Module& operator=(const Module&) = delete;
+
+  // the frame templates identified by function name
+  const std::unordered_map<std::string, VMFrameInfo>& frames() const;
+
+  // the struct shapes identified by struct name
+  const std::unordered_map<std::string, VMStructInfo>& structs() const;
+
+  // the frame template of the function (or an empty one if undefined)
+  const VMFrameInfo& function(Symbol name) const;
+
+  // the interner holding the symbols of the module's code
+  std::shared_ptr<Interner> symbols() const;
+
+  // add the module in the file (a script, checked and compiled, or a
+  // bytecode file) to the vm (throws a MyPL exception on errors)
+  static void load(VM& vm, const std::string& path);
+
+  // add the module with the given source text to the vm
+  static void compile(VM& vm, const std::string& source);
+
+  // the module in the file, or with the given source text, ready to
+  // share between vms
+  static std::shared_ptr<const Module> load(const std::string& path);
+  static std::shared_ptr<const Module> compile(const std::string& source);
+
+private:
+
+  // the owning vm adds code (see VM::add)
+  friend class VM;
+
+  void add(VMFrameInfo&& frame);
+  void add(const VMStructInfo& info);
+
+  std::unordered_map<std::string, VMFrameInfo> frame_info;
+
+  // the frame templates above indexed by function symbol (nullptr if
+  // no such function)
+  std::vector<const VMFrameInfo*> frame_index;
+
+  std::unordered_map<std::string, VMStructInfo> struct_info;
+
+  std::shared_ptr<Interner> interner = std::make_shared<Interner>();
+
+};
+
+
+#endif
@@ -5,8 +5,16 @@
 // DESC: create a basic skeleton for mypl interpreter program
 //----------------------------------------------------------------------
 
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
 #include "token.h"
 #include "lexer.h"
 #include "simple_parser.h"
@@ -16,8 +24,106 @@
 #include "semantic_checker.h"
 #include "vm.h"
 #include "code_generator.h"
+#include "bytecode.h"
+#include "compile_cache.h"
+#include "bundle.h"
+#include "thread_pool.h"
+#include "incremental.h"
+#include "profiler.h"
+#include "sampler.h"
+#include "tracer.h"
+#include "perf_map.h"
+#include "perf_counters.h"
+#include "heap_profiler.h"
+#include "server.h"
 
 using namespace std;
+namespace fs = std::filesystem;
+
+
+// false if compiled programs should not be cached (--no-cache)
+bool use_cache = true;
+
+// number of threads for checking and generating functions (--jobs)
+size_t jobs = 1;
+
+// true if function bodies are checked and generated when first called
+// (--lazy)
+bool lazy = false;
+
+// true if the functions of each script file are kept between compiles,
+// and only the changed ones recompiled (--incremental)
+bool incremental = false;
+
+// file to write the run's execution profile to (--profile)
+string profile_path = "";
+
+// file to write the program's source annotated with the profile of
+// each line to (--annotate)
+string annotate_path = "";
+
+// file to write the run's sampled call stacks to, and samples per
+// second (--sample, --sample-rate)
+string sample_path = "";
+unsigned sample_rate = 99;
+
+// true if sampled stacks give the source line of each function
+// (--sample-lines)
+bool sample_lines = false;
+
+// file to write the run's timeline to, and the shortest call it shows
+// (--trace, --trace-min-us)
+string trace_path = "";
+uint64_t trace_min_us = 0;
+
+// the timeline of the run (while tracing)
+Tracer* tracer = nullptr;
+
+// true if the run reports the vm's stats (--stats)
+bool stats = false;
+
+// the number of workers running a server's jobs, 0 for one per core
+// (--workers)
+size_t workers = 0;
+
+
+// a phase of the pipeline, timed in the vm's stats (and on the
+// timeline while tracing) until it ends or goes out of scope
+class Phase
+{
+public:
+  Phase(VM& vm, const string& name)
+    : vm(vm), name(name), traced(tracer, name),
+      start(chrono::steady_clock::now()) {}
+  ~Phase() { end(); }
+  void end()
+  {
+    if (ended)
+      return;
+    ended = true;
+    traced.end();
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(
+      chrono::steady_clock::now() - start);
+    vm.add_phase_time(name, ns.count());
+  }
+private:
+  VM& vm;
+  string name;
+  Tracer::Phase traced;
+  chrono::steady_clock::time_point start;
+  bool ended = false;
+};
+
+// true if calls run through trampolines named in a perf map (--perf)
+bool perf = false;
+
+// true if the run reports the performance counters of each function
+// (--perf-counters)
+bool perf_counters = false;
+
+// true if the run reports the objects allocated at each allocation
+// site (--heap-profile)
+bool heap_profile = false;
 
 
 void usage() {
@@ -29,198 +135,616 @@ void usage() {
   cout << "  --print pretty prints program" << endl;
   cout << "  --check statically checks program" << endl;
   cout << "  --ir print intermediate (code) representation" << endl;
+  cout << "  --compile out.myplc compiles program to a bytecode file" << endl;
+  cout << "  --bundle out builds a standalone executable of the program" << endl;
+  cout << "  --no-cache always compiles from source (see also MYPL_NO_CACHE)"
+       << endl;
+  cout << "  --jobs n parses, checks, and compiles on n threads (0 for all"
+       << " cores)" << endl;
+  cout << "  --lazy checks and compiles each function when first called"
+       << " (never cached)" << endl;
+  cout << "  --incremental keeps each script's functions in the cache and"
+       << " recompiles only changed ones" << endl;
+  cout << "  --watch script-file reruns the program whenever the file changes"
+       << endl;
+  cout << "  --serve sock runs programs sent to the unix socket, keeping"
+       << " the last " << Server::MAX_MODULES << " compiled" << endl;
+  cout << "  --workers n runs a server's jobs on n threads (0 for all"
+       << " cores)" << endl;
+  cout << "  --client sock [script-file] runs the program (given stdin) on"
+       << " the server at sock" << endl;
+  cout << "  --profile out.json reports where the run spent its time (and"
+       << " saves the profile)" << endl;
+  cout << "  --annotate out.txt writes the source with the instructions"
+       << " executed and time spent on each line" << endl;
+  cout << "  --sample out.folded samples the run's call stacks (as folded"
+       << " stacks for flame graphs)" << endl;
+  cout << "  --sample-rate n samples per second of cpu time (default 99)"
+       << endl;
+  cout << "  --sample-lines samples source lines (main:9;f:4) rather than"
+       << " functions" << endl;
+  cout << "  --trace out.json saves a timeline of the compile phases and"
+       << " calls (chrome trace events)" << endl;
+  cout << "  --trace-min-us n leaves calls shorter than n microseconds out of"
+       << " the timeline" << endl;
+  cout << "  --perf names each function's native frames in"
+       << " /tmp/perf-<pid>.map for perf" << endl;
+  cout << "  --perf-counters reports cycles, instructions, cache and branch"
+       << " misses per function" << endl;
+  cout << "  --stats reports the run's instructions, calls, stack depths,"
+       << " allocations, and phase times" << endl;
+  cout << "  --heap-profile reports the bytes allocated (and live) per"
+       << " allocation site and type, also on SIGUSR1" << endl;
+  cout << "Script files ending in " << BYTECODE_EXT
+       << " are run without recompiling" << endl;
+  cout << "Compiled programs are cached in MYPL_CACHE_DIR (default"
+       << " ~/.cache/mypl)," << endl;
+  cout << "bounded by MYPL_CACHE_SIZE bytes" << endl;
 }
 
-int main(int argc, char* argv[])
+
+// run the full front end over the source, adding the program to the vm
+void compile(shared_ptr<const SourceBuffer> source, VM& vm)
 {
+  unique_ptr<ThreadPool> pool = nullptr;
+  if (jobs != 1)
+    pool = make_unique<ThreadPool>(jobs);
+  Lexer lexer(source, vm.symbols());
+  ASTParser parser(lexer, pool.get());
+  // (tokens are lexed as the parser asks for them)
+  Phase parsing(vm, "lex and parse");
+  Program p = parser.parse();
+  parsing.end();
+  Phase checking(vm, "check");
+  SemanticChecker t(pool.get());
+  p.accept(t);
+  checking.end();
+  Phase generating(vm, "codegen");
+  CodeGenerator g(vm, pool.get());
+  p.accept(g);
+}
 
-  if(argc == 1) {
-    // case: ./mypl
-    cout << "[Normal Mode]" << endl;
-    istream* input = &cin;
+
+// like compile, but only structs and function signatures are checked
+// up front, and each function body is checked and generated by the vm
+// on its first call
+void compile_lazily(shared_ptr<const SourceBuffer> source, VM& vm)
+{
+  unique_ptr<ThreadPool> pool = nullptr;
+  if (jobs != 1)
+    pool = make_unique<ThreadPool>(jobs);
+  Lexer lexer(source, vm.symbols());
+  ASTParser parser(lexer, pool.get());
+  Phase parsing(vm, "lex and parse");
+  auto program = make_shared<Program>(parser.parse());
+  parsing.end();
+  Phase declaring(vm, "declare");
+  auto checker = make_shared<SemanticChecker>();
+  checker->declare(*program);
+  CodeGenerator::generate_lazily(program, vm, checker);
+}
+
+
+// like compile, but reuses the functions unchanged since the state
+// saved to the given file, then saves the new state there (with the
+// frames read from the bytecode file the vm is written to)
+void compile_incrementally(shared_ptr<const SourceBuffer> source, VM& vm,
+                           const string& state_path,
+                           const string& image_path)
+{
+  unique_ptr<ThreadPool> pool = nullptr;
+  if (jobs != 1)
+    pool = make_unique<ThreadPool>(jobs);
+  IncrementalCompiler compiler;
+  Phase loading(vm, "load functions");
+  compiler.load(state_path);
+  loading.end();
+  Lexer lexer(source, compiler.symbols());
+  ASTParser parser(lexer, pool.get());
+  parser.set_fingerprinting(true);
+  Phase parsing(vm, "lex and parse");
+  Program p = parser.parse();
+  parsing.end();
+  Phase compiling(vm, "check and codegen changed");
+  compiler.compile(p, vm, pool.get());
+  compiling.end();
+  Phase saving(vm, "save functions");
+  compiler.save(state_path, image_path);
+}
+
+
+// the source text of the named file (mmap'd) or else of the input
+shared_ptr<const SourceBuffer> read_source(const string& file_name,
+                                           istream& input)
+{
+  shared_ptr<const SourceBuffer> source = nullptr;
+  if (file_name != "")
+    source = SourceBuffer::from_file(file_name);
+  if (source == nullptr)
+    source = SourceBuffer::from_stream(input);
+  return source;
+}
+
+
+// load a program into the vm from a bytecode file, from the compile
+// cache, or (on a cache miss) from source
+void load(const string& file_name, istream& input, VM& vm)
+{
+  if (file_name != "" and Bytecode::is_bytecode(file_name)) {
+    Phase loading(vm, "load bytecode");
+    Bytecode::load(vm, file_name);
+    return;
+  }
+  Phase reading(vm, "read");
+  shared_ptr<const SourceBuffer> source = read_source(file_name, input);
+  reading.end();
+  if (lazy) {
+    compile_lazily(source, vm);
+    return;
+  }
+  string cache_dir = use_cache ? CompileCache::default_dir() : "";
+  if (cache_dir == "") {
+    compile(source, vm);
+    return;
+  }
+  uintmax_t max_bytes = CompileCache::DEFAULT_MAX_BYTES;
+  if (const char* size = getenv("MYPL_CACHE_SIZE"))
+    max_bytes = strtoull(size, nullptr, 10);
+  CompileCache cache(cache_dir, max_bytes);
+  Phase looking_up(vm, "cache lookup");
+  string key = CompileCache::key(string(source->text()));
+  if (cache.lookup(key, vm))
+    return;
+  looking_up.end();
+  if (file_name == "" or !incremental)
+    compile(source, vm);
+  else {
+    // the functions of each script file are kept between compiles
+    // (their frames are read back from the entry stored below), keyed
+    // by the file's path under their own extension
+    string path = fs::absolute(file_name).string();
+    string state = cache_dir + "/" + CompileCache::key(path) +
+      INCREMENTAL_EXT;
+    compile_incrementally(source, vm, state, cache.path(key));
+  }
+  Phase storing(vm, "cache store");
+  cache.store(key, vm);
+}
+
+
+// rerun the program each time the file changes, only recompiling the
+// functions that changed since the last run (--watch)
+int watch(const string& file_name)
+{
+  unique_ptr<ThreadPool> pool = nullptr;
+  if (jobs != 1)
+    pool = make_unique<ThreadPool>(jobs);
+  IncrementalCompiler compiler;
+  fs::file_time_type last = fs::file_time_type::min();
+  while (true) {
+    error_code ec;
+    fs::file_time_type modified = fs::last_write_time(file_name, ec);
+    if (ec or modified == last) {
+      this_thread::sleep_for(chrono::milliseconds(200));
+      continue;
+    }
+    last = modified;
     try {
-      Lexer lexer(*input);
-      ASTParser parser(lexer);
+      ifstream input(file_name);
+      Lexer lexer(read_source(file_name, input), compiler.symbols());
+      ASTParser parser(lexer, pool.get());
+      parser.set_fingerprinting(true);
       Program p = parser.parse();
-      SemanticChecker t;
-      p.accept(t);
       VM vm;
-      CodeGenerator g(vm);
-      p.accept(g);
+      compiler.compile(p, vm, pool.get());
+      cerr << "[" << compiler.recompiled() << " of " << p.fun_defs.size()
+           << " functions compiled]" << endl;
       vm.run();
+      // end the run's output before the next one
+      cout << endl;
     } catch (MyPLException& ex) {
       cerr << ex.what() << endl;
     }
   }
+}
 
-  else if(argc == 2) {
-    istream* input = &cin;
 
-    if(string(argv[1]) == "--help") {
-      usage();
+// the server while serving (so a signal can stop it)
+Server* server = nullptr;
+
+
+// run jobs sent to the socket until interrupted (--serve)
+int serve(const string& socket_path)
+{
+  try {
+    Server s(socket_path, workers);
+    server = &s;
+    auto stop = [](int) { server->stop(); };
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    cerr << "[serving on " << socket_path << "]" << endl;
+    s.serve();
+    server = nullptr;
+    cerr << "[" << s.job_count() << " jobs run, " << s.compile_count()
+         << " programs compiled]" << endl;
+  } catch (MyPLException& ex) {
+    cerr << ex.what() << endl;
+    return 1;
+  }
+  return 0;
+}
+
+
+// run the script (or the program read from stdin) on the server,
+// sending stdin as its input (--client)
+int client(const string& socket_path, const string& file_name)
+{
+  Server::Job job;
+  stringstream text;
+  if (file_name != "") {
+    job.path = fs::absolute(file_name).string();
+    // (a terminal isn't read, the program may not want input)
+    if (!isatty(STDIN_FILENO)) {
+      text << cin.rdbuf();
+      job.input = text.str();
     }
+  } else {
+    text << cin.rdbuf();
+    job.source = text.str();
+  }
+  try {
+    return Server::submit(socket_path, job, cout, cerr);
+  } catch (MyPLException& ex) {
+    cerr << ex.what() << endl;
+    return 1;
+  }
+}
+
+
+// report the profile of the run on stderr and save it as json
+void write_profile(Profiler& profiler, const VM& vm)
+{
+  profiler.finish();
+  ofstream out(profile_path);
+  profiler.write_json(out);
+  if (!out)
+    cerr << "ERROR: Unable to write profile '" << profile_path << "'" << endl;
+  cout << flush;
+  profiler.report(cerr, vm);
+}
+
+
+// save the script file annotated with the profile of each line
+void write_annotated(Profiler& profiler, const string& file_name)
+{
+  profiler.finish();
+  shared_ptr<const SourceBuffer> source = nullptr;
+  if (file_name != "" and !Bytecode::is_bytecode(file_name))
+    source = SourceBuffer::from_file(file_name);
+  if (source == nullptr) {
+    cerr << "ERROR: --annotate needs a script file" << endl;
+    return;
+  }
+  ofstream out(annotate_path);
+  profiler.annotate(out, source->text());
+  if (!out)
+    cerr << "ERROR: Unable to write annotated source '" << annotate_path
+         << "'" << endl;
+}
+
+
+// save the call stacks sampled during the run
+void write_samples(Sampler& sampler)
+{
+  sampler.stop();
+  ofstream out(sample_path);
+  sampler.write_folded(out, sample_lines);
+  if (!out)
+    cerr << "ERROR: Unable to write samples '" << sample_path << "'" << endl;
+  if (sampler.dropped() > 0)
+    cerr << "WARNING: " << sampler.dropped() << " of "
+         << (sampler.sample_count() + sampler.dropped())
+         << " samples dropped" << endl;
+}
+
 
-    else if(string(argv[1]) == "--lex") {
-      try {
-          Lexer lexer(*input);
-          Token t = lexer.next_token();
+// save the timeline of the run as trace events
+void write_trace(Tracer& trace)
+{
+  trace.finish();
+  ofstream out(trace_path);
+  trace.write_json(out, trace_min_us * 1000);
+  if (!out)
+    cerr << "ERROR: Unable to write trace '" << trace_path << "'" << endl;
+}
+
+
+// run the given mode over the input
+int run_mode(const string& mode, const string& file_name, istream& input)
+{
+  if(mode == "--lex") {
+    try {
+        Lexer lexer(read_source(file_name, input));
+        Token t = lexer.next_token();
+        cout << to_string(t) << endl;
+        while (t.type() != TokenType::EOS) {
+          t = lexer.next_token();
           cout << to_string(t) << endl;
-          while (t.type() != TokenType::EOS) {
-            t = lexer.next_token();
-            cout << to_string(t) << endl;
-          }
-        } catch (MyPLException& ex) {
-          cerr << ex.what() << endl;
         }
-    }
-
-    else if(string(argv[1]) == "--parse") {
-      try {
-        Lexer lexer(*input);
-        SimpleParser parser(lexer);
-        parser.parse();
       } catch (MyPLException& ex) {
         cerr << ex.what() << endl;
       }
-
-    }
-    else if(string(argv[1]) == "--print") {
-      try {
-          Lexer lexer(*input);
-          ASTParser parser(lexer);
-          Program p = parser.parse();
-          PrintVisitor v(cout);
-          p.accept(v);
-        } catch (MyPLException& ex) {
-        cerr << ex.what() << endl;
-      }
+  }
+  else if(mode == "--parse") {
+    try {
+      Lexer lexer(read_source(file_name, input));
+      SimpleParser parser(lexer);
+      parser.parse();
+    } catch (MyPLException& ex) {
+      cerr << ex.what() << endl;
     }
-    else if(string(argv[1]) == "--check") {
-      try {
-        Lexer lexer(*input);
+  }
+  else if(mode == "--print") {
+    try {
+        Lexer lexer(read_source(file_name, input));
         ASTParser parser(lexer);
         Program p = parser.parse();
-        SemanticChecker v;
+        PrintVisitor v(cout);
         p.accept(v);
       } catch (MyPLException& ex) {
-        cerr << ex.what() << endl;
-      }
+      cerr << ex.what() << endl;
     }
-    else if(string(argv[1]) == "--ir") {
-      try {
-        Lexer lexer(*input);
-        ASTParser parser(lexer);
-        Program p = parser.parse();
-        SemanticChecker t;
-        p.accept(t);
-        VM vm;
-        CodeGenerator g(vm);
-        p.accept(g);
-        cout << to_string(vm) << endl;
-      } catch (MyPLException& ex) {
-        cerr << ex.what() << endl;
-      }
-
+  }
+  else if(mode == "--check") {
+    try {
+      unique_ptr<ThreadPool> pool = nullptr;
+      if (jobs != 1)
+        pool = make_unique<ThreadPool>(jobs);
+      Lexer lexer(read_source(file_name, input));
+      ASTParser parser(lexer, pool.get());
+      Program p = parser.parse();
+      SemanticChecker v(pool.get());
+      p.accept(v);
+    } catch (MyPLException& ex) {
+      cerr << ex.what() << endl;
     }
-    else {
-    //   // case: invalid mode or file
-      input = new ifstream(argv[1]);
-      cout << "[Normal Mode]" << endl;
-      try {
-        Lexer lexer(*input);
-        ASTParser parser(lexer);
-        Program p = parser.parse();
-        SemanticChecker t;
-        p.accept(t);
-        VM vm;
-        CodeGenerator g(vm);
-        p.accept(g);
-        vm.run();
-      } catch (MyPLException& ex) {
-        cerr << ex.what() << endl;
+  }
+  else if(mode == "--ir") {
+    try {
+      VM vm;
+      load(file_name, input, vm);
+      cout << to_string(vm) << endl;
+    } catch (MyPLException& ex) {
+      cerr << ex.what() << endl;
+    }
+  }
+  else {
+    cout << "[Normal Mode]" << endl;
+    VM vm;
+    Profiler profiler;
+    if (profile_path != "" or annotate_path != "")
+      vm.set_profiler(&profiler);
+    unique_ptr<Sampler> sampler = nullptr;
+    if (sample_path != "") {
+      sampler = make_unique<Sampler>(sample_rate);
+      vm.set_sampler(sampler.get());
+    }
+    unique_ptr<Tracer> trace = nullptr;
+    if (trace_path != "") {
+      trace = make_unique<Tracer>();
+      tracer = trace.get();
+      vm.set_tracer(tracer);
+    }
+    unique_ptr<PerfCounters> counters = nullptr;
+    if (perf_counters) {
+      counters = make_unique<PerfCounters>();
+      vm.set_counters(counters.get());
+    }
+    unique_ptr<HeapProfiler> heap_profiler = nullptr;
+    if (heap_profile) {
+      heap_profiler = make_unique<HeapProfiler>();
+      heap_profiler->report_on(SIGUSR1, cerr);
+      vm.set_heap_profiler(heap_profiler.get());
+    }
+    unique_ptr<PerfMap> perf_map = nullptr;
+    try {
+      if (perf) {
+        perf_map = make_unique<PerfMap>();
+        vm.set_perf_map(perf_map.get());
       }
+      load(file_name, input, vm);
+      if (sampler)
+        sampler->start();
+      Phase running(vm, "run");
+      vm.run();
+    } catch (MyPLException& ex) {
+      cerr << ex.what() << endl;
+    }
+    if (profile_path != "")
+      write_profile(profiler, vm);
+    if (annotate_path != "")
+      write_annotated(profiler, file_name);
+    if (sampler)
+      write_samples(*sampler);
+    if (trace) {
+      write_trace(*trace);
+      tracer = nullptr;
+    }
+    if (counters) {
+      counters->finish();
+      cout << flush;
+      counters->report(cerr);
+    }
+    if (heap_profiler) {
+      cout << flush;
+      heap_profiler->report(cerr);
+    }
+    if (stats) {
+      cout << flush;
+      vm.stats().report(cerr);
     }
   }
+  return 0;
+}
 
-  else if(argc == 3) {
-    istream* input = &cin;
-    input = new ifstream(argv[2]);
 
-    // case: invalid file
-    if(input->fail()) {
-      cout << "ERROR: Unable to open file '" << string(argv[2]) << "'" << endl;
-    }
-    
-    else if(string(argv[1]) == "--lex") {
-      try {
-          Lexer lexer(*input);
-          Token t = lexer.next_token();
-          cout << to_string(t) << endl;
-          while (t.type() != TokenType::EOS) {
-            t = lexer.next_token();
-            cout << to_string(t) << endl;
-          }
-        } catch (MyPLException& ex) {
-          cerr << ex.what() << endl;
-        }
+int main(int argc, char* argv[])
+{
+  // case: a bundled executable runs its embedded program immediately
+  try {
+    VM bundled;
+    if (Bundle::load(bundled, Bundle::self_path())) {
+      bundled.run();
+      return 0;
     }
-    else if(string(argv[1]) == "--parse") {
-      try {
-        Lexer lexer(*input);
-        SimpleParser parser(lexer);
-        parser.parse();
-      } catch (MyPLException& ex) {
-        cerr << ex.what() << endl;
-      }
+  } catch (MyPLException& ex) {
+    cerr << ex.what() << endl;
+    return 1;
+  }
+
+  // pull out the global flags, leaving the mode and file arguments
+  vector<string> args;
+  for (int i = 0; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--no-cache")
+      use_cache = false;
+    else if (arg == "--lazy")
+      lazy = true;
+    else if (arg == "--incremental")
+      incremental = true;
+    else if (arg == "--jobs" and i + 1 < argc)
+      jobs = strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--profile" and i + 1 < argc)
+      profile_path = argv[++i];
+    else if (arg == "--sample" and i + 1 < argc)
+      sample_path = argv[++i];
+    else if (arg == "--sample-rate" and i + 1 < argc)
+      sample_rate = strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--sample-lines")
+      sample_lines = true;
+    else if (arg == "--annotate" and i + 1 < argc)
+      annotate_path = argv[++i];
+    else if (arg == "--perf")
+      perf = true;
+    else if (arg == "--perf-counters")
+      perf_counters = true;
+    else if (arg == "--heap-profile")
+      heap_profile = true;
+    else if (arg == "--stats")
+      stats = true;
+    else if (arg == "--workers" and i + 1 < argc)
+      workers = strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--trace" and i + 1 < argc)
+      trace_path = argv[++i];
+    else if (arg == "--trace-min-us" and i + 1 < argc)
+      trace_min_us = strtoull(argv[++i], nullptr, 10);
+    else
+      args.push_back(arg);
+  }
+  if (getenv("MYPL_NO_CACHE"))
+    use_cache = false;
+
+  if(args.size() == 1) {
+    // case: ./mypl
+    return run_mode("", "", cin);
+  }
+
+  string mode = args[1];
+
+  if(mode == "--help") {
+    usage();
+    return 0;
+  }
+
+  if(mode == "--compile" || mode == "--bundle") {
+    // case: ./mypl --compile out.myplc [script-file]
+    // case: ./mypl --bundle out [script-file]
+    if(args.size() < 3 || args.size() > 4) {
+      usage();
+      return 1;
     }
-    else if(string(argv[1]) == "--print") {
-      try {
-          Lexer lexer(*input);
-          ASTParser parser(lexer);
-          Program p = parser.parse();
-          PrintVisitor v(cout);
-          p.accept(v);
-        } catch (MyPLException& ex) {
-        cerr << ex.what() << endl;
+    istream* input = &cin;
+    ifstream file;
+    string file_name = "";
+    if(args.size() == 4) {
+      file_name = args[3];
+      file.open(file_name);
+      if(file.fail()) {
+        cout << "ERROR: Unable to open file '" << file_name << "'" << endl;
+        return 1;
       }
+      input = &file;
     }
-    else if(string(argv[1]) == "--check") {
-      try {
-        Lexer lexer(*input);
-        ASTParser parser(lexer);
-        Program p = parser.parse();
-        SemanticChecker v;
-        p.accept(v);
-      } catch (MyPLException& ex) {
-        cerr << ex.what() << endl;
-      }
+    try {
+      // written programs need every function body
+      lazy = false;
+      VM vm;
+      load(file_name, *input, vm);
+      if(mode == "--compile")
+        Bytecode::write(vm, args[2]);
+      else
+        Bundle::write(vm, Bundle::self_path(), args[2]);
+    } catch (MyPLException& ex) {
+      cerr << ex.what() << endl;
+      return 1;
     }
-    else if(string(argv[1]) == "--ir") {
-      try {
-        Lexer lexer(*input);
-        ASTParser parser(lexer);
-        Program p = parser.parse();
-        SemanticChecker t;
-        p.accept(t);
-        VM vm;
-        CodeGenerator g(vm);
-        p.accept(g);
-        cout << to_string(vm) << endl;
-      } catch (MyPLException& ex) {
-        cerr << ex.what() << endl;
-      }
+    return 0;
+  }
+
+  if(mode == "--watch") {
+    // case: ./mypl --watch script-file
+    if(args.size() != 3) {
+      usage();
+      return 1;
     }
-    // case: invalid mode
-    else {
-      cout << "ERROR: Unable to open file '" << string(argv[1]) << "'" << endl;
+    return watch(args[2]);
+  }
+
+  if(mode == "--serve") {
+    // case: ./mypl --serve sock
+    if(args.size() != 3) {
+      usage();
       return 1;
     }
-    delete(input);
+    return serve(args[2]);
   }
-  else {
-    // case: too many parameters
-    usage();
+
+  if(mode == "--client") {
+    // case: ./mypl --client sock [script-file]
+    if(args.size() < 3 || args.size() > 4) {
+      usage();
+      return 1;
+    }
+    return client(args[2], args.size() == 4 ? args[3] : "");
   }
 
-}
+  bool is_mode = mode == "--lex" || mode == "--parse" || mode == "--print" ||
+    mode == "--check" || mode == "--ir";
+
+  if(args.size() == 2) {
+    if(is_mode)
+      return run_mode(mode, "", cin);
+    // case: ./mypl script-file
+    ifstream file(args[1]);
+    return run_mode("", args[1], file);
+  }
+
+  if(args.size() == 3) {
+    ifstream file(args[2]);
+    // case: invalid file
+    if(file.fail()) {
+      cout << "ERROR: Unable to open file '" << args[2] << "'" << endl;
+      return 0;
+    }
+    // case: invalid mode
+    if(!is_mode) {
+      cout << "ERROR: Unable to open file '" << args[1] << "'" << endl;
+      return 1;
+    }
+    return run_mode(mode, args[2], file);
+  }
 
+  // case: too many parameters
+  usage();
+  return 0;
+}
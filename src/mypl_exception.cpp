@@ -32,6 +32,11 @@ MyPLException MyPLException::VMError(const std::string& msg)
 {
   return MyPLException("VM Error: " + msg);    
 }
+
+MyPLException MyPLException::BytecodeError(const std::string& msg)
+{
+  return MyPLException("Bytecode Error: " + msg);
+}
   
 const char* MyPLException::what() const noexcept 
 {
@@ -55,7 +55,7 @@ enum class OpCode {
   CONCAT,       // pop x, pop y, push y + x (string concat)
     
   // heap
-  ALLOCS,       // allocate struct obj, push oid x
+  ALLOCS,       // allocate struct obj (of operand type), push oid x
   ALLOCA,       // pop x, pop y, allocate array obj with y x values, push oid
   ADDF,         // [operand] pop x, add field named v to obj(x)
   SETF,         // [operand] pop x and y, set obj(y).v = x
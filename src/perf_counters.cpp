@@ -0,0 +1,205 @@
+//----------------------------------------------------------------------
+// FILE: perf_counters.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: PerfCounters implementation
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "perf_counters.h"
+
+using namespace std;
+
+
+PerfCounters::PerfCounters()
+{
+  if (open(PERF_TYPE_HARDWARE,
+           {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES},
+           {"cycles", "instructions", "cache-misses", "branch-misses"}))
+    counter_source = Source::HARDWARE;
+  else if (open(PERF_TYPE_SOFTWARE,
+                {PERF_COUNT_SW_TASK_CLOCK, PERF_COUNT_SW_PAGE_FAULTS,
+                 PERF_COUNT_SW_CONTEXT_SWITCHES},
+                {"task-clock-ns", "page-faults", "context-switches"}))
+    counter_source = Source::SOFTWARE;
+  else {
+    counter_source = Source::CPU_CLOCK;
+    counter_names = {"cpu-ns"};
+  }
+  read(last);
+}
+
+
+PerfCounters::~PerfCounters()
+{
+  for (int fd : fds)
+    close(fd);
+}
+
+
+bool PerfCounters::open(uint32_t type, const vector<uint64_t>& configs,
+                        const vector<string>& names)
+{
+  for (size_t i = 0; i < configs.size(); ++i) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = configs[i];
+    attr.read_format = PERF_FORMAT_GROUP;
+    // (user space only, which unprivileged processes are allowed)
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    int leader = fds.empty() ? -1 : fds[0];
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+    if (fd < 0) {
+      // case: without the leader there is no group
+      if (i == 0)
+        return false;
+      continue;
+    }
+    fds.push_back(fd);
+    counter_names.push_back(names[i]);
+  }
+  return true;
+}
+
+
+void PerfCounters::read(vector<uint64_t>& values) const
+{
+  values.resize(counter_names.size());
+  if (fds.empty()) {
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    values[0] = t.tv_sec * 1000000000ull + t.tv_nsec;
+    return;
+  }
+  // the group reads as the number of counters then each value
+  uint64_t buffer[1 + 8] = {};
+  if (::read(fds[0], buffer, sizeof(buffer)) < 0)
+    return;
+  for (size_t i = 0; i < values.size() and i < buffer[0]; ++i)
+    values[i] = buffer[1 + i];
+}
+
+
+PerfCounters::Source PerfCounters::source() const
+{
+  return counter_source;
+}
+
+
+const vector<string>& PerfCounters::names() const
+{
+  return counter_names;
+}
+
+
+void PerfCounters::charge()
+{
+  vector<uint64_t> now;
+  read(now);
+  if (!stack.empty())
+    for (size_t i = 0; i < now.size(); ++i)
+      stack.back()->counts[i] += now[i] - min(now[i], last[i]);
+  last = std::move(now);
+}
+
+
+void PerfCounters::enter(const VMFrameInfo& info)
+{
+  charge();
+  FunctionCounts& f = functions[info.function_name];
+  if (f.name == "") {
+    f.name = info.function_name;
+    f.counts.resize(counter_names.size(), 0);
+  }
+  ++f.calls;
+  stack.push_back(&f);
+}
+
+
+void PerfCounters::ret()
+{
+  charge();
+  stack.pop_back();
+}
+
+
+size_t PerfCounters::depth() const
+{
+  return stack.size();
+}
+
+
+void PerfCounters::unwind(size_t depth)
+{
+  while (stack.size() > depth)
+    ret();
+}
+
+
+void PerfCounters::finish()
+{
+  charge();
+  stack.clear();
+}
+
+
+vector<uint64_t> PerfCounters::counts(const string& function) const
+{
+  auto f = functions.find(function);
+  if (f == functions.end())
+    return {};
+  return f->second.counts;
+}
+
+
+void PerfCounters::report(ostream& out) const
+{
+  ios_base::fmtflags flags = out.flags();
+  auto column = [&](const string& name) {
+    return find(counter_names.begin(), counter_names.end(), name) -
+      counter_names.begin();
+  };
+  size_t cycles = column("cycles");
+  size_t instructions = column("instructions");
+  bool ipc = cycles < counter_names.size() and
+    instructions < counter_names.size();
+
+  out << endl << "Counters (" << (counter_source == Source::HARDWARE ?
+    "hardware" : counter_source == Source::SOFTWARE ?
+    "software, hardware counters unavailable" :
+    "cpu time, perf counters unavailable") << ")" << endl;
+  out << setw(12) << "calls";
+  for (const string& name : counter_names)
+    out << setw(18) << name;
+  if (ipc)
+    out << setw(8) << "ipc";
+  out << "  function" << endl;
+
+  vector<const FunctionCounts*> sorted;
+  for (const auto& [name, f] : functions)
+    sorted.push_back(&f);
+  sort(sorted.begin(), sorted.end(), [](auto a, auto b) {
+    return tie(b->counts[0], a->name) < tie(a->counts[0], b->name);
+  });
+  for (const FunctionCounts* f : sorted) {
+    out << setw(12) << f->calls;
+    for (uint64_t count : f->counts)
+      out << setw(18) << count;
+    if (ipc)
+      out << setw(8) << fixed << setprecision(2)
+          << (f->counts[cycles] ? (double)f->counts[instructions] /
+              f->counts[cycles] : 0.0);
+    out << "  " << f->name << endl;
+  }
+  out.flags(flags);
+}
@@ -0,0 +1,101 @@
+//----------------------------------------------------------------------
+// FILE: perf_counters.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Performance counters (cycles, instructions, cache misses, and
+// branch misses) of a vm run, read with perf_event_open around each
+// function activation and attributed to the running function. Falls
+// back to the kernel's software counters, and then to the thread's
+// cpu time, when hardware counters are unavailable.
+//----------------------------------------------------------------------
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vm_frame.h"
+
+
+class PerfCounters
+{
+public:
+
+  // which counters could be opened
+  enum class Source {HARDWARE, SOFTWARE, CPU_CLOCK};
+
+  // opens the best counters available to the process (counting this
+  // thread only, in user space)
+  PerfCounters();
+
+  // closes the counters
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  Source source() const;
+
+  // the names of the counters (e.g., "cycles")
+  const std::vector<std::string>& names() const;
+
+  // the vm calls these as it runs (see VM::set_counters): a function
+  // starts, and the current function returns
+  void enter(const VMFrameInfo& info);
+  void ret();
+
+  // the number of functions running, and return from those above the
+  // given number (when an error unwinds the vm)
+  size_t depth() const;
+  void unwind(size_t depth);
+
+  // charge the counts so far to the running function and close the
+  // functions still running (e.g., after a vm error)
+  void finish();
+
+  // the counts of the function's activations, not counting the
+  // functions it called (empty if it never ran)
+  std::vector<uint64_t> counts(const std::string& function) const;
+
+  // write a table of each function's calls and counts (by the first
+  // counter), with instructions per cycle if both are counted
+  void report(std::ostream& out) const;
+
+private:
+
+  struct FunctionCounts {
+    std::string name;
+    uint64_t calls = 0;
+    std::vector<uint64_t> counts;
+  };
+
+  Source counter_source = Source::CPU_CLOCK;
+  std::vector<std::string> counter_names;
+
+  // the counters' file descriptors (the first leads the group)
+  std::vector<int> fds;
+
+  std::unordered_map<std::string, FunctionCounts> functions;
+  std::vector<FunctionCounts*> stack;
+
+  // the counter values when last read
+  std::vector<uint64_t> last;
+
+  // open the counters of the given type and configs (keeping those
+  // the kernel allows, if the first is), returns true if any opened
+  bool open(uint32_t type, const std::vector<uint64_t>& configs,
+            const std::vector<std::string>& names);
+
+  // the current counter values
+  void read(std::vector<uint64_t>& values) const;
+
+  // add the counts since the last read to the running function
+  void charge();
+
+};
+
+
+#endif
@@ -0,0 +1,116 @@
+//----------------------------------------------------------------------
+// FILE: perf_map.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: PerfMap implementation
+//----------------------------------------------------------------------
+
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "perf_map.h"
+#include "mypl_exception.h"
+
+using namespace std;
+
+
+namespace {
+
+  // the trampoline's machine code: set up a frame (so frame pointer
+  // unwinding walks through it), call the entry (the third argument)
+  // with the first two arguments as given, and return
+#if defined(__x86_64__)
+  const unsigned char CODE[] = {
+    0x55,                     // push %rbp
+    0x48, 0x89, 0xe5,         // mov %rsp, %rbp
+    0xff, 0xd2,               // call *%rdx
+    0x5d,                     // pop %rbp
+    0xc3                      // ret
+  };
+#elif defined(__aarch64__)
+  const uint32_t CODE[] = {
+    0xa9bf7bfd,               // stp x29, x30, [sp, #-16]!
+    0x910003fd,               // mov x29, sp
+    0xd63f0040,               // blr x2
+    0xa8c17bfd,               // ldp x29, x30, [sp], #16
+    0xd65f03c0                // ret
+  };
+#else
+  const unsigned char CODE[] = {0};
+#endif
+
+  // trampolines are padded to a cache line
+  const size_t SLOT_SIZE = 64;
+
+  size_t page_size()
+  {
+    static size_t size = sysconf(_SC_PAGESIZE);
+    return size;
+  }
+
+}
+
+
+bool PerfMap::supported()
+{
+#if defined(__linux__) and (defined(__x86_64__) or defined(__aarch64__))
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+PerfMap::PerfMap()
+  : map_path("/tmp/perf-" + to_string(getpid()) + ".map")
+{
+  if (!supported())
+    throw MyPLException::VMError("perf maps are not supported on this host");
+  map_file = fopen(map_path.c_str(), "w");
+  if (map_file == nullptr)
+    throw MyPLException::VMError("unable to write '" + map_path + "'");
+}
+
+
+PerfMap::~PerfMap()
+{
+  for (char* page : pages)
+    munmap(page, page_size());
+  if (map_file)
+    fclose(map_file);
+}
+
+
+const string& PerfMap::path() const
+{
+  return map_path;
+}
+
+
+PerfMap::Trampoline PerfMap::build(const string& name)
+{
+  if (pages.empty() or used + SLOT_SIZE > page_size()) {
+    void* page = mmap(nullptr, page_size(), PROT_READ | PROT_EXEC,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED)
+      throw MyPLException::VMError("unable to map trampoline code");
+    pages.push_back(static_cast<char*>(page));
+    used = 0;
+  }
+  // (the page is only writable while the code is copied in)
+  char* page = pages.back();
+  char* code = page + used;
+  if (mprotect(page, page_size(), PROT_READ | PROT_WRITE) != 0)
+    throw MyPLException::VMError("unable to write trampoline code");
+  memcpy(code, CODE, sizeof(CODE));
+  mprotect(page, page_size(), PROT_READ | PROT_EXEC);
+  __builtin___clear_cache(code, code + sizeof(CODE));
+  used += SLOT_SIZE;
+
+  // perf reads the map when reporting, so each line is written now
+  fprintf(map_file, "%lx %zx mypl::%s\n", (unsigned long)(uintptr_t)code,
+          sizeof(CODE), name.c_str());
+  fflush(map_file);
+  return reinterpret_cast<Trampoline>(code);
+}
@@ -0,0 +1,81 @@
+//----------------------------------------------------------------------
+// FILE: perf_map.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Makes MyPL functions visible to Linux perf. Each function gets
+// a tiny native trampoline that the vm calls through to run the
+// function's frame, and the trampoline's address range is named in
+// /tmp/perf-<pid>.map, so perf call graphs show "mypl::f" frames
+// between the vm's own.
+//----------------------------------------------------------------------
+
+#ifndef PERF_MAP_H
+#define PERF_MAP_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vm_frame.h"
+
+class VM;
+
+
+class PerfMap
+{
+public:
+
+  // runs the vm's top frame until it returns (see VM::set_perf_map)
+  typedef void (*Entry)(VM* vm, bool print);
+
+  // calls the entry with the vm and print flag from its own frame
+  typedef void (*Trampoline)(VM* vm, bool print, Entry entry);
+
+  // creates /tmp/perf-<pid>.map (throws a vm error if perf maps are
+  // unsupported on this host or the file can't be written)
+  PerfMap();
+
+  // frees the trampolines (leaving the map file for perf report)
+  ~PerfMap();
+
+  PerfMap(const PerfMap&) = delete;
+  PerfMap& operator=(const PerfMap&) = delete;
+
+  // true if trampolines can be built for this host's cpu
+  static bool supported();
+
+  // the map file
+  const std::string& path() const;
+
+  // the function's trampoline (built and named in the map the first
+  // time it is asked for)
+  Trampoline trampoline(const VMFrameInfo& info);
+
+private:
+
+  std::string map_path;
+  FILE* map_file = nullptr;
+
+  // mmap'd code pages, and the bytes used of the last one
+  std::vector<char*> pages;
+  size_t used = 0;
+
+  std::unordered_map<const VMFrameInfo*, Trampoline> trampolines;
+
+  // copy the trampoline code into a page, naming it in the map
+  Trampoline build(const std::string& name);
+
+};
+
+
+inline PerfMap::Trampoline PerfMap::trampoline(const VMFrameInfo& info)
+{
+  auto entry = trampolines.find(&info);
+  if (entry != trampolines.end())
+    return entry->second;
+  return trampolines[&info] = build(info.function_name);
+}
+
+
+#endif
@@ -37,19 +37,20 @@ void PrintVisitor::print_indent()
 
 void PrintVisitor::visit(Program& p)
 {
-  for (auto struct_def : p.struct_defs)
+  symbols = p.symbols.get();
+  for (auto& struct_def : p.struct_defs)
     struct_def.accept(*this);
-  for (auto fun_def : p.fun_defs)
+  for (auto& fun_def : p.fun_defs)
     fun_def.accept(*this);
 }
 
 // TODO: Finish the visitor functions
 void PrintVisitor::visit(FunDef& f) {
   inc_indent();
-  this->out << f.return_type.type_name << " " << f.fun_name.lexeme() << "(";
+  this->out << f.return_type.type_name(*symbols) << " " << f.fun_name.lexeme() << "(";
 
   for(int i = 0; i < f.params.size(); i++) {
-    this->out << f.params.at(i).data_type.type_name << " " << f.params.at(i).var_name.lexeme();
+    this->out << f.params.at(i).data_type.type_name(*symbols) << " " << f.params.at(i).var_name.lexeme();
     if(i < f.params.size() - 1) {
       this->out << ", ";
     }
@@ -74,7 +75,7 @@ void PrintVisitor::visit(StructDef& s) {
   
   for(int i = 0; i < s.fields.size(); i++) {
     print_indent();
-    this->out << s.fields.at(i).data_type.type_name << " " << s.fields.at(i).var_name.lexeme();
+    this->out << s.fields.at(i).data_type.type_name(*symbols) << " " << s.fields.at(i).var_name.lexeme();
     if(i < s.fields.size() - 1) {
       this->out << "," << endl;
     }
@@ -97,7 +98,7 @@ void PrintVisitor::visit(WhileStmt& s) {
   this->out << ") {" << endl;
   inc_indent();
 
-  for(auto s : s.stmts) {
+  for(auto& s : s.stmts) {
     print_indent();
     s->accept(*this);
     this->out << endl;
@@ -118,7 +119,7 @@ void PrintVisitor::visit(ForStmt& s) {
 
   inc_indent();
 
-  for(auto s : s.stmts) {
+  for(auto& s : s.stmts) {
     print_indent();
     s->accept(*this);
     this->out << endl;
@@ -136,7 +137,7 @@ void PrintVisitor::visit(IfStmt& s) {
   this->out << ") {" << endl;
   inc_indent();
 
-  for(auto s : s.if_part.stmts) {
+  for(auto& s : s.if_part.stmts) {
     print_indent();
     s->accept(*this);
     this->out << endl;
@@ -146,7 +147,7 @@ void PrintVisitor::visit(IfStmt& s) {
   print_indent();
   this->out << "}";
 
-  for(auto b : s.else_ifs) {
+  for(auto& b : s.else_ifs) {
     this->out << endl;
     print_indent();
     this->out << "elseif (";
@@ -154,7 +155,7 @@ void PrintVisitor::visit(IfStmt& s) {
     this->out << ") {" << endl;
     inc_indent();
 
-    for(auto s : b.stmts) {
+    for(auto& s : b.stmts) {
       print_indent();
       s->accept(*this);
       this->out << endl;
@@ -170,7 +171,7 @@ void PrintVisitor::visit(IfStmt& s) {
     this->out << "else {" << endl;
     inc_indent();
 
-    for(auto s : s.else_stmts) {
+    for(auto& s : s.else_stmts) {
       print_indent();
       s->accept(*this);
       this->out << endl;
@@ -182,13 +183,13 @@ void PrintVisitor::visit(IfStmt& s) {
 }
 
 void PrintVisitor::visit(VarDeclStmt& s) {
-  this->out << s.var_def.data_type.type_name << " " << s.var_def.var_name.lexeme() << " = ";
+  this->out << s.var_def.data_type.type_name(*symbols) << " " << s.var_def.var_name.lexeme() << " = ";
   s.expr.accept(*this);
 }
 
 void PrintVisitor::visit(AssignStmt& s) {
   int i = 0;
-  for(auto l : s.lvalue) {
+  for(auto& l : s.lvalue) {
     this->out << l.var_name.lexeme();
     i++;
     if(i > 0 && i < s.lvalue.size())
@@ -273,7 +274,7 @@ void PrintVisitor::visit(SwitchStmt& s) {
   this->out << ") {" << endl;
   inc_indent();
 
-  for(auto b : s.cases) {
+  for(auto& b : s.cases) {
     this->out << endl;
     print_indent();
     this->out << "case ";
@@ -283,7 +284,7 @@ void PrintVisitor::visit(SwitchStmt& s) {
     this->out << ":" << endl;
     inc_indent();
 
-    for(auto s : b.stmts) {
+    for(auto& s : b.stmts) {
       print_indent();
       s->accept(*this);
       this->out << endl;
@@ -306,7 +307,7 @@ void PrintVisitor::visit(SwitchStmt& s) {
     this->out << "default :" << endl;
     inc_indent();
 
-    for(auto s : s.defaults) {
+    for(auto& s : s.defaults) {
       print_indent();
       s->accept(*this);
       this->out << endl;
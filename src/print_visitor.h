@@ -38,6 +38,8 @@ public:
 
 private:
   std::ostream& out;  
+  // the program's symbols (for type names)
+  const Interner* symbols = nullptr;
   int indent = 0;
   const int INDENT_AMT = 2;
 
@@ -0,0 +1,316 @@
+//----------------------------------------------------------------------
+// FILE: profiler.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Profiler implementation
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <tuple>
+#include "profiler.h"
+#include "vm.h"
+
+using namespace std;
+
+
+void Profiler::enter(const VMFrameInfo& info)
+{
+  FunctionProfile& f = functions[info.function_name];
+  if (f.name == "")
+    f.name = info.function_name;
+  if (f.counts.size() < info.instructions.size()) {
+    f.counts.resize(info.instructions.size(), 0);
+    f.lines.resize(info.instructions.size());
+    for (int pc = 0; pc < f.lines.size(); ++pc)
+      f.lines[pc] = info.line(pc);
+  }
+  ++f.calls;
+  ++f.active;
+  stack.push_back({&f, Clock::now()});
+}
+
+
+void Profiler::call(int pc, const VMFrameInfo& callee)
+{
+  FunctionProfile* caller = stack.back().function;
+  charge(stack.back(), Clock::now());
+  enter(callee);
+  CallSite& site = caller->sites[pc];
+  site.callee = stack.back().function;
+  ++site.count;
+}
+
+
+void Profiler::ret()
+{
+  Clock::time_point now = Clock::now();
+  Active a = stack.back();
+  stack.pop_back();
+  charge(a, now);
+  uint64_t elapsed = chrono::duration_cast<chrono::nanoseconds>(
+    now - a.start).count();
+  FunctionProfile& f = *a.function;
+  f.exclusive_ns += elapsed - min(elapsed, a.child_ns);
+  if (--f.active == 0)
+    f.inclusive_ns += elapsed;
+  if (!stack.empty()) {
+    stack.back().child_ns += elapsed;
+    stack.back().line_start = now;
+  }
+}
+
+
+void Profiler::charge(Active& a, Clock::time_point now)
+{
+  a.function->line_ns[a.line] += chrono::duration_cast<chrono::nanoseconds>(
+    now - a.line_start).count();
+  a.line_start = now;
+}
+
+
+size_t Profiler::depth() const
+{
+  return stack.size();
+}
+
+
+void Profiler::unwind(size_t depth)
+{
+  while (stack.size() > depth)
+    ret();
+}
+
+
+void Profiler::finish()
+{
+  while (!stack.empty())
+    ret();
+}
+
+
+vector<const Profiler::FunctionProfile*> Profiler::by_time() const
+{
+  vector<const FunctionProfile*> result;
+  for (const auto& [name, f] : functions)
+    result.push_back(&f);
+  sort(result.begin(), result.end(), [](auto a, auto b) {
+    return tie(b->exclusive_ns, a->name) < tie(a->exclusive_ns, b->name);
+  });
+  return result;
+}
+
+
+map<int, Profiler::LineProfile> Profiler::lines(const FunctionProfile& f) const
+{
+  map<int, LineProfile> result;
+  for (int pc = 0; pc < f.counts.size(); ++pc)
+    if (f.counts[pc] > 0)
+      result[f.lines[pc]].count += f.counts[pc];
+  for (const auto& [line, ns] : f.line_ns)
+    result[line].ns += ns;
+  // (instructions of unknown lines are left out)
+  result.erase(0);
+  return result;
+}
+
+
+map<int, Profiler::LineProfile> Profiler::lines() const
+{
+  map<int, LineProfile> result;
+  for (const auto& [name, f] : functions)
+    for (const auto& [line, l] : lines(f)) {
+      result[line].count += l.count;
+      result[line].ns += l.ns;
+    }
+  return result;
+}
+
+
+namespace {
+
+  // the instruction of the function at pc as text (or ? if unknown)
+  string instr_text(const VM& vm, const string& function, int pc)
+  {
+    auto frame = vm.frames().find(function);
+    if (frame == vm.frames().end() or
+        pc >= frame->second.instructions.size())
+      return "?";
+    return to_string(frame->second.instructions[pc], vm.symbols().get());
+  }
+
+  string ms(uint64_t ns)
+  {
+    stringstream s;
+    s << fixed << setprecision(3) << ns / 1e6;
+    return s.str();
+  }
+
+}
+
+
+string json_string(const string& s)
+{
+  string result = "\"";
+  for (char c : s) {
+    if (c == '"' or c == '\\')
+      result += '\\';
+    if ((unsigned char)c < 0x20) {
+      char hex[8];
+      snprintf(hex, sizeof(hex), "\\u%04x", c);
+      result += hex;
+    }
+    else
+      result += c;
+  }
+  return result + "\"";
+}
+
+
+void Profiler::report(ostream& out, const VM& vm, size_t top) const
+{
+  ios_base::fmtflags flags = out.flags();
+  uint64_t total = 0;
+  for (uint64_t count : opcode_counts)
+    total += count;
+
+  out << endl << "Functions (by exclusive time)" << endl;
+  out << setw(12) << "calls" << setw(16) << "inclusive ms" << setw(16)
+      << "exclusive ms" << "  function" << endl;
+  for (const FunctionProfile* f : by_time())
+    out << setw(12) << f->calls << setw(16) << ms(f->inclusive_ns)
+        << setw(16) << ms(f->exclusive_ns) << "  " << f->name << endl;
+
+  out << endl << "Opcodes (by count)" << endl;
+  vector<size_t> opcodes;
+  for (size_t i = 0; i < OPCODE_COUNT; ++i)
+    if (opcode_counts[i] > 0)
+      opcodes.push_back(i);
+  sort(opcodes.begin(), opcodes.end(), [&](size_t a, size_t b) {
+    return tie(opcode_counts[b], a) < tie(opcode_counts[a], b);
+  });
+  for (size_t i : opcodes)
+    out << setw(12) << opcode_counts[i] << setw(7) << fixed
+        << setprecision(1) << (100.0 * opcode_counts[i] / total) << "%  "
+        << to_string((OpCode)i) << endl;
+
+  out << endl << "Instructions (top " << top << " by count)" << endl;
+  vector<tuple<uint64_t, string, int>> instrs;
+  for (const auto& [name, f] : functions)
+    for (int pc = 0; pc < f.counts.size(); ++pc)
+      if (f.counts[pc] > 0)
+        instrs.push_back({f.counts[pc], name, pc});
+  sort(instrs.begin(), instrs.end(), [](const auto& a, const auto& b) {
+    return tie(get<0>(b), get<1>(a), get<2>(a)) <
+      tie(get<0>(a), get<1>(b), get<2>(b));
+  });
+  for (size_t i = 0; i < min(top, instrs.size()); ++i) {
+    auto& [count, name, pc] = instrs[i];
+    out << setw(12) << count << "  " << name << ":" << pc << "  "
+        << instr_text(vm, name, pc) << endl;
+  }
+
+  out << endl << "Call sites (top " << top << " by count)" << endl;
+  vector<tuple<uint64_t, string, int, string>> sites;
+  for (const auto& [name, f] : functions)
+    for (const auto& [pc, site] : f.sites)
+      sites.push_back({site.count, name, pc, site.callee->name});
+  sort(sites.begin(), sites.end(), [](const auto& a, const auto& b) {
+    return tie(get<0>(b), get<1>(a), get<2>(a)) <
+      tie(get<0>(a), get<1>(b), get<2>(b));
+  });
+  for (size_t i = 0; i < min(top, sites.size()); ++i) {
+    auto& [count, name, pc, callee] = sites[i];
+    out << setw(12) << count << "  " << name << ":" << pc << " -> "
+        << callee << endl;
+  }
+
+  out << endl << "Lines (top " << top << " by exclusive time)" << endl;
+  out << setw(12) << "count" << setw(16) << "exclusive ms" << "  line"
+      << endl;
+  vector<pair<int, LineProfile>> by_line;
+  for (const auto& entry : lines())
+    by_line.push_back(entry);
+  sort(by_line.begin(), by_line.end(), [](const auto& a, const auto& b) {
+    return tie(b.second.ns, b.second.count, a.first) <
+      tie(a.second.ns, a.second.count, b.first);
+  });
+  for (size_t i = 0; i < min(top, by_line.size()); ++i) {
+    auto& [line, l] = by_line[i];
+    out << setw(12) << l.count << setw(16) << ms(l.ns) << "  " << line
+        << endl;
+  }
+  out.flags(flags);
+}
+
+
+void Profiler::annotate(ostream& out, string_view source) const
+{
+  ios_base::fmtflags flags = out.flags();
+  map<int, LineProfile> by_line = lines();
+  out << setw(12) << "count" << setw(16) << "exclusive ms" << setw(7)
+      << "line" << "  source" << endl;
+  int line = 1;
+  while (!source.empty()) {
+    size_t end = source.find('\n');
+    string_view text = source.substr(0, end);
+    source.remove_prefix(end == string_view::npos ? source.size() : end + 1);
+    auto l = by_line.find(line);
+    if (l != by_line.end())
+      out << setw(12) << l->second.count << setw(16) << ms(l->second.ns);
+    else
+      out << setw(28) << "";
+    out << setw(7) << line << "  " << text << endl;
+    ++line;
+  }
+  out.flags(flags);
+}
+
+
+void Profiler::write_json(ostream& out) const
+{
+  out << "{" << endl << "  \"opcodes\": {";
+  bool first = true;
+  for (size_t i = 0; i < OPCODE_COUNT; ++i) {
+    if (opcode_counts[i] == 0)
+      continue;
+    out << (first ? "" : ",") << endl << "    "
+        << json_string(to_string((OpCode)i)) << ": " << opcode_counts[i];
+    first = false;
+  }
+  out << endl << "  }," << endl << "  \"functions\": [";
+  first = true;
+  for (const FunctionProfile* f : by_time()) {
+    out << (first ? "" : ",") << endl << "    {\"name\": "
+        << json_string(f->name) << ", \"calls\": " << f->calls
+        << ", \"inclusive_ns\": " << f->inclusive_ns
+        << ", \"exclusive_ns\": " << f->exclusive_ns
+        << ", \"instructions\": [";
+    for (size_t pc = 0; pc < f->counts.size(); ++pc)
+      out << (pc == 0 ? "" : ", ") << f->counts[pc];
+    out << "], \"call_sites\": [";
+    vector<int> pcs;
+    for (const auto& [pc, site] : f->sites)
+      pcs.push_back(pc);
+    sort(pcs.begin(), pcs.end());
+    for (size_t i = 0; i < pcs.size(); ++i) {
+      const CallSite& site = f->sites.at(pcs[i]);
+      out << (i == 0 ? "" : ", ") << "{\"pc\": " << pcs[i]
+          << ", \"callee\": " << json_string(site.callee->name)
+          << ", \"count\": " << site.count << "}";
+    }
+    out << "], \"lines\": [";
+    bool first_line = true;
+    for (const auto& [line, l] : lines(*f)) {
+      out << (first_line ? "" : ", ") << "{\"line\": " << line
+          << ", \"count\": " << l.count << ", \"exclusive_ns\": " << l.ns
+          << "}";
+      first_line = false;
+    }
+    out << "]}";
+    first = false;
+  }
+  out << endl << "  ]" << endl << "}" << endl;
+}
@@ -0,0 +1,145 @@
+//----------------------------------------------------------------------
+// FILE: profiler.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Execution profile of a vm run: counts of each opcode and of
+// each instruction, calls and inclusive/exclusive time of each
+// function, counts of each call site, and counts and exclusive time
+// of each source line.
+//----------------------------------------------------------------------
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "op_code.h"
+#include "vm_frame.h"
+
+class VM;
+
+
+// the number of opcodes (NOP is last)
+const size_t OPCODE_COUNT = (size_t)OpCode::NOP + 1;
+
+// the string as a json string literal
+std::string json_string(const std::string& s);
+
+
+class Profiler
+{
+public:
+
+  // the vm calls these as it runs (see VM::set_profiler): a function
+  // starts (main), the current function calls another from the
+  // instruction at pc, an instruction executes, the current function
+  // returns, and the run ends
+  void enter(const VMFrameInfo& info);
+  void call(int pc, const VMFrameInfo& callee);
+  void step(OpCode opcode, int pc);
+  void ret();
+
+  // the number of functions running, and return from those above the
+  // given number (when an error unwinds the vm), counting their time
+  size_t depth() const;
+  void unwind(size_t depth);
+
+  // close the functions still running (e.g., after a vm error), so
+  // their time is counted
+  void finish();
+
+  // write a report of the hottest functions, opcodes, instructions,
+  // call sites, and source lines, each sorted by cost
+  void report(std::ostream& out, const VM& vm, size_t top = 20) const;
+
+  // write the program's source with the count of instructions executed
+  // and the time spent on each line
+  void annotate(std::ostream& out, std::string_view source) const;
+
+  // write the whole profile as json
+  void write_json(std::ostream& out) const;
+
+private:
+
+  typedef std::chrono::steady_clock Clock;
+
+  struct FunctionProfile;
+
+  struct CallSite {
+    FunctionProfile* callee = nullptr;
+    uint64_t count = 0;
+  };
+
+  struct FunctionProfile {
+    std::string name;
+    uint64_t calls = 0;
+    uint64_t inclusive_ns = 0;
+    uint64_t exclusive_ns = 0;
+    // executions of each instruction
+    std::vector<uint64_t> counts;
+    // calls made from each instruction
+    std::unordered_map<int, CallSite> sites;
+    // the source line of each instruction (0 if unknown)
+    std::vector<int> lines;
+    // time spent on each source line, not counting calls made from it
+    std::unordered_map<int, uint64_t> line_ns;
+    // times the function is on the stack (inclusive time is only
+    // counted for the outermost of recursive calls)
+    int active = 0;
+  };
+
+  // a function call that has not returned yet
+  struct Active {
+    FunctionProfile* function;
+    Clock::time_point start;
+    // total time of the calls it made
+    uint64_t child_ns = 0;
+    // the line it is running and when it started running it
+    int line = 0;
+    Clock::time_point line_start = start;
+  };
+
+  struct LineProfile {
+    uint64_t count = 0;
+    uint64_t ns = 0;
+  };
+
+  std::unordered_map<std::string, FunctionProfile> functions;
+  std::array<uint64_t, OPCODE_COUNT> opcode_counts = {};
+  std::vector<Active> stack;
+
+  // the functions sorted by decreasing exclusive time
+  std::vector<const FunctionProfile*> by_time() const;
+
+  // add the time since the call started running its line to the line
+  void charge(Active& a, Clock::time_point now);
+
+  // the instructions executed and time spent on each line of the
+  // function, and of the whole program
+  std::map<int, LineProfile> lines(const FunctionProfile& f) const;
+  std::map<int, LineProfile> lines() const;
+
+};
+
+
+inline void Profiler::step(OpCode opcode, int pc)
+{
+  ++opcode_counts[(size_t)opcode];
+  Active& a = stack.back();
+  ++a.function->counts[pc];
+  // (the clock is only read when the running line changes)
+  if (a.function->lines[pc] != a.line) {
+    charge(a, Clock::now());
+    a.line = a.function->lines[pc];
+  }
+}
+
+
+#endif
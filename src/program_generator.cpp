@@ -0,0 +1,425 @@
+//----------------------------------------------------------------------
+// FILE: program_generator.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: ProgramGenerator implementation
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include "program_generator.h"
+
+using namespace std;
+
+
+// Every generated function takes an int n first and only runs its body
+// when n > 0, passing n - 1 to the (earlier) functions it calls, so the
+// work done by a call is bounded. Loops count to small constants,
+// divisors are nonzero literals, and structs and arrays are initialized
+// before they are read, so generated programs never fail at runtime.
+
+
+ProgramGenerator::ProgramGenerator(const Shape& shape, unsigned seed)
+  : shape(shape), rng(seed)
+{
+}
+
+
+string ProgramGenerator::generate()
+{
+  out.clear();
+  struct_fields.clear();
+  functions.clear();
+  returning.clear();
+  for (size_t i = 0; i < shape.structs; ++i)
+    struct_def(i);
+  // signatures come first so bodies know what they can call
+  for (size_t i = 0; i < shape.functions; ++i) {
+    Function f;
+    f.return_type = chance(0.15) ? "void" : value_type();
+    for (size_t j = pick(3); j > 0; --j)
+      f.param_types.push_back(value_type());
+    functions.push_back(f);
+    returning[f.return_type].push_back(i);
+  }
+  for (size_t i = 0; i < shape.functions; ++i)
+    fun_def(i);
+  main_def();
+  return std::move(out);
+}
+
+
+//----------------------------------------------------------------------
+// random helpers
+//----------------------------------------------------------------------
+
+size_t ProgramGenerator::pick(size_t n)
+{
+  // (not a distribution, so programs are the same on every platform)
+  return n == 0 ? 0 : rng() % n;
+}
+
+
+bool ProgramGenerator::chance(double p)
+{
+  return rng() < p * rng.max();
+}
+
+
+string ProgramGenerator::primitive_type()
+{
+  static const char* types[] = {"int", "int", "double", "string", "bool"};
+  return types[pick(5)];
+}
+
+
+string ProgramGenerator::value_type()
+{
+  if (shape.structs > 0 and chance(0.2))
+    return "S" + to_string(pick(shape.structs));
+  return primitive_type();
+}
+
+
+void ProgramGenerator::line(size_t indent, const string& text)
+{
+  out.append(indent * 2, ' ');
+  out += text;
+  out += '\n';
+}
+
+
+//----------------------------------------------------------------------
+// definitions
+//----------------------------------------------------------------------
+
+void ProgramGenerator::struct_def(size_t index)
+{
+  vector<string> fields;
+  for (size_t i = 2 + pick(4); i > 0; --i)
+    fields.push_back(primitive_type());
+  line(0, "struct S" + to_string(index) + " {");
+  for (size_t i = 0; i < fields.size(); ++i)
+    line(1, fields[i] + " f" + to_string(i) +
+         (i + 1 < fields.size() ? "," : ""));
+  line(0, "}");
+  line(0, "");
+  struct_fields.push_back(fields);
+}
+
+
+void ProgramGenerator::fun_def(size_t index)
+{
+  const Function& f = functions[index];
+  curr_function = index;
+  vars.clear();
+  next_var = 0;
+  string header = f.return_type + " fun_" + to_string(index) + "(int n";
+  vars.push_back({"n", "int", false});
+  for (size_t i = 0; i < f.param_types.size(); ++i) {
+    string name = "p" + to_string(i);
+    header += ", " + f.param_types[i] + " " + name;
+    vars.push_back({name, f.param_types[i], true});
+  }
+  line(0, header + ") {");
+  line(1, "if (n > 0) {");
+  block(2, shape.depth);
+  line(1, "}");
+  if (f.return_type != "void") {
+    if (f.return_type[0] == 'S' and variable(f.return_type) == "")
+      decl(1, f.return_type);
+    line(1, "return " + expr(f.return_type, shape.depth));
+  }
+  line(0, "}");
+  line(0, "");
+}
+
+
+void ProgramGenerator::main_def()
+{
+  curr_function = functions.size();
+  vars.clear();
+  next_var = 0;
+  line(0, "void main() {");
+  // one of each struct to pass to the functions
+  for (size_t i = 0; i < shape.structs; ++i)
+    decl(1, "S" + to_string(i));
+  for (size_t i = 0; i < functions.size(); ++i) {
+    string c = call_to(i, "1", 1);
+    const string& type = functions[i].return_type;
+    if (type == "void")
+      line(1, c);
+    else if (type[0] == 'S')
+      line(1, type + " r" + to_string(i) + " = " + c);
+    else {
+      line(1, "print(" + c + ")");
+      line(1, "print(\"\\n\")");
+    }
+  }
+  line(0, "}");
+}
+
+
+//----------------------------------------------------------------------
+// statements
+//----------------------------------------------------------------------
+
+void ProgramGenerator::block(size_t indent, size_t depth)
+{
+  size_t scope = vars.size();
+  size_t count = max<size_t>(1, shape.statements / 2 +
+                             pick(shape.statements / 2 + 1));
+  for (size_t i = 0; i < count; ++i)
+    stmt(indent, depth);
+  vars.resize(scope);
+}
+
+
+void ProgramGenerator::stmt(size_t indent, size_t depth)
+{
+  if (chance(0.05))
+    line(indent, "# step " + to_string(next_var));
+  size_t r = pick(100);
+  // nested blocks only while under the depth bound
+  if (depth == 0 and r >= 50 and r < 80)
+    r = pick(50);
+  if (r < 25)
+    decl(indent, value_type());
+  else if (r < 30) {
+    // an array, filled then read (elements are only read directly into
+    // a variable, since the checker takes indexed values used in
+    // conditions and conversions for arrays)
+    string name = "a" + to_string(next_var++);
+    size_t size = 3 + pick(5);
+    line(indent, "array int " + name + " = new int[" + to_string(size) + "]");
+    line(indent, "for (int j = 0; j < " + to_string(size) + "; j = j + 1) {");
+    line(indent + 1, name + "[j] = " + expr("int", 1));
+    line(indent, "}");
+    string v = "v" + to_string(next_var++);
+    line(indent, "int " + v + " = " + name + "[" + to_string(pick(size)) + "]");
+    vars.push_back({v, "int", true});
+  }
+  else if (r < 50) {
+    vector<const Var*> targets;
+    for (const Var& v : vars)
+      if (v.assignable)
+        targets.push_back(&v);
+    if (targets.empty()) {
+      decl(indent, primitive_type());
+      return;
+    }
+    const Var& v = *targets[pick(targets.size())];
+    if (v.type[0] == 'S') {
+      // assign a field
+      const vector<string>& fields = struct_fields[stoi(v.type.substr(1))];
+      size_t i = pick(fields.size());
+      line(indent, v.name + ".f" + to_string(i) + " = " +
+           expr(fields[i], depth));
+    }
+    else
+      line(indent, v.name + " = " + expr(v.type, depth));
+  }
+  else if (r < 60) {
+    line(indent, "if (" + expr("bool", depth) + ") {");
+    block(indent + 1, depth - 1);
+    if (chance(0.3)) {
+      line(indent, "}");
+      line(indent, "elseif (" + expr("bool", depth) + ") {");
+      block(indent + 1, depth - 1);
+    }
+    if (chance(0.5)) {
+      line(indent, "}");
+      line(indent, "else {");
+      block(indent + 1, depth - 1);
+    }
+    line(indent, "}");
+  }
+  else if (r < 68) {
+    string counter = "i" + to_string(next_var++);
+    line(indent, "int " + counter + " = 0");
+    line(indent, "while (" + counter + " < " + to_string(1 + pick(3)) + ") {");
+    vars.push_back({counter, "int", false});
+    block(indent + 1, depth - 1);
+    line(indent + 1, counter + " = " + counter + " + 1");
+    line(indent, "}");
+  }
+  else if (r < 76) {
+    string counter = "j" + to_string(next_var++);
+    line(indent, "for (int " + counter + " = 0; " + counter + " < " +
+         to_string(1 + pick(3)) + "; " + counter + " = " + counter +
+         " + 1) {");
+    vars.push_back({counter, "int", false});
+    block(indent + 1, depth - 1);
+    vars.pop_back();
+    line(indent, "}");
+  }
+  else if (r < 80) {
+    size_t cases = 1 + pick(4);
+    line(indent, "switch (" + to_string(pick(cases + 1)) + ") {");
+    for (size_t i = 0; i < cases; ++i) {
+      line(indent + 1, "case " + to_string(i) + ":");
+      block(indent + 2, depth - 1);
+      if (chance(0.8))
+        line(indent + 2, "break");
+    }
+    line(indent + 1, "default:");
+    block(indent + 2, depth - 1);
+    line(indent, "}");
+  }
+  else {
+    string c = call("void", depth);
+    if (c == "")
+      decl(indent, primitive_type());
+    else
+      line(indent, c);
+  }
+}
+
+
+void ProgramGenerator::decl(size_t indent, const string& type)
+{
+  string name = "v" + to_string(next_var++);
+  if (type[0] == 'S') {
+    line(indent, type + " " + name + " = new " + type);
+    init_struct(indent, name, type);
+  }
+  else
+    line(indent, type + " " + name + " = " + expr(type, shape.depth));
+  vars.push_back({name, type, true});
+}
+
+
+void ProgramGenerator::init_struct(size_t indent, const string& name,
+                                   const string& type)
+{
+  const vector<string>& fields = struct_fields[stoi(type.substr(1))];
+  for (size_t i = 0; i < fields.size(); ++i)
+    line(indent, name + ".f" + to_string(i) + " = " + expr(fields[i], 1));
+}
+
+
+//----------------------------------------------------------------------
+// expressions
+//----------------------------------------------------------------------
+
+string ProgramGenerator::expr(const string& type, size_t depth)
+{
+  if (type[0] == 'S')
+    return variable(type);
+  if (depth == 0 or chance(0.4))
+    return operand(type);
+  string a = expr(type, depth - 1);
+  size_t r = pick(6);
+  if (r == 5) {
+    string c = call(type, depth - 1);
+    if (c != "")
+      return c;
+    r = pick(5);
+  }
+  if (type == "int") {
+    if (r <= 1)
+      return "(" + a + (r == 0 ? " + " : " - ") + expr(type, depth - 1) + ")";
+    if (r == 2)
+      return "(" + a + " / " + to_string(1 + pick(9)) + ")";
+    if (r == 3)
+      return "length(" + expr("string", depth - 1) + ")";
+    return "(" + literal("int") + " * " + literal("int") + ")";
+  }
+  if (type == "double") {
+    if (r <= 1)
+      return "(" + a + (r == 0 ? " + " : " - ") + expr(type, depth - 1) + ")";
+    if (r == 2)
+      return "(" + a + " * 0.5)";
+    return "to_double(" + expr("int", depth - 1) + ")";
+  }
+  if (type == "string") {
+    // only one side grows, so strings built in loops stay small
+    if (r <= 1)
+      return "concat(" + a + ", " + literal("string") + ")";
+    if (r == 2)
+      return "concat(" + literal("string") + ", " + a + ")";
+    return "to_string(" + expr(r == 3 ? "int" : "double", depth - 1) + ")";
+  }
+  // bool
+  if (r == 0)
+    return "(" + a + (chance(0.5) ? " and " : " or ") + expr(type, depth - 1) +
+      ")";
+  if (r == 1)
+    return "(not (" + a + "))";
+  string operand_type = r == 2 ? "double" : "int";
+  static const char* comparators[] = {" < ", " <= ", " > ", " >= ", " == ",
+                                      " != "};
+  return "(" + expr(operand_type, depth - 1) + comparators[pick(6)] +
+    expr(operand_type, depth - 1) + ")";
+}
+
+
+string ProgramGenerator::operand(const string& type)
+{
+  if (chance(shape.literal_density))
+    return literal(type);
+  string v = variable(type);
+  return v == "" ? literal(type) : v;
+}
+
+
+string ProgramGenerator::literal(const string& type)
+{
+  if (type == "int")
+    return to_string(pick(100));
+  if (type == "double")
+    return to_string(pick(100)) + "." + to_string(pick(10));
+  if (type == "bool")
+    return chance(0.5) ? "true" : "false";
+  // string (sometimes with escapes)
+  static const char* words[] = {"alpha", "beta", "gamma", "delta", "x\\ny",
+                                "tab\\t here", "line\\n"};
+  return "\"" + string(words[pick(7)]) + "\"";
+}
+
+
+string ProgramGenerator::variable(const string& type)
+{
+  vector<string> names;
+  for (const Var& v : vars) {
+    if (v.type == type)
+      names.push_back(v.name);
+    else if (v.type[0] == 'S' and type[0] != 'S') {
+      const vector<string>& fields = struct_fields[stoi(v.type.substr(1))];
+      for (size_t i = 0; i < fields.size(); ++i)
+        if (fields[i] == type)
+          names.push_back(v.name + ".f" + to_string(i));
+    }
+  }
+  return names.empty() ? "" : names[pick(names.size())];
+}
+
+
+string ProgramGenerator::call(const string& type, size_t depth)
+{
+  auto candidates = returning.find(type);
+  if (candidates == returning.end())
+    return "";
+  const vector<size_t>& indexes = candidates->second;
+  size_t count = lower_bound(indexes.begin(), indexes.end(), curr_function) -
+    indexes.begin();
+  if (count == 0)
+    return "";
+  // (main has no n, and passes the functions a bound of 1)
+  string bound = curr_function == functions.size() ? "1" : "n - 1";
+  return call_to(indexes[pick(count)], bound, depth);
+}
+
+
+string ProgramGenerator::call_to(size_t index, const string& first,
+                                 size_t depth)
+{
+  string c = "fun_" + to_string(index) + "(" + first;
+  for (const string& type : functions[index].param_types) {
+    string arg = expr(type, depth);
+    // case: no struct of the type to pass
+    if (arg == "")
+      return "";
+    c += ", " + arg;
+  }
+  return c + ")";
+}
@@ -0,0 +1,102 @@
+//----------------------------------------------------------------------
+// FILE: program_generator.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Generates random (but deterministic per seed) MyPL programs of
+// a given size and shape for benchmarking the front end and vm.
+//----------------------------------------------------------------------
+
+#ifndef PROGRAM_GENERATOR_H
+#define PROGRAM_GENERATOR_H
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+
+class ProgramGenerator
+{
+public:
+
+  // the size and shape of the generated programs
+  struct Shape {
+    size_t functions = 100;
+    size_t structs = 10;
+    // statements per block
+    size_t statements = 6;
+    // maximum nesting of blocks (and of expressions) in a function
+    size_t depth = 3;
+    // chance each operand is a literal (instead of a variable)
+    double literal_density = 0.3;
+  };
+
+  // create a generator of programs of the given shape
+  ProgramGenerator(const Shape& shape, unsigned seed = 1);
+
+  // a new program that type checks and runs to completion (its main
+  // calls each function and prints the result)
+  std::string generate();
+
+private:
+
+  struct Var {
+    std::string name;
+    std::string type;
+    // false for loop counters
+    bool assignable;
+  };
+
+  struct Function {
+    std::string return_type;
+    std::vector<std::string> param_types;
+  };
+
+  Shape shape;
+  std::mt19937 rng;
+
+  // the program so far
+  std::string out;
+  // field types of each struct
+  std::vector<std::vector<std::string>> struct_fields;
+  std::vector<Function> functions;
+  // indexes of the functions returning each type (in order)
+  std::map<std::string, std::vector<size_t>> returning;
+  // the function being generated (only earlier ones may be called)
+  size_t curr_function = 0;
+  // variables in scope (innermost last)
+  std::vector<Var> vars;
+  size_t next_var = 0;
+
+  // random helpers
+  size_t pick(size_t n);
+  bool chance(double p);
+  std::string primitive_type();
+  std::string value_type();
+
+  // add an indented line to the program
+  void line(size_t indent, const std::string& text);
+
+  void struct_def(size_t index);
+  void fun_def(size_t index);
+  void main_def();
+
+  // statements
+  void block(size_t indent, size_t depth);
+  void stmt(size_t indent, size_t depth);
+  void decl(size_t indent, const std::string& type);
+  void init_struct(size_t indent, const std::string& name,
+                   const std::string& type);
+
+  // expressions
+  std::string expr(const std::string& type, size_t depth);
+  std::string operand(const std::string& type);
+  std::string literal(const std::string& type);
+  std::string variable(const std::string& type);
+  std::string call(const std::string& type, size_t depth);
+  std::string call_to(size_t index, const std::string& first, size_t depth);
+
+};
+
+
+#endif
@@ -0,0 +1,187 @@
+//----------------------------------------------------------------------
+// FILE: sampler.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Sampler implementation
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <string>
+#include <unistd.h>
+#include "sampler.h"
+#include "mypl_exception.h"
+
+// older glibc headers leave out the field naming the thread to signal
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+using namespace std;
+
+
+namespace {
+
+  // the running sampler (if any) for the signal handler
+  atomic<Sampler*> active = nullptr;
+
+  void on_signal(int)
+  {
+    int saved = errno;
+    Sampler* sampler = active.load();
+    if (sampler)
+      sampler->sample();
+    errno = saved;
+  }
+
+}
+
+
+Sampler::Sampler(unsigned rate)
+  : rate(max(1u, rate))
+{
+}
+
+
+Sampler::~Sampler()
+{
+  stop();
+}
+
+
+void Sampler::start()
+{
+  Sampler* none = nullptr;
+  if (!active.compare_exchange_strong(none, this))
+    throw MyPLException::VMError("a sampler is already running");
+
+  // the handler stays installed once sampling stops, since a signal
+  // may still be pending (and would otherwise end the process)
+  static bool installed = false;
+  if (!installed) {
+    struct sigaction action = {};
+    action.sa_handler = on_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, nullptr);
+    installed = true;
+  }
+
+  // signal this thread each time it has used another 1/rate seconds
+  // of cpu time
+  struct sigevent event = {};
+  event.sigev_notify = SIGEV_THREAD_ID;
+  event.sigev_signo = SIGPROF;
+  event.sigev_notify_thread_id = gettid();
+  if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &timer) != 0) {
+    active = nullptr;
+    throw MyPLException::VMError("unable to create the sampling timer");
+  }
+  long interval = 1000000000L / rate;
+  struct itimerspec spec = {};
+  spec.it_interval.tv_sec = interval / 1000000000L;
+  spec.it_interval.tv_nsec = interval % 1000000000L;
+  spec.it_value = spec.it_interval;
+
+  running = true;
+  drainer = thread([this]() {
+    while (running) {
+      drain();
+      this_thread::sleep_for(chrono::milliseconds(20));
+    }
+  });
+  timer_settime(timer, 0, &spec, nullptr);
+}
+
+
+void Sampler::stop()
+{
+  if (!running)
+    return;
+  timer_delete(timer);
+  running = false;
+  drainer.join();
+  active = nullptr;
+  stack_depth = 0;
+  drain();
+}
+
+
+void Sampler::sample()
+{
+  size_t d = stack_depth.load(memory_order_relaxed);
+  atomic_signal_fence(memory_order_acquire);
+  if (d == 0)
+    return;
+  size_t h = head.load(memory_order_relaxed);
+  if (h - tail.load(memory_order_acquire) >= RING_SIZE) {
+    lost.fetch_add(1, memory_order_relaxed);
+    return;
+  }
+  // keep the innermost of the frames on the stack
+  Sample& s = ring[h % RING_SIZE];
+  size_t stored = min(d, STACK_DEPTH);
+  size_t n = min(stored, SAMPLE_DEPTH);
+  for (size_t i = 0; i < n; ++i) {
+    const Entry& e = stack[stored - n + i];
+    s.frames[i] = {e.info, *e.pc};
+  }
+  s.depth = d;
+  head.store(h + 1, memory_order_release);
+}
+
+
+void Sampler::drain()
+{
+  size_t t = tail.load(memory_order_relaxed);
+  size_t h = head.load(memory_order_acquire);
+  for (; t != h; ++t) {
+    const Sample& s = ring[t % RING_SIZE];
+    size_t n = min({s.depth, STACK_DEPTH, SAMPLE_DEPTH});
+    vector<Frame> frames;
+    // case: a null frame marks the frames left out
+    if (n < s.depth)
+      frames.push_back({nullptr, 0});
+    frames.insert(frames.end(), s.frames.begin(), s.frames.begin() + n);
+    ++counts[frames];
+    ++samples;
+    tail.store(t + 1, memory_order_release);
+  }
+}
+
+
+uint64_t Sampler::sample_count() const
+{
+  return samples;
+}
+
+
+uint64_t Sampler::dropped() const
+{
+  return lost;
+}
+
+
+void Sampler::write_folded(ostream& out, bool lines)
+{
+  drain();
+  // stacks only differing in their pcs (or lines) fold into one line
+  map<string, uint64_t> folded;
+  for (const auto& [frames, count] : counts) {
+    string line = "";
+    for (const Frame& f : frames) {
+      if (line != "")
+        line += ";";
+      line += f.info ? f.info->function_name : "[truncated]";
+      // (each pc is that of the instruction after the running one)
+      int source_line = f.info ? f.info->line(f.pc - 1) : 0;
+      if (lines and source_line > 0)
+        line += ":" + to_string(source_line);
+    }
+    folded[line] += count;
+  }
+  for (const auto& [line, count] : folded)
+    out << line << " " << count << endl;
+}
@@ -0,0 +1,162 @@
+//----------------------------------------------------------------------
+// FILE: sampler.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Sampling profiler of a vm run. A cpu timer signal copies the
+// vm's call stack into a lock-free ring buffer, which a background
+// thread drains into counts of each distinct stack, written as folded
+// stacks (the input of flamegraph tools).
+//----------------------------------------------------------------------
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <ostream>
+#include <thread>
+#include <vector>
+#include "vm_frame.h"
+
+
+class Sampler
+{
+public:
+
+  // a sampler taking the given number of samples per second of cpu
+  // time
+  Sampler(unsigned rate = 99);
+
+  // stops sampling
+  ~Sampler();
+
+  Sampler(const Sampler&) = delete;
+  Sampler& operator=(const Sampler&) = delete;
+
+  // start sampling the calling thread (the one running the vm); only
+  // one sampler can run at a time
+  void start();
+
+  // stop sampling, keeping the samples taken so far
+  void stop();
+
+  // the vm calls these as it runs (see VM::set_sampler): a function
+  // (whose frame template is info and program counter is pc) starts,
+  // and the current function returns
+  void push(const VMFrameInfo* info, const int* pc);
+  void pop();
+
+  // the number of functions on the call stack, and return from those
+  // above the given number (when an error unwinds the vm, before their
+  // frames are freed)
+  size_t depth() const;
+  void unwind(size_t depth);
+
+  // record the current call stack (what the timer signal does)
+  void sample();
+
+  // the samples recorded, and those lost to a full ring buffer (once
+  // stopped)
+  uint64_t sample_count() const;
+  uint64_t dropped() const;
+
+  // write a "main;f;g count" line for each distinct call stack sampled,
+  // or with lines a "main:9;f:4;g:12 count" line for each distinct
+  // stack of source lines (once stopped, while the vm and so its frame
+  // templates still exist)
+  void write_folded(std::ostream& out, bool lines = false);
+
+private:
+
+  // a function on the call stack
+  struct Entry {
+    const VMFrameInfo* info = nullptr;
+    const int* pc = nullptr;
+  };
+
+  // a function on a sampled call stack
+  struct Frame {
+    const VMFrameInfo* info;
+    int pc;
+    auto operator<=>(const Frame&) const = default;
+  };
+
+  // frames kept of each sample (the innermost ones) and of the call
+  // stack (the outermost ones)
+  static constexpr size_t SAMPLE_DEPTH = 128;
+  static constexpr size_t STACK_DEPTH = 16384;
+  // samples the ring buffer holds
+  static constexpr size_t RING_SIZE = 256;
+
+  struct Sample {
+    // frames (outermost first) and the depth of the call stack
+    std::array<Frame, SAMPLE_DEPTH> frames;
+    size_t depth;
+  };
+
+  unsigned rate;
+
+  // the vm's call stack (only written by the vm's thread, and read by
+  // the signal handler interrupting that thread)
+  std::vector<Entry> stack = std::vector<Entry>(STACK_DEPTH);
+  std::atomic<size_t> stack_depth = 0;
+
+  // single producer (the signal handler) single consumer (the drain
+  // thread) ring buffer of samples
+  std::vector<Sample> ring = std::vector<Sample>(RING_SIZE);
+  std::atomic<size_t> head = 0;
+  std::atomic<size_t> tail = 0;
+  std::atomic<uint64_t> lost = 0;
+
+  // counts of each distinct call stack (only used by the drain thread
+  // while sampling)
+  std::map<std::vector<Frame>, uint64_t> counts;
+  uint64_t samples = 0;
+
+  // the drain thread and timer (while sampling)
+  std::thread drainer;
+  std::atomic<bool> running = false;
+  timer_t timer;
+
+  // move the samples in the ring buffer into the counts
+  void drain();
+
+};
+
+
+inline void Sampler::push(const VMFrameInfo* info, const int* pc)
+{
+  size_t d = stack_depth.load(std::memory_order_relaxed);
+  if (d < STACK_DEPTH)
+    stack[d] = {info, pc};
+  // the entry must be written before the signal handler can see it
+  std::atomic_signal_fence(std::memory_order_release);
+  stack_depth.store(d + 1, std::memory_order_relaxed);
+}
+
+
+inline void Sampler::pop()
+{
+  stack_depth.store(stack_depth.load(std::memory_order_relaxed) - 1,
+                    std::memory_order_relaxed);
+}
+
+
+inline size_t Sampler::depth() const
+{
+  return stack_depth.load(std::memory_order_relaxed);
+}
+
+
+inline void Sampler::unwind(size_t depth)
+{
+  if (depth < stack_depth.load(std::memory_order_relaxed))
+    stack_depth.store(depth, std::memory_order_relaxed);
+}
+
+
+#endif
@@ -5,7 +5,6 @@
 // DESC: 
 //----------------------------------------------------------------------
 
-#include <unordered_set>
 #include "mypl_exception.h"
 #include "semantic_checker.h"
 #include <iostream>
@@ -13,19 +12,31 @@
 
 using namespace std;
 
-// hash table of names of the base data types and built-in functions
-const unordered_set<string> BASE_TYPES {"int", "double", "char", "string", "bool"};
-const unordered_set<string> BUILT_INS {"print", "input", "to_string",  "to_int",
-  "to_double", "length", "get", "concat"};
+// the base data types and built-in functions have consecutive symbols
+static bool is_base_type(Symbol type)
+{
+  return type >= Symbols::INT && type <= Symbols::BOOL;
+}
+
+static bool is_built_in(Symbol name)
+{
+  return name >= Symbols::PRINT && name <= Symbols::CONCAT;
+}
+
+
+SemanticChecker::SemanticChecker(ThreadPool* pool)
+  : pool(pool)
+{
+}
 
 
 // helper functions
 
 optional<VarDef> SemanticChecker::get_field(const StructDef& struct_def,
-                                            const string& field_name)
+                                            Symbol field_name)
 {
   for (const VarDef& var_def : struct_def.fields)
-    if (var_def.var_name.lexeme() == field_name)
+    if (var_def.var_name.symbol() == field_name)
       return var_def;
   return nullopt;
 }
@@ -49,57 +60,91 @@ void SemanticChecker::error(const string& msg)
 // visitor functions
 
 
-void SemanticChecker::visit(Program& p)
+void SemanticChecker::set_require_main(bool require)
+{
+  require_main = require;
+}
+
+
+void SemanticChecker::declare(Program& p)
 {
+  symbols = p.symbols.get();
   // record each struct def
   for (StructDef& d : p.struct_defs) {
-    string name = d.struct_name.lexeme();
+    Symbol name = d.struct_name.symbol();
     if (struct_defs.contains(name))
-      error("multiple definitions of '" + name + "'", d.struct_name);
-    struct_defs[name] = d;
+      error("multiple definitions of '" + string(d.struct_name.lexeme()) + "'",
+            d.struct_name);
+    struct_defs[name] = &d;
   }
   // record each function def (need a main function)
   bool found_main = false;
   for (FunDef& f : p.fun_defs) {
-    string name = f.fun_name.lexeme();
-    if (BUILT_INS.contains(name))
-      error("redefining built-in function '" + name + "'", f.fun_name);
+    Symbol name = f.fun_name.symbol();
+    if (is_built_in(name))
+      error("redefining built-in function '" + string(f.fun_name.lexeme()) + "'",
+            f.fun_name);
     if (fun_defs.contains(name))
-      error("multiple definitions of '" + name + "'", f.fun_name);
-    if (name == "main") {
-      if (f.return_type.type_name != "void")
+      error("multiple definitions of '" + string(f.fun_name.lexeme()) + "'",
+            f.fun_name);
+    if (name == Symbols::MAIN) {
+      if (f.return_type.type_id != Symbols::VOID)
         error("main function must have void type", f.fun_name);
       if (f.params.size() != 0)
         error("main function cannot have parameters", f.params[0].var_name);
       found_main = true;
     }
-    fun_defs[name] = f;
+    fun_defs[name] = &f;
   }
-  if (!found_main)
+  if (!found_main and require_main)
     error("program missing main function");
   // check each struct
   for (StructDef& d : p.struct_defs)
     d.accept(*this);
+}
+
+
+void SemanticChecker::visit(Program& p)
+{
+  declare(p);
   // check each function
-  for (FunDef& d : p.fun_defs)
-    d.accept(*this);
+  if (pool == nullptr or pool->size() == 1) {
+    for (FunDef& d : p.fun_defs)
+      d.accept(*this);
+    return;
+  }
+  // bodies only read the signatures, so each worker checks with its
+  // own copy of the checker, and the error reported is the one from the
+  // first function in program order (as when checking serially)
+  vector<SemanticChecker> workers(pool->size(), *this);
+  vector<exception_ptr> errors(p.fun_defs.size());
+  pool->run(p.fun_defs.size(), [&](size_t worker, size_t i) {
+    try {
+      p.fun_defs[i].accept(workers[worker]);
+    } catch (MyPLException& ex) {
+      errors[i] = current_exception();
+    }
+  });
+  for (exception_ptr& error : errors)
+    if (error)
+      rethrow_exception(error);
 }
 
 
 void SemanticChecker::visit(SimpleRValue& v)
 {
   if (v.value.type() == TokenType::INT_VAL)
-    curr_type = DataType {false, "int"};
+    curr_type = DataType {false, Symbols::INT};
   else if (v.value.type() == TokenType::DOUBLE_VAL)
-    curr_type = DataType {false, "double"};    
+    curr_type = DataType {false, Symbols::DOUBLE};    
   else if (v.value.type() == TokenType::CHAR_VAL)
-    curr_type = DataType {false, "char"};    
+    curr_type = DataType {false, Symbols::CHAR};    
   else if (v.value.type() == TokenType::STRING_VAL)
-    curr_type = DataType {false, "string"};    
+    curr_type = DataType {false, Symbols::STRING};    
   else if (v.value.type() == TokenType::BOOL_VAL)
-    curr_type = DataType {false, "bool"};    
+    curr_type = DataType {false, Symbols::BOOL};    
   else if (v.value.type() == TokenType::NULL_VAL)
-    curr_type = DataType {false, "void"};    
+    curr_type = DataType {false, Symbols::VOID};    
 }
  
 
@@ -110,31 +155,31 @@ void SemanticChecker::visit(FunDef& f)
   symbol_table.push_environment();
   DataType ret_type = f.return_type;
 
-  if(BASE_TYPES.contains(ret_type.type_name) || ret_type.type_name == "void") {
-    symbol_table.add("return", ret_type);
+  if(is_base_type(ret_type.type_id) || ret_type.type_id == Symbols::VOID) {
+    symbol_table.add(Symbols::RETURN, ret_type);
   }
-  else if(struct_defs.count(ret_type.type_name) == 0) {
+  else if(struct_defs.count(ret_type.type_id) == 0) {
     error("undefined return type");
   }
   
-  symbol_table.add("return", ret_type);
+  symbol_table.add(Symbols::RETURN, ret_type);
 
-  for(auto p : f.params) {
-    if(symbol_table.name_exists_in_curr_env(p.var_name.lexeme())) {
+  for(auto& p : f.params) {
+    if(symbol_table.name_exists_in_curr_env(p.var_name.symbol())) {
       error("params has same name as function");
     }
 
-    string p_type = p.data_type.type_name;
-    if(!BASE_TYPES.contains(p_type)) {
-      if(struct_defs.count(p.data_type.type_name) == 0) {
+    Symbol p_type = p.data_type.type_id;
+    if(!is_base_type(p_type)) {
+      if(struct_defs.count(p.data_type.type_id) == 0) {
         error("undefined struct");
       }
     }
 
-    symbol_table.add(p.var_name.lexeme(), p.data_type);
+    symbol_table.add(p.var_name.symbol(), p.data_type);
   }
 
-  for(auto s : f.stmts) {
+  for(auto& s : f.stmts) {
       s->accept(*this);
   }
 
@@ -146,19 +191,19 @@ void SemanticChecker::visit(StructDef& s)
 {
   symbol_table.push_environment();
 
-  for(auto f : s.fields) {
-    if(symbol_table.name_exists_in_curr_env(f.var_name.lexeme())) {
+  for(auto& f : s.fields) {
+    if(symbol_table.name_exists_in_curr_env(f.var_name.symbol())) {
       error("fields has same name as struct");
     }
 
-    string f_type = f.data_type.type_name;
-    if(!BASE_TYPES.contains(f_type) && f_type != "void") {
-      if(struct_defs.count(f.data_type.type_name) == 0) {
+    Symbol f_type = f.data_type.type_id;
+    if(!is_base_type(f_type) && f_type != Symbols::VOID) {
+      if(struct_defs.count(f.data_type.type_id) == 0) {
         error("undefined struct");
       }
     }
 
-    symbol_table.add(f.var_name.lexeme(), f.data_type);
+    symbol_table.add(f.var_name.symbol(), f.data_type);
   }
 
   symbol_table.pop_environment();
@@ -168,8 +213,8 @@ void SemanticChecker::visit(StructDef& s)
 void SemanticChecker::visit(ReturnStmt& s)
 {
   s.expr.accept(*this);
-  if(symbol_table.get("return")->type_name != curr_type.type_name 
-    && curr_type.type_name != "void") {
+  if(symbol_table.get(Symbols::RETURN)->type_id != curr_type.type_id 
+    && curr_type.type_id != Symbols::VOID) {
     error("invalid return type");
   }
 }
@@ -180,11 +225,11 @@ void SemanticChecker::visit(WhileStmt& s)
   symbol_table.push_environment();
   s.condition.accept(*this);
   
-  if(curr_type.type_name != "bool") {
+  if(curr_type.type_id != Symbols::BOOL) {
     error("condition is not type bool");
   }
 
-  for(auto st : s.stmts) {
+  for(auto& st : s.stmts) {
     st->accept(*this);
   }
 
@@ -198,12 +243,12 @@ void SemanticChecker::visit(ForStmt& s)
   s.var_decl.accept(*this);
   s.condition.accept(*this);
 
-  if((curr_type.type_name != "bool") || (curr_type.is_array)) {
+  if((curr_type.type_id != Symbols::BOOL) || (curr_type.is_array)) {
     error("assignment is not type int");
   }
 
   s.assign_stmt.accept(*this);
-  for(auto s : s.stmts) {
+  for(auto& s : s.stmts) {
     s->accept(*this);
   }
 
@@ -216,20 +261,20 @@ void SemanticChecker::visit(IfStmt& s)
   symbol_table.push_environment();
   s.if_part.condition.accept(*this);
 
-  if(curr_type.type_name != "bool" || curr_type.is_array) {
+  if(curr_type.type_id != Symbols::BOOL || curr_type.is_array) {
     error("condition is not type bool");
   }
 
-  for(auto st : s.if_part.stmts) {
+  for(auto& st : s.if_part.stmts) {
     st->accept(*this);
   }
 
   if(s.else_ifs.size() > 0) {
-    for(auto b : s.else_ifs) {
+    for(auto& b : s.else_ifs) {
       symbol_table.push_environment();
       b.condition.accept(*this);
 
-      if(curr_type.type_name != "bool") {
+      if(curr_type.type_id != Symbols::BOOL) {
         error("condition is not type bool");
       }
       
@@ -239,7 +284,7 @@ void SemanticChecker::visit(IfStmt& s)
 
   symbol_table.push_environment();
   if(s.else_stmts.size() > 0) {
-    for(auto st : s.else_stmts) {
+    for(auto& st : s.else_stmts) {
       st->accept(*this);
     }
   }
@@ -251,16 +296,16 @@ void SemanticChecker::visit(IfStmt& s)
 
 void SemanticChecker::visit(VarDeclStmt& s)
 {
-  string v = s.var_def.var_name.lexeme();
+  Symbol v = s.var_def.var_name.symbol();
   if(symbol_table.name_exists_in_curr_env(v)) {
     error("var is already declared");
   }
 
-  symbol_table.add(s.var_def.var_name.lexeme(), s.var_def.data_type);
+  symbol_table.add(s.var_def.var_name.symbol(), s.var_def.data_type);
   s.expr.accept(*this);
 
-  if(curr_type.type_name != s.var_def.data_type.type_name) {
-    if(curr_type.type_name != "void") {
+  if(curr_type.type_id != s.var_def.data_type.type_id) {
+    if(curr_type.type_id != Symbols::VOID) {
       error("type mismatch");
     }
   }
@@ -273,26 +318,26 @@ void SemanticChecker::visit(AssignStmt& s)
   DataType rhs = curr_type;
 
   if(s.lvalue.size() < 2) {
-    DataType lval = *symbol_table.get(s.lvalue[0].var_name.lexeme());
+    DataType lval = *symbol_table.get(s.lvalue[0].var_name.symbol());
 
-    if(curr_type.type_name != lval.type_name) {
+    if(curr_type.type_id != lval.type_id) {
       error("mismatched type");
     }
   }
 
-  string var_name = s.lvalue[0].var_name.lexeme();
+  Symbol var_name = s.lvalue[0].var_name.symbol();
   if(symbol_table.name_exists(var_name)) {
-    curr_type = DataType{symbol_table.get(var_name)->is_array, symbol_table.get(var_name).value().type_name};
+    curr_type = DataType{symbol_table.get(var_name)->is_array, symbol_table.get(var_name).value().type_id};
     
-    if(struct_defs.contains(curr_type.type_name)) {
+    if(struct_defs.contains(curr_type.type_id)) {
       for(int i = 1; i < s.lvalue.size(); i++) {
-        var_name = s.lvalue[i].var_name.lexeme();
-        VarDef field = get_field(struct_defs[curr_type.type_name], var_name).value();
-        curr_type = {field.data_type.is_array, field.data_type.type_name};
+        var_name = s.lvalue[i].var_name.symbol();
+        VarDef field = get_field(*struct_defs[curr_type.type_id], var_name).value();
+        curr_type = {field.data_type.is_array, field.data_type.type_id};
       }
     } 
 
-    if(curr_type.type_name != rhs.type_name) {
+    if(curr_type.type_id != rhs.type_id) {
       error("mismatched type");
     }
   }
@@ -305,104 +350,104 @@ void SemanticChecker::visit(AssignStmt& s)
 
 void SemanticChecker::visit(CallExpr& e)
 {
-  string name = e.fun_name.lexeme();
+  Symbol name = e.fun_name.symbol();
 
-  if(name == "print") {
+  if(name == Symbols::PRINT) {
     if(e.args.size() != 1) {
       error("too many args");
     }
     e.args.at(0).accept(*this);
 
-    if((!BASE_TYPES.contains(curr_type.type_name)) || (curr_type.is_array)){
-      error("Cannot print object of type "+ curr_type.type_name);
+    if((!is_base_type(curr_type.type_id)) || (curr_type.is_array)){
+      error("Cannot print object of type " + string(curr_type.type_name(*symbols)));
     }
-    curr_type = DataType {false, "void"};
+    curr_type = DataType {false, Symbols::VOID};
   }
 
-  else if(name == "input") {
+  else if(name == Symbols::INPUT) {
     if(e.args.size() != 0) {
       error("too many args");
     }
-    curr_type = DataType{false, "string"};
+    curr_type = DataType {false, Symbols::STRING};
   }
 
-  else if(name == "to_string") {
+  else if(name == Symbols::TO_STRING) {
     if(e.args.size() != 1) {
       error("too many args");
     }
     
+    e.args.at(0).accept(*this);
     if(curr_type.is_array) {
       error("cannot convert array to string");
     }
-    e.args.at(0).accept(*this);
     
-    if(curr_type.type_name == "string" || (curr_type.type_name == "void") || (curr_type.type_name == "bool")) {
+    if(curr_type.type_id == Symbols::STRING || (curr_type.type_id == Symbols::VOID) || (curr_type.type_id == Symbols::BOOL)) {
       error("cannot convert type to string type");
     }
-    curr_type = DataType{false, "string"};
+    curr_type = DataType {false, Symbols::STRING};
   }
 
-  else if(name == "to_int") {
+  else if(name == Symbols::TO_INT) {
     if(e.args.size() != 1) {
       error("too many args");
     }
     
+    e.args.at(0).accept(*this);
     if(curr_type.is_array) {
       error("cannot convert array to int");
     }
-    e.args.at(0).accept(*this);
 
-    if(curr_type.type_name == "int" || (curr_type.type_name == "void") || 
-    (curr_type.type_name == "bool") || (curr_type.type_name == "char")) {
+    if(curr_type.type_id == Symbols::INT || (curr_type.type_id == Symbols::VOID) || 
+    (curr_type.type_id == Symbols::BOOL) || (curr_type.type_id == Symbols::CHAR)) {
       error("cannot convert type to int");
     }
-    curr_type = DataType{false, "int"};
+    curr_type = DataType {false, Symbols::INT};
   }
 
-  else if(name == "to_double") {
+  else if(name == Symbols::TO_DOUBLE) {
     if(e.args.size() != 1) {
       error("too many args");
     }
 
+    e.args.at(0).accept(*this);
     if(curr_type.is_array) {
       error("cannot convert array to double");
     }
-    e.args.at(0).accept(*this);
 
-    if(curr_type.type_name == "double" || (curr_type.type_name == "void") || 
-    (curr_type.type_name == "bool") || (curr_type.type_name == "char")) {
+    if(curr_type.type_id == Symbols::DOUBLE || (curr_type.type_id == Symbols::VOID) || 
+    (curr_type.type_id == Symbols::BOOL) || (curr_type.type_id == Symbols::CHAR)) {
       error("cannot convert type to double");
     }
-    curr_type = DataType{false, "double"};
+    curr_type = DataType {false, Symbols::DOUBLE};
   }
 
-  else if(name == "length") {
+  else if(name == Symbols::LENGTH) {
     if(e.args.size() != 1) {
       error("too many args");
     }
     e.args.at(0).accept(*this);
 
-    if(curr_type.type_name != "string") {
+    if(curr_type.type_id != Symbols::STRING) {
       if(curr_type.is_array == false) {
         error("invalid parameter", e.first_token());
       }
     }
-    curr_type = DataType{false, "int"};
+    curr_type = DataType {false, Symbols::INT};
   }
 
-  else if(name == "get") {
+  else if(name == Symbols::GET) {
     if(e.args.size() != 2) {
       error("incorrect nnumber of args");
     }
     e.args.at(0).accept(*this);
 
-    if(curr_type.type_name != "int") {
+    if(curr_type.type_id != Symbols::INT) {
       error("arg type mst be int");
     }
     else {
       e.args.at(1).accept(*this);
-      if((curr_type.type_name == "string") || (curr_type.type_name == "char")) {
-        curr_type = DataType{false, "char"};
+      if((curr_type.type_id == Symbols::STRING) || (curr_type.type_id == Symbols::CHAR)) {
+        curr_type = DataType {false, Symbols::CHAR};
       }
       else {
         error("incorrect type in get");
@@ -410,29 +455,29 @@ void SemanticChecker::visit(CallExpr& e)
     }
   }
 
-  else if(name == "concat") {
+  else if(name == Symbols::CONCAT) {
     if(e.args.size() != 2) {
       error("incorrect number of args");
     }
     e.args.at(0).accept(*this);
 
-    if(curr_type.type_name != "string") {
+    if(curr_type.type_id != Symbols::STRING) {
       error("incorrect type");
     }
     else {
       e.args.at(1).accept(*this);
-      if((curr_type.type_name != "string")) {
+      if((curr_type.type_id != Symbols::STRING)) {
         error("incorrect type");
       }
       else {
-        curr_type = DataType{false, "string"};
+        curr_type = DataType {false, Symbols::STRING};
       }
     }
   }
 
   else {
     if(fun_defs.contains(name)) {
-      FunDef f = fun_defs[name];
+      FunDef& f = *fun_defs[name];
 
       if(e.args.size() != f.params.size()) {
         error("wrong number of params");
@@ -442,13 +487,13 @@ void SemanticChecker::visit(CallExpr& e)
         DataType params = f.params[i].data_type;
         e.args[i].accept(*this);
 
-        if(curr_type.type_name != params.type_name || curr_type.is_array != params.is_array) {
-          if(curr_type.type_name != "void") {
+        if(curr_type.type_id != params.type_id || curr_type.is_array != params.is_array) {
+          if(curr_type.type_id != Symbols::VOID) {
             error("mismatched type");
           }
         }
       }
-      curr_type = DataType{f.return_type.is_array, f.return_type.type_name};
+      curr_type = DataType{f.return_type.is_array, f.return_type.type_id};
     }
     else {
       error("function used before defined");
@@ -465,39 +510,39 @@ void SemanticChecker::visit(Expr& e)
   if(e.op.has_value()) {
     e.rest->accept(*this);
     
-    if((curr_type.type_name == "void") && (BASE_TYPES.contains(curr_type.type_name))) {
+    if((curr_type.type_id == Symbols::VOID) && (is_base_type(curr_type.type_id))) {
       error("can't be used in expression");
     }
 
-    string lhs = curr_type.type_name;
-    string rhs = curr_type.type_name;
+    Symbol lhs = curr_type.type_id;
+    Symbol rhs = curr_type.type_id;
 
-    if((e.op->lexeme() == "==") || (e.op->lexeme() == "!=")) {
-      if((lhs != rhs) && (lhs != "void") && (rhs != "void")) {
+    if((e.op->type() == TokenType::EQUAL) || (e.op->type() == TokenType::NOT_EQUAL)) {
+      if((lhs != rhs) && (lhs != Symbols::VOID) && (rhs != Symbols::VOID)) {
         error("lhs and rhs incompatible");
       }
-      curr_type.type_name = "bool";
+      curr_type.type_id = Symbols::BOOL;
     }
 
-    else if((e.op->lexeme() == "<") || (e.op->lexeme() == ">") || 
-            (e.op->lexeme() == "<=") || (e.op->lexeme() == ">=")) {
+    else if((e.op->type() == TokenType::LESS) || (e.op->type() == TokenType::GREATER) || 
+            (e.op->type() == TokenType::LESS_EQ) || (e.op->type() == TokenType::GREATER_EQ)) {
       if(lhs != rhs) {
         error("lhs and rhs incompatible");
       }
-      if(lhs == "bool") {
+      if(lhs == Symbols::BOOL) {
         error("lhs incompatible with operator");
       }
-      curr_type.type_name = "bool";
+      curr_type.type_id = Symbols::BOOL;
     }
 
-    else if((e.op->lexeme() == "+") || (e.op->lexeme() == "/") || (e.op->lexeme() == "-")) {
+    else if((e.op->type() == TokenType::PLUS) || (e.op->type() == TokenType::DIVIDE) || (e.op->type() == TokenType::MINUS)) {
       if(lhs != rhs) {
         error("lhs and rhs incompatible");
       }
-      if(lhs != "int" && lhs != "double") {
+      if(lhs != Symbols::INT && lhs != Symbols::DOUBLE) {
         error("lhs incompatible with operator");
       }
-      curr_type.type_name = lhs;
+      curr_type.type_id = lhs;
     }
   }
 
@@ -519,26 +564,26 @@ void SemanticChecker::visit(ComplexTerm& t)
 void SemanticChecker::visit(NewRValue& v)
 {  
   if(v.type.type() == TokenType::INT_TYPE) {
-    curr_type = DataType{true, "int"};
+    curr_type = DataType {true, Symbols::INT};
   }
   else if(v.type.type() == TokenType::DOUBLE_TYPE) {
-    curr_type = DataType{true, "double"};
+    curr_type = DataType {true, Symbols::DOUBLE};
   }
   else if(v.type.type() == TokenType::BOOL_TYPE) {
-    curr_type = DataType{true, "bool"};
+    curr_type = DataType {true, Symbols::BOOL};
   }
   else if(v.type.type() == TokenType::CHAR_TYPE) {
-    curr_type = DataType{true, "char"};
+    curr_type = DataType {true, Symbols::CHAR};
   }
   else if(v.type.type() == TokenType::STRING_TYPE) {
-    curr_type = DataType{true, "string"};
+    curr_type = DataType {true, Symbols::STRING};
   }
   else {
-    if(struct_defs.count(v.type.lexeme()) == 0) {
+    if(!struct_defs.contains(v.type.symbol())) {
       error("type undefined");
     }
     else {
-      curr_type = DataType{false, v.type.lexeme()};
+      curr_type = DataType{false, v.type.symbol()};
     }
   }
 }
@@ -546,19 +591,18 @@ void SemanticChecker::visit(NewRValue& v)
 
 void SemanticChecker::visit(VarRValue& v)
 {
-  string var_name = v.path[0].var_name.lexeme();
+  Symbol var_name = v.path[0].var_name.symbol();
   if(!symbol_table.name_exists(var_name)) {
-    to_string(symbol_table);
     error("use before def", v.path[0].var_name);
   }
 
-  curr_type = DataType{symbol_table.get(var_name)->is_array, symbol_table.get(var_name).value().type_name};
+  curr_type = DataType{symbol_table.get(var_name)->is_array, symbol_table.get(var_name).value().type_id};
 
-  if(struct_defs.contains(curr_type.type_name)) {
+  if(struct_defs.contains(curr_type.type_id)) {
     for(int i = 1; i < v.path.size(); i++) {
-      string var_name2 = v.path[i].var_name.lexeme();
-      VarDef field = get_field(struct_defs[curr_type.type_name], var_name2).value();
-      curr_type = {field.data_type.is_array, field.data_type.type_name};
+      Symbol var_name2 = v.path[i].var_name.symbol();
+      VarDef field = get_field(*struct_defs[curr_type.type_id], var_name2).value();
+      curr_type = {field.data_type.is_array, field.data_type.type_id};
     }
   }
 }    
@@ -569,22 +613,22 @@ void SemanticChecker::visit(SwitchStmt& s) {
   symbol_table.push_environment();
   s.switch_expr.accept(*this);
 
-  if(curr_type.type_name != "double" && curr_type.type_name != "int" && 
-  curr_type.type_name != "bool" && curr_type.type_name != "char" && curr_type.type_name != "string") {
+  if(curr_type.type_id != Symbols::DOUBLE && curr_type.type_id != Symbols::INT && 
+  curr_type.type_id != Symbols::BOOL && curr_type.type_id != Symbols::CHAR && curr_type.type_id != Symbols::STRING) {
     error("switch value is an incorrect type");
   }
 
   if(s.cases.size() > 0) {
-    for(auto b : s.cases) {
+    for(auto& b : s.cases) {
       symbol_table.push_environment();
       b.const_expr.accept(*this);
 
-      if(curr_type.type_name != "double" && curr_type.type_name != "int" && 
-      curr_type.type_name != "bool" && curr_type.type_name != "char" && curr_type.type_name != "string") {
+      if(curr_type.type_id != Symbols::DOUBLE && curr_type.type_id != Symbols::INT && 
+      curr_type.type_id != Symbols::BOOL && curr_type.type_id != Symbols::CHAR && curr_type.type_id != Symbols::STRING) {
         error("case value is an incorrect type");
       }
 
-      for(auto st : b.stmts) {
+      for(auto& st : b.stmts) {
         st->accept(*this);
       }
       
@@ -594,7 +638,7 @@ void SemanticChecker::visit(SwitchStmt& s) {
 
   symbol_table.push_environment();
   if(s.defaults.size() > 0) {
-    for(auto st : s.defaults) {
+    for(auto& st : s.defaults) {
       st->accept(*this);
     }
   }
@@ -11,12 +11,24 @@
 #include <unordered_map>
 #include "ast.h"
 #include "symbol_table.h"
+#include "thread_pool.h"
 
 
 class SemanticChecker : public Visitor
 {
 public:
 
+  // checks function bodies in parallel on the pool if given
+  SemanticChecker(ThreadPool* pool = nullptr);
+
+  // check the program's structs and function signatures, leaving the
+  // function bodies to be checked individually (visit(Program) does both)
+  void declare(Program& p);
+
+  // true (the default) if the program must define main (modules of
+  // functions called by a host need not)
+  void set_require_main(bool require);
+
   // visitor functions
   void visit(Program& p);
   void visit(FunDef& f);
@@ -40,21 +52,29 @@ public:
 
 private:
 
+  // workers for checking function bodies (or nullptr to check serially)
+  ThreadPool* pool;
+
+  bool require_main = true;
+
   // symbol table
   SymbolTable symbol_table;
 
+  // the program's symbols (for type names in errors)
+  const Interner* symbols = nullptr;
+
   // current inferred type
   DataType curr_type;
 
   // mapping from struct names to corresponding ast objects
-  std::unordered_map<std::string, StructDef> struct_defs;
+  std::unordered_map<Symbol, StructDef*> struct_defs;
 
   // mapping from function names to corresponding ast objects
-  std::unordered_map<std::string, FunDef> fun_defs;
+  std::unordered_map<Symbol, FunDef*> fun_defs;
 
   // helper function to get field in struct def
   std::optional<VarDef> get_field(const StructDef& struct_def,
-                                  const std::string& field_name);
+                                  Symbol field_name);
 
   // error helper functions
   void error(const std::string& msg, const Token& token);
@@ -0,0 +1,346 @@
+//----------------------------------------------------------------------
+// FILE: server.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Server implementation
+//----------------------------------------------------------------------
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.h"
+#include "bytecode.h"
+#include "compile_cache.h"
+#include "mypl_exception.h"
+#include "vm.h"
+
+using namespace std;
+
+
+namespace {
+
+  // each message is its type, the length of its payload (4 bytes, in
+  // host order since both ends share the host), and the payload. A
+  // client sends a path or source, the input, and END; the server
+  // sends output and errors as they come, then the exit status.
+  const char PATH = 'P';
+  const char SOURCE = 'S';
+  const char INPUT = 'I';
+  const char END = 'E';
+  const char OUT = 'O';
+  const char ERR = 'R';
+  const char EXIT = 'X';
+
+  // the longest payload accepted
+  const uint32_t MAX_PAYLOAD = 1u << 30;
+
+  bool send_all(int fd, const char* data, size_t size)
+  {
+    while (size > 0) {
+      // (a client that hung up is an error, not a SIGPIPE)
+      ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+      if (sent < 0 and errno == EINTR)
+        continue;
+      if (sent <= 0)
+        return false;
+      data += sent;
+      size -= sent;
+    }
+    return true;
+  }
+
+  bool receive_all(int fd, char* data, size_t size)
+  {
+    while (size > 0) {
+      ssize_t received = ::recv(fd, data, size, 0);
+      if (received < 0 and errno == EINTR)
+        continue;
+      if (received <= 0)
+        return false;
+      data += received;
+      size -= received;
+    }
+    return true;
+  }
+
+  bool send_message(int fd, char type, string_view payload)
+  {
+    char header[5];
+    header[0] = type;
+    uint32_t size = payload.size();
+    memcpy(header + 1, &size, 4);
+    return send_all(fd, header, 5) and
+      send_all(fd, payload.data(), payload.size());
+  }
+
+  bool receive_message(int fd, char& type, string& payload)
+  {
+    char header[5];
+    if (!receive_all(fd, header, 5))
+      return false;
+    type = header[0];
+    uint32_t size;
+    memcpy(&size, header + 1, 4);
+    if (size > MAX_PAYLOAD)
+      return false;
+    payload.resize(size);
+    return receive_all(fd, payload.data(), size);
+  }
+
+  // a stream buffer sending what is written as output messages
+  class OutputBuffer : public streambuf
+  {
+  public:
+    OutputBuffer(int fd) : fd(fd)
+    {
+      setp(buffer, buffer + sizeof(buffer));
+    }
+  protected:
+    int overflow(int c) override
+    {
+      if (sync() != 0)
+        return traits_type::eof();
+      if (c != traits_type::eof()) {
+        *pptr() = c;
+        pbump(1);
+      }
+      return traits_type::not_eof(c);
+    }
+    int sync() override
+    {
+      size_t size = pptr() - pbase();
+      setp(buffer, buffer + sizeof(buffer));
+      if (size == 0)
+        return 0;
+      return send_message(fd, OUT, string_view(buffer, size)) ? 0 : -1;
+    }
+  private:
+    int fd;
+    char buffer[4096];
+  };
+
+  // the unix socket address of the path
+  sockaddr_un address(const string& path)
+  {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+      throw MyPLException::VMError("socket path too long '" + path + "'");
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    return addr;
+  }
+
+  // a socket connected to the path (-1 if nothing is listening)
+  int connect_to(const string& path)
+  {
+    sockaddr_un addr = address(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+      return -1;
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+}
+
+
+Server::Server(const string& socket_path, size_t workers)
+  : path(socket_path), worker_count(workers)
+{
+  if (worker_count == 0)
+    worker_count = max(1u, thread::hardware_concurrency());
+  sockaddr_un addr = address(path);
+  // case: a socket left by a server that is gone
+  struct stat info;
+  if (lstat(path.c_str(), &info) == 0 and S_ISSOCK(info.st_mode)) {
+    int fd = connect_to(path);
+    if (fd >= 0) {
+      close(fd);
+      throw MyPLException::VMError("a server is already listening on '" +
+                                   path + "'");
+    }
+    unlink(path.c_str());
+  }
+  listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0 or bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) != 0
+      or listen(listen_fd, SOMAXCONN) != 0) {
+    string reason = strerror(errno);
+    if (listen_fd >= 0)
+      close(listen_fd);
+    throw MyPLException::VMError("unable to listen on '" + path + "' (" +
+                                 reason + ")");
+  }
+}
+
+
+Server::~Server()
+{
+  close(listen_fd);
+  unlink(path.c_str());
+}
+
+
+void Server::serve()
+{
+  // (the calling thread is one of the workers)
+  vector<thread> threads;
+  for (size_t i = 1; i < worker_count; ++i)
+    threads.emplace_back(&Server::work, this);
+  work();
+  for (thread& t : threads)
+    t.join();
+}
+
+
+void Server::stop()
+{
+  // (only async-signal-safe calls, so a signal handler can stop it)
+  stopping = true;
+  shutdown(listen_fd, SHUT_RDWR);
+}
+
+
+size_t Server::job_count() const
+{
+  return jobs;
+}
+
+
+size_t Server::compile_count() const
+{
+  return compiles;
+}
+
+
+void Server::work()
+{
+  while (!stopping) {
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR or errno == ECONNABORTED)
+        continue;
+      break;
+    }
+    handle(fd);
+    close(fd);
+  }
+}
+
+
+shared_ptr<const Module> Server::module(const string& source)
+{
+  string key = CompileCache::key(source);
+  {
+    lock_guard<mutex> lock(modules_mutex);
+    auto entry = modules.find(key);
+    if (entry != modules.end())
+      return entry->second;
+  }
+  // (compiled unlocked, so other jobs aren't held up)
+  shared_ptr<const Module> compiled = Module::compile(source);
+  ++compiles;
+  lock_guard<mutex> lock(modules_mutex);
+  if (modules.emplace(key, compiled).second) {
+    module_order.push_back(key);
+    while (module_order.size() > MAX_MODULES) {
+      modules.erase(module_order.front());
+      module_order.pop_front();
+    }
+  }
+  return compiled;
+}
+
+
+void Server::handle(int fd)
+{
+  Job job;
+  char type;
+  string payload;
+  do {
+    if (!receive_message(fd, type, payload))
+      return;
+    if (type == PATH)
+      job.path = payload;
+    else if (type == SOURCE)
+      job.source = payload;
+    else if (type == INPUT)
+      job.input = payload;
+  } while (type != END);
+
+  OutputBuffer buffer(fd);
+  ostream out(&buffer);
+  int status = 0;
+  try {
+    shared_ptr<const Module> code = nullptr;
+    if (job.path != "" and Bytecode::is_bytecode(job.path))
+      code = Module::load(job.path);
+    else {
+      if (job.path != "") {
+        ifstream file(job.path);
+        if (!file)
+          throw MyPLException::VMError("unable to open '" + job.path + "'");
+        stringstream text;
+        text << file.rdbuf();
+        job.source = text.str();
+      }
+      code = module(job.source);
+    }
+    VM vm(code);
+    istringstream in(job.input);
+    vm.set_output(out);
+    vm.set_input(in);
+    vm.run();
+  } catch (exception& ex) {
+    // (including any failure of the vm itself, so the server lives on)
+    out.flush();
+    send_message(fd, ERR, string(ex.what()) + "\n");
+    status = 1;
+  }
+  out.flush();
+  ++jobs;
+  send_message(fd, EXIT, string_view((const char*)&status, sizeof(status)));
+}
+
+
+int Server::submit(const string& socket_path, const Job& job, ostream& out,
+                   ostream& err)
+{
+  int fd = connect_to(socket_path);
+  if (fd < 0)
+    throw MyPLException::VMError("no server listening on '" + socket_path +
+                                 "'");
+  bool sent = (job.path != "" ? send_message(fd, PATH, job.path) :
+               send_message(fd, SOURCE, job.source)) and
+    send_message(fd, INPUT, job.input) and send_message(fd, END, "");
+  char type;
+  string payload;
+  while (sent and receive_message(fd, type, payload)) {
+    if (type == OUT)
+      out << payload << flush;
+    else if (type == ERR)
+      err << payload << flush;
+    else if (type == EXIT and payload.size() == sizeof(int)) {
+      int status;
+      memcpy(&status, payload.data(), sizeof(status));
+      close(fd);
+      return status;
+    }
+  }
+  close(fd);
+  throw MyPLException::VMError("lost the connection to the server on '" +
+                               socket_path + "'");
+}
@@ -0,0 +1,97 @@
+//----------------------------------------------------------------------
+// FILE: server.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: A long-lived MyPL execution server on a unix domain socket.
+// Clients send jobs (a script path or source text, and the program's
+// input), which run on a pool of workers, each job in its own vm
+// isolate over a module compiled once and kept in memory. The
+// program's output is streamed back as it runs.
+//----------------------------------------------------------------------
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include "module.h"
+
+
+class Server
+{
+public:
+
+  // a job: the script file to run (or else its source text) and the
+  // text the program reads as input
+  struct Job {
+    std::string path;
+    std::string source;
+    std::string input;
+  };
+
+  // the most compiled modules kept in memory (each owns its symbols,
+  // so the names of a dropped module are freed with it)
+  static const size_t MAX_MODULES = 64;
+
+  // listen on the socket at the path (replacing a stale socket file)
+  // for jobs run on the given number of workers (0 for one per
+  // hardware thread), throws a vm error if it can't
+  Server(const std::string& socket_path, size_t workers = 0);
+
+  // closes and removes the socket
+  ~Server();
+
+  Server(const Server&) = delete;
+  Server& operator=(const Server&) = delete;
+
+  // run jobs until stopped (each worker takes the next connection and
+  // runs its job)
+  void serve();
+
+  // stop serving (once running jobs finish), from any thread
+  void stop();
+
+  // the number of jobs run, and of modules compiled, so far
+  size_t job_count() const;
+  size_t compile_count() const;
+
+  // run the job on the server at the socket path, writing the
+  // program's output and errors as they arrive, and returning its exit
+  // status (throws a vm error if the server can't be reached)
+  static int submit(const std::string& socket_path, const Job& job,
+                    std::ostream& out, std::ostream& err);
+
+private:
+
+  std::string path;
+  size_t worker_count;
+  int listen_fd = -1;
+  std::atomic<bool> stopping = false;
+  std::atomic<size_t> jobs = 0;
+  std::atomic<size_t> compiles = 0;
+
+  // compiled modules by cache key, and the keys oldest first
+  std::mutex modules_mutex;
+  std::unordered_map<std::string, std::shared_ptr<const Module>> modules;
+  std::deque<std::string> module_order;
+
+  // the module of the source text (compiled on a miss)
+  std::shared_ptr<const Module> module(const std::string& source);
+
+  // body of each worker
+  void work();
+
+  // read the job from the client, run it, and send back the results
+  void handle(int fd);
+
+};
+
+
+#endif
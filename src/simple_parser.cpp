@@ -42,7 +42,7 @@ bool SimpleParser::match(std::initializer_list<TokenType> types)
 
 void SimpleParser::error(const std::string &msg)
 {
-  std::string s = msg + " found '" + curr_token.lexeme() + "' ";
+  std::string s = msg + " found '" + std::string(curr_token.lexeme()) + "' ";
   s += "at line " + std::to_string(curr_token.line()) + ", ";
   s += "column " + std::to_string(curr_token.column());
   throw MyPLException::ParserError(s);
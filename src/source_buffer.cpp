@@ -0,0 +1,85 @@
+//----------------------------------------------------------------------
+// FILE: source_buffer.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Source buffer implementation
+//----------------------------------------------------------------------
+
+#include <iterator>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "source_buffer.h"
+
+using namespace std;
+
+
+shared_ptr<const SourceBuffer> SourceBuffer::from_stream(istream& in)
+{
+  return from_string(string(istreambuf_iterator<char>(in), {}));
+}
+
+
+shared_ptr<const SourceBuffer> SourceBuffer::from_string(string text)
+{
+  shared_ptr<SourceBuffer> buffer(new SourceBuffer());
+  buffer->owned = std::move(text);
+  buffer->start = buffer->owned.data();
+  buffer->length = buffer->owned.size();
+  return buffer;
+}
+
+
+shared_ptr<const SourceBuffer> SourceBuffer::from_file(const string& path)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) != 0 or !S_ISREG(st.st_mode)) {
+    close(fd);
+    return nullptr;
+  }
+  shared_ptr<SourceBuffer> buffer(new SourceBuffer());
+  if (st.st_size > 0) {
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      close(fd);
+      return nullptr;
+    }
+    // the lexer reads the file front to back exactly once
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+    buffer->mapping = addr;
+    buffer->mapping_size = st.st_size;
+    buffer->start = static_cast<const char*>(addr);
+    buffer->length = st.st_size;
+  }
+  close(fd);
+  return buffer;
+}
+
+
+SourceBuffer::~SourceBuffer()
+{
+  if (mapping != nullptr)
+    munmap(mapping, mapping_size);
+}
+
+
+const char* SourceBuffer::data() const
+{
+  return start;
+}
+
+
+size_t SourceBuffer::size() const
+{
+  return length;
+}
+
+
+string_view SourceBuffer::text() const
+{
+  return string_view(start, length);
+}
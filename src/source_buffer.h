@@ -0,0 +1,60 @@
+//----------------------------------------------------------------------
+// FILE: source_buffer.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Contiguous, read-only buffer of MyPL source text (either an
+// mmap'd file or a slurped stream) that the lexer scans directly.
+//----------------------------------------------------------------------
+
+#ifndef SOURCE_BUFFER_H
+#define SOURCE_BUFFER_H
+
+#include <istream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+
+class SourceBuffer
+{
+public:
+
+  // read the rest of the stream into a new buffer
+  static std::shared_ptr<const SourceBuffer> from_stream(std::istream& in);
+
+  // copy the string into a new buffer
+  static std::shared_ptr<const SourceBuffer> from_string(std::string text);
+
+  // mmap the given file (returns nullptr if it can't be opened)
+  static std::shared_ptr<const SourceBuffer> from_file(const std::string& path);
+
+  ~SourceBuffer();
+
+  // the source text
+  const char* data() const;
+  size_t size() const;
+  std::string_view text() const;
+
+  // buffers are shared (via shared_ptr) but never copied
+  SourceBuffer(const SourceBuffer&) = delete;
+  SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+private:
+
+  SourceBuffer() = default;
+
+  // the text when read from a stream or string
+  std::string owned;
+
+  // the mapping when read from a file
+  void* mapping = nullptr;
+  size_t mapping_size = 0;
+
+  // the start and length of the text (in owned or the mapping)
+  const char* start = nullptr;
+  size_t length = 0;
+
+};
+
+
+#endif
@@ -13,14 +13,21 @@ using namespace std;
 
 void SymbolTable::push_environment()
 {
-  environments.push_back(unordered_map<string,DataType>());
+  environments.push_back(bindings.size());
 }
 
 
 void SymbolTable::pop_environment()
 {
-  if (!empty())
-    environments.pop_back();
+  if (empty())
+    return;
+  // unshadow the environment's names
+  while (bindings.size() > environments.back()) {
+    const Binding& b = bindings.back();
+    innermost[b.name] = b.shadowed;
+    bindings.pop_back();
+  }
+  environments.pop_back();
 }
 
 
@@ -30,45 +37,62 @@ bool SymbolTable::empty() const
 }
 
 
-void SymbolTable::add(const string& name, const DataType& info)
+int SymbolTable::find(Symbol name) const
 {
-  if (!empty())
-    environments.back()[name] = info;
+  if (name >= innermost.size())
+    return -1;
+  return innermost[name];
 }
 
-bool SymbolTable::name_exists(const string& name) const
+
+void SymbolTable::add(Symbol name, const DataType& info)
 {
-  for (int i = environments.size() - 1; i >= 0; --i)
-    if (environments[i].contains(name))
-      return true;
-  return false;
+  if (empty())
+    return;
+  if (name_exists_in_curr_env(name)) {
+    bindings[innermost[name]].info = info;
+    return;
+  }
+  if (name >= innermost.size())
+    innermost.resize(name + 1, -1);
+  bindings.push_back({name, info, innermost[name]});
+  innermost[name] = bindings.size() - 1;
+}
+
+bool SymbolTable::name_exists(Symbol name) const
+{
+  return find(name) != -1;
 }
 
 
-bool SymbolTable::name_exists_in_curr_env(const string& name) const
+bool SymbolTable::name_exists_in_curr_env(Symbol name) const
 {
-  return !empty() and environments.back().contains(name);
+  return !empty() and find(name) >= environments.back();
 }
 
 
-optional<DataType> SymbolTable::get(const string& name) const
+optional<DataType> SymbolTable::get(Symbol name) const
 {
-  for (int i = environments.size() - 1; i >= 0; --i) 
-    if (environments[i].contains(name))
-      return environments[i].at(name);
+  int i = find(name);
+  if (i != -1)
+    return bindings[i].info;
   // couldn't find name, so return null option value
   return nullopt;
 }
 
 
-string to_string(const SymbolTable& symbol_table)
+string to_string(const SymbolTable& symbol_table, const Interner& symbols)
 {
   string str = "";
-  for (auto env : symbol_table.environments) {
+  const auto& envs = symbol_table.environments;
+  for (int e = 0; e < envs.size(); ++e) {
     str += "environment: [";
-    for(const auto& [var, type] : env) {
-      str += "\n  " + var + " -> " + type.type_name;
-      if (type.is_array)
+    int end = e + 1 < envs.size() ? envs[e + 1] : symbol_table.bindings.size();
+    for (int i = envs[e]; i < end; ++i) {
+      const auto& b = symbol_table.bindings[i];
+      str += "\n  " + string(symbols.name(b.name)) + " -> " +
+        string(b.info.type_name(symbols));
+      if (b.info.is_array)
         str += " (is_array = true)";
       else
         str += " (is_array = false)";
@@ -77,5 +101,3 @@ string to_string(const SymbolTable& symbol_table)
   }
   return str;
 }
-
-  
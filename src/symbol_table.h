@@ -9,7 +9,6 @@
 #define SYMBOL_TABLE_H
 
 #include <vector>
-#include <unordered_map>
 #include "ast.h"
 
 
@@ -25,23 +24,42 @@ public:
   // returns true if the symbol table has no environments
   bool empty() const;
   // add the name, with given type info, to the current environment
-  void add(const std::string& name, const DataType& info);
+  void add(Symbol name, const DataType& info);
   // true if the name exists in any environment
-  bool name_exists(const std::string& name) const;
+  bool name_exists(Symbol name) const;
   // true if the name exists in the last pushed environment
-  bool name_exists_in_curr_env(const std::string& name) const;
+  bool name_exists_in_curr_env(Symbol name) const;
   // return the type info for the given name (if the name exists),
   // searching from most recent to least recent environment (returning
   // first such match)
-  std::optional<DataType> get(const std::string& name) const;
+  std::optional<DataType> get(Symbol name) const;
 
   // pretty print the table for debugging
-  friend std::string to_string(const SymbolTable& symbol_table);
+  friend std::string to_string(const SymbolTable& symbol_table,
+                               const Interner& symbols);
   
 private:
 
-  // an environment is a mapping from names to type info
-  std::vector<std::unordered_map<std::string,DataType>> environments;
+  // a name added to an environment, with the index of the binding it
+  // shadows (or -1)
+  struct Binding {
+    Symbol name;
+    DataType info;
+    int shadowed;
+  };
+
+  // the bindings of all environments, from outermost to innermost
+  std::vector<Binding> bindings;
+
+  // index of the first binding of each environment
+  std::vector<int> environments;
+
+  // index of the innermost binding of each name (indexed by symbol,
+  // -1 if unbound)
+  std::vector<int> innermost;
+
+  // index of the name's innermost binding (or -1)
+  int find(Symbol name) const;
 
 };
 
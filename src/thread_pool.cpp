@@ -0,0 +1,95 @@
+//----------------------------------------------------------------------
+// FILE: thread_pool.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: ThreadPool implementation
+//----------------------------------------------------------------------
+
+#include "thread_pool.h"
+
+using namespace std;
+
+
+ThreadPool::ThreadPool(size_t workers)
+{
+  if (workers == 0)
+    workers = max(1u, thread::hardware_concurrency());
+  for (size_t i = 1; i < workers; ++i)
+    threads.emplace_back(&ThreadPool::loop, this, i);
+}
+
+
+ThreadPool::~ThreadPool()
+{
+  stopping = true;
+  ++batch;
+  batch.notify_all();
+  for (thread& t : threads)
+    t.join();
+}
+
+
+size_t ThreadPool::size() const
+{
+  return threads.size() + 1;
+}
+
+
+void ThreadPool::run(size_t count, const Task& task)
+{
+  if (count == 0)
+    return;
+  // case: nothing to share, so skip the hand off
+  if (threads.empty() or count == 1) {
+    for (size_t i = 0; i < count; ++i)
+      task(0, i);
+    return;
+  }
+  this->task = &task;
+  this->count = count;
+  next_index = 0;
+  failure = nullptr;
+  busy = threads.size();
+  ++batch;
+  batch.notify_all();
+  work(0);
+  // wait for the pool threads to finish their last tasks
+  size_t remaining;
+  while ((remaining = busy.load()) != 0)
+    busy.wait(remaining);
+  this->task = nullptr;
+  if (failure)
+    rethrow_exception(failure);
+}
+
+
+void ThreadPool::work(size_t worker)
+{
+  size_t i;
+  while ((i = next_index.fetch_add(1)) < count) {
+    try {
+      (*task)(worker, i);
+    } catch (...) {
+      lock_guard<mutex> lock(failure_mutex);
+      if (!failure)
+        failure = current_exception();
+      // stop handing out the rest of the batch
+      next_index = count;
+    }
+  }
+}
+
+
+void ThreadPool::loop(size_t worker)
+{
+  size_t seen = 0;
+  while (true) {
+    batch.wait(seen);
+    if (stopping)
+      return;
+    seen = batch.load();
+    work(worker);
+    if (busy.fetch_sub(1) == 1)
+      busy.notify_one();
+  }
+}
@@ -0,0 +1,73 @@
+//----------------------------------------------------------------------
+// FILE: thread_pool.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Fixed set of worker threads for running independent compile
+// tasks (e.g., one per function) in parallel.
+//----------------------------------------------------------------------
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class ThreadPool
+{
+public:
+
+  // a task is given the worker running it (in [0, size())) and the
+  // index of the task
+  typedef std::function<void(size_t worker, size_t index)> Task;
+
+  // create a pool of the given number of workers (the calling thread
+  // counts as one), 0 for one per hardware thread
+  ThreadPool(size_t workers = 0);
+
+  // waits for the workers to finish
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // the number of workers (including the calling thread)
+  size_t size() const;
+
+  // run the task for each index in [0, count), returning once all
+  // have finished; rethrows the first exception a task threw
+  void run(size_t count, const Task& task);
+
+private:
+
+  std::vector<std::thread> threads;
+
+  // the current batch of tasks
+  const Task* task = nullptr;
+  size_t count = 0;
+  std::atomic<size_t> next_index = 0;
+  // bumped for each batch (and on shutdown) to wake the workers
+  std::atomic<size_t> batch = 0;
+  // pool threads still working on the current batch
+  std::atomic<size_t> busy = 0;
+  std::atomic<bool> stopping = false;
+
+  // the first exception thrown by a task in the batch
+  std::mutex failure_mutex;
+  std::exception_ptr failure = nullptr;
+
+  // run tasks from the current batch until none are left
+  void work(size_t worker);
+
+  // body of each pool thread
+  void loop(size_t worker);
+
+};
+
+
+#endif
@@ -5,28 +5,93 @@
 // DESC: Token implementation
 //----------------------------------------------------------------------
 
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include "token.h"
 
 
+namespace {
+
+  // lexemes that don't point into a source buffer (set elements are
+  // never moved, so views of them stay valid)
+  std::mutex pool_mutex;
+  std::unordered_set<std::string>& lexeme_pool()
+  {
+    static std::unordered_set<std::string> pool;
+    return pool;
+  }
+
+  // the symbol for a token of the given type (the one given for an
+  // identifier)
+  Symbol symbol_of(TokenType type, Symbol id)
+  {
+    switch (type) {
+    case TokenType::ID:
+      return id;
+    case TokenType::INT_TYPE:
+      return Symbols::INT;
+    case TokenType::DOUBLE_TYPE:
+      return Symbols::DOUBLE;
+    case TokenType::CHAR_TYPE:
+      return Symbols::CHAR;
+    case TokenType::STRING_TYPE:
+      return Symbols::STRING;
+    case TokenType::BOOL_TYPE:
+      return Symbols::BOOL;
+    case TokenType::VOID_TYPE:
+      return Symbols::VOID;
+    default:
+      return Symbols::NONE;
+    }
+  }
+
+}
+
+
 Token::Token()
-  : token_type {TokenType::EOS}, token_lexeme {""}, token_line {0},
-    token_column {0}
+  : token_text {""}, token_length {0}, token_symbol {Symbols::NONE},
+    token_type {TokenType::EOS},
+    token_line {0}, token_column {0}
 {}
 
-Token::Token(TokenType type, const std::string& lexeme, int line, int column)
-  : token_type {type}, token_lexeme {lexeme}, token_line {line},
-    token_column {column}
-{}
+Token::Token(TokenType type, const std::string& lexeme, int line, int column,
+             Symbol symbol)
+  : token_type {type}, token_line {line}, token_column {column}
+{
+  std::lock_guard<std::mutex> lock(pool_mutex);
+  const std::string& pooled = *lexeme_pool().insert(lexeme).first;
+  token_text = pooled.data();
+  token_length = pooled.size();
+  token_symbol = symbol_of(type, symbol);
+}
+
+Token Token::view(TokenType type, std::string_view lexeme, int line, int column,
+                  Symbol symbol)
+{
+  Token t;
+  t.token_type = type;
+  t.token_text = lexeme.data();
+  t.token_length = lexeme.size();
+  t.token_symbol = symbol_of(type, symbol);
+  t.token_line = line;
+  t.token_column = column;
+  return t;
+}
 
 TokenType Token::type() const
 {
   return token_type;
 }
 
-std::string Token::lexeme() const
+std::string_view Token::lexeme() const
+{
+  return std::string_view(token_text, token_length);
+}
+
+Symbol Token::symbol() const
 {
-  return token_lexeme;
+  return token_symbol;
 }
 
 int Token::line() const
@@ -80,5 +145,5 @@ std::string to_string(const Token& token)
   };
   return std::to_string(token.line()) + ", "
     + std::to_string(token.column()) + ": "
-    + ts[token.type()] + " '" +  token.lexeme() + "'";
+    + ts[token.type()] + " '" +  std::string(token.lexeme()) + "'";
 }
@@ -8,7 +8,11 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
+#include "interner.h"
 
 
 enum class TokenType {
@@ -38,12 +42,22 @@ public:
 
   // default constructor
   Token();
-  // constructor
-  Token(TokenType type, const std::string& lexeme, int line, int colum);
+  // constructor (the lexeme is copied into a shared, program-lifetime
+  // lexeme pool), with the symbol the lexer interned for an identifier
+  Token(TokenType type, const std::string& lexeme, int line, int colum,
+        Symbol symbol = Symbols::NONE);
+  // create a token viewing a lexeme that outlives it (e.g., text in a
+  // retained source buffer or a string literal)
+  static Token view(TokenType type, std::string_view lexeme, int line,
+                    int column, Symbol symbol = Symbols::NONE);
   // returns the type of the token
   TokenType type() const;
-  // returns the lexeme of the token
-  std::string lexeme() const;
+  // returns the lexeme of the token (without copying)
+  std::string_view lexeme() const;
+  // returns the interned lexeme of an identifier (in its lexer's
+  // interner) or primitive type name (and Symbols::NONE for all other
+  // tokens)
+  Symbol symbol() const;
   // returns the line of the token
   int line() const;
   // returns the column of the token
@@ -53,10 +67,13 @@ public:
 
 private:
 
+  // the token's lexeme
+  const char* token_text;
+  uint32_t token_length;
+  // the token's symbol (interned by the lexer)
+  Symbol token_symbol;
   // the type of the token
   TokenType token_type;
-  // the token's lexeme
-  std::string token_lexeme;
   // line the token occurs on
   int token_line;
   // starting column of the token
@@ -65,4 +82,16 @@ private:
 };
 
 
+// transparent hash so maps keyed by std::string can be searched by
+// lexeme without making a copy (use with std::equal_to<>)
+struct StringHash
+{
+  using is_transparent = void;
+  size_t operator()(std::string_view s) const
+  {
+    return std::hash<std::string_view>{}(s);
+  }
+};
+
+
 #endif
@@ -0,0 +1,127 @@
+//----------------------------------------------------------------------
+// FILE: tracer.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Tracer implementation
+//----------------------------------------------------------------------
+
+#include <cstdio>
+#include <vector>
+#include <unistd.h>
+#include "tracer.h"
+#include "profiler.h"
+
+using namespace std;
+
+
+Tracer::Tracer()
+  : start(Clock::now())
+{
+}
+
+
+void Tracer::begin(const string& phase)
+{
+  ++open;
+  log(Kind::BEGIN, &*phases.insert(phase).first);
+}
+
+
+void Tracer::end()
+{
+  --open;
+  log(Kind::END, nullptr);
+}
+
+
+Tracer::Phase::Phase(Tracer* tracer, const string& phase)
+  : tracer(tracer)
+{
+  if (tracer)
+    tracer->begin(phase);
+}
+
+
+Tracer::Phase::~Phase()
+{
+  end();
+}
+
+
+void Tracer::Phase::end()
+{
+  if (tracer)
+    tracer->end();
+  tracer = nullptr;
+}
+
+
+size_t Tracer::depth() const
+{
+  return open;
+}
+
+
+void Tracer::unwind(size_t depth)
+{
+  while (open > depth)
+    ret();
+}
+
+
+void Tracer::finish()
+{
+  while (open > 0)
+    end();
+}
+
+
+size_t Tracer::event_count() const
+{
+  return events.size();
+}
+
+
+namespace {
+
+  // nanoseconds as (fractional) microseconds, the trace-event unit
+  string us(uint64_t ns)
+  {
+    char text[32];
+    snprintf(text, sizeof(text), "%llu.%03llu",
+             (unsigned long long)(ns / 1000), (unsigned long long)(ns % 1000));
+    return text;
+  }
+
+}
+
+
+void Tracer::write_json(ostream& out, uint64_t min_ns) const
+{
+  // pair each call or phase with its end, writing it as a complete
+  // ("X") event as it ends
+  string pid = to_string(getpid());
+  vector<const Event*> running;
+  bool first = true;
+  out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+  for (const Event& e : events) {
+    if (e.kind == Kind::CALL or e.kind == Kind::BEGIN) {
+      running.push_back(&e);
+      continue;
+    }
+    if (running.empty())
+      continue;
+    const Event& b = *running.back();
+    running.pop_back();
+    uint64_t dur = e.ns - b.ns;
+    if (b.kind == Kind::CALL and dur < min_ns)
+      continue;
+    out << (first ? "" : ",") << endl << "  {\"name\": "
+        << json_string(*b.name) << ", \"cat\": \""
+        << (b.kind == Kind::CALL ? "call" : "phase")
+        << "\", \"ph\": \"X\", \"ts\": " << us(b.ns) << ", \"dur\": "
+        << us(dur) << ", \"pid\": " << pid << ", \"tid\": 1}";
+    first = false;
+  }
+  out << endl << "]}" << endl;
+}
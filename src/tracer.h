@@ -0,0 +1,120 @@
+//----------------------------------------------------------------------
+// FILE: tracer.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Timeline of a run: the phases of the compiler and vm and every
+// function call, logged as fixed-size binary events while running and
+// written as Chrome trace-event json (for chrome://tracing, Perfetto,
+// and similar viewers) afterwards.
+//----------------------------------------------------------------------
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <set>
+#include <string>
+#include "vm_frame.h"
+
+
+class Tracer
+{
+public:
+
+  Tracer();
+
+  // the vm calls these as it runs (see VM::set_tracer): a function
+  // starts, and the current function returns
+  void enter(const VMFrameInfo& info);
+  void ret();
+
+  // the number of calls and phases open, and return from the calls
+  // above the given number (when an error unwinds the vm)
+  size_t depth() const;
+  void unwind(size_t depth);
+
+  // a (possibly nested) phase starts, and the innermost one ends
+  void begin(const std::string& phase);
+  void end();
+
+  // a phase lasting until end is called or it goes out of scope (does
+  // nothing without a tracer)
+  class Phase
+  {
+  public:
+    Phase(Tracer* tracer, const std::string& phase);
+    ~Phase();
+    Phase(const Phase&) = delete;
+    Phase& operator=(const Phase&) = delete;
+    void end();
+  private:
+    Tracer* tracer;
+  };
+
+  // close the calls and phases still running (e.g., after a vm error)
+  void finish();
+
+  // the number of events logged
+  size_t event_count() const;
+
+  // write the timeline as trace-event json, leaving out calls shorter
+  // than min_ns (once finished, while the vm and so its frame templates
+  // still exist)
+  void write_json(std::ostream& out, uint64_t min_ns = 0) const;
+
+private:
+
+  typedef std::chrono::steady_clock Clock;
+
+  enum class Kind : uint32_t {CALL, RETURN, BEGIN, END};
+
+  struct Event {
+    // nanoseconds since the tracer was created
+    uint64_t ns;
+    // the function or phase (nullptr for returns and ends)
+    const std::string* name;
+    Kind kind;
+  };
+
+  Clock::time_point start;
+
+  // the log (a deque so it grows without copying)
+  std::deque<Event> events;
+
+  // the phase names logged
+  std::set<std::string> phases;
+
+  // calls and phases not yet closed
+  size_t open = 0;
+
+  void log(Kind kind, const std::string* name);
+
+};
+
+
+inline void Tracer::log(Kind kind, const std::string* name)
+{
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    Clock::now() - start).count();
+  events.push_back({ns, name, kind});
+}
+
+
+inline void Tracer::enter(const VMFrameInfo& info)
+{
+  ++open;
+  log(Kind::CALL, &info.function_name);
+}
+
+
+inline void Tracer::ret()
+{
+  --open;
+  log(Kind::RETURN, nullptr);
+}
+
+
+#endif
@@ -13,16 +13,22 @@ using namespace std;
 
 void VarTable::push_environment()
 {
-  environments.push_back(unordered_map<string,int>());
+  environments.push_back(bindings.size());
 }
 
 
 void VarTable::pop_environment()
 {
-  if (!empty()) {
-    next_index -= environments.back().size();
-    environments.pop_back();
+  if (empty())
+    return;
+  next_index -= bindings.size() - environments.back();
+  // unshadow the environment's names
+  while (bindings.size() > environments.back()) {
+    const Binding& b = bindings.back();
+    innermost[b.name] = b.shadowed;
+    bindings.pop_back();
   }
+  environments.pop_back();
 }
 
 
@@ -32,33 +38,42 @@ bool VarTable::empty() const
 }
 
 
-void VarTable::add(const string& name)
+void VarTable::add(Symbol name)
 {
-  if (!empty())
-    environments.back()[name] = next_index++;
+  if (empty())
+    return;
+  if (name >= innermost.size())
+    innermost.resize(name + 1, -1);
+  // a name redeclared in the same environment shadows itself, so every
+  // index handed out is given back when the environment is popped
+  int i = innermost[name];
+  bindings.push_back({name, next_index++, i});
+  innermost[name] = bindings.size() - 1;
 }
 
 
-int VarTable::get(const string& name) const
+int VarTable::get(Symbol name) const
 {
-  for (int i = environments.size() - 1; i >= 0; --i) 
-    if (environments[i].contains(name))
-      return environments[i].at(name);
-  // couldn't find name, so return null option value
-  return -1;
+  if (name >= innermost.size() or innermost[name] == -1)
+    // couldn't find name, so return null option value
+    return -1;
+  return bindings[innermost[name]].index;
 }
 
 
-string to_string(const VarTable& var_table)
+string to_string(const VarTable& var_table, const Interner& symbols)
 {
   string str = "";
-  for (auto env : var_table.environments) {
+  const auto& envs = var_table.environments;
+  for (int e = 0; e < envs.size(); ++e) {
     str += "environment: [";
-    for(const auto& [var, index] : env)
-      str += "\n  " + var + " -> " + to_string(index);
+    int end = e + 1 < envs.size() ? envs[e + 1] : var_table.bindings.size();
+    for (int i = envs[e]; i < end; ++i) {
+      const auto& b = var_table.bindings[i];
+      str += "\n  " + string(symbols.name(b.name)) + " -> " +
+        to_string(b.index);
+    }
     str += "\n]\n";
   }
   return str;
 }
-
-  
@@ -10,7 +10,7 @@
 
 #include <string>
 #include <vector>
-#include <unordered_map>
+#include "interner.h"
 
 
 class VarTable
@@ -27,18 +27,34 @@ public:
   bool empty() const;
 
   // add the var name to the current environment
-  void add(const std::string& name);
+  void add(Symbol name);
 
   // return index for most recent name (or -1 if the name doesn't exist)
-  int get(const std::string& name) const;
+  int get(Symbol name) const;
 
   // pretty print the table for debugging
-  friend std::string to_string(const VarTable& var_table);
+  friend std::string to_string(const VarTable& var_table,
+                               const Interner& symbols);
 
 private:
 
-  // an environment is a mapping from names to type info
-  std::vector<std::unordered_map<std::string,int>> environments;
+  // a name added to an environment, with the index of the binding it
+  // shadows (or -1)
+  struct Binding {
+    Symbol name;
+    int index;
+    int shadowed;
+  };
+
+  // the bindings of all environments, from outermost to innermost
+  std::vector<Binding> bindings;
+
+  // index of the first binding of each environment
+  std::vector<int> environments;
+
+  // index of the innermost binding of each name (indexed by symbol,
+  // -1 if unbound)
+  std::vector<int> innermost;
 
   int next_index = 0;
   
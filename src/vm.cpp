@@ -13,6 +13,22 @@
 using namespace std;
 
 
+namespace {
+
+  // the (approximate) heap bytes of an empty struct object, of each of
+  // its fields, and of an array object of n elements
+  const size_t STRUCT_BYTES = sizeof(unordered_map<Symbol, VMValue>);
+  const size_t FIELD_BYTES = sizeof(pair<const Symbol, VMValue>) +
+    2 * sizeof(void*);
+
+  size_t array_bytes(size_t n)
+  {
+    return sizeof(vector<VMValue>) + n * sizeof(VMValue);
+  }
+
+}
+
+
 void VM::error(string msg) const
 {
   throw MyPLException::VMError(msg);
@@ -22,10 +38,14 @@ void VM::error(string msg) const
 void VM::error(string msg, const VMFrame& frame) const
 {
   int pc = frame.pc - 1;
-  VMInstr instr = frame.info.instructions[pc];
-  string name = frame.info.function_name;
+  VMInstr instr = frame.info->instructions[pc];
+  string name = frame.info->function_name;
   msg += " (in " + name + " at " + to_string(pc) + ": " +
-    to_string(instr) + ")";
+    to_string(instr, symbols().get());
+  int line = frame.info->line(pc);
+  if (line > 0)
+    msg += ", line " + to_string(line);
+  msg += ")";
   throw MyPLException::VMError(msg);
 }
 
@@ -33,81 +53,532 @@ void VM::error(string msg, const VMFrame& frame) const
 string to_string(const VM& vm)
 {
   string s = "";
-  for (const auto& entry : vm.frame_info) {
+  for (const auto& entry : vm.frames()) {
     const string& name = entry.first;
     s += "\nFrame '" + name + "'\n";
     const VMFrameInfo& frame = entry.second;
     for (int i = 0; i < frame.instructions.size(); ++i) {
       VMInstr instr = frame.instructions[i];
-      s += "  " + to_string(i) + ": " + to_string(instr) + "\n"; 
+      s += "  " + to_string(i) + ": " + to_string(instr, vm.symbols().get()) +
+        "\n";
     }
   }
   return s;
 }
 
 
+VM::VM()
+{
+  shared_ptr<Module> module = make_shared<Module>();
+  own_code = module.get();
+  code = module;
+}
+
+
+VM::VM(shared_ptr<const Module> module)
+  : code(module)
+{
+}
+
+
+Module& VM::editable()
+{
+  if (own_code == nullptr)
+    error("the vm's module is shared, so its code can't change");
+  return *own_code;
+}
+
+
+shared_ptr<const Module> VM::module()
+{
+  if (own_code) {
+    const Interner& symbols = *code->symbols();
+    for (const auto& [name, info] : code->frames())
+      if (info.stub)
+        callable(symbols.find(name));
+    own_code = nullptr;
+  }
+  return code;
+}
+
+
+shared_ptr<Interner> VM::symbols() const
+{
+  return code->symbols();
+}
+
+
+void VM::set_symbols(shared_ptr<Interner> symbols)
+{
+  Module& module = editable();
+  if (module.interner == symbols)
+    return;
+  if (!module.frame_info.empty() or !module.struct_info.empty())
+    error("the program's symbols aren't the vm's (lex it with "
+          "VM::symbols)");
+  module.interner = symbols;
+}
+
+
 void VM::add(const VMFrameInfo& frame)
 {
-  frame_info[frame.function_name] = frame;
+  add(VMFrameInfo(frame));
+}
+
+
+void VM::add(VMFrameInfo&& frame)
+{
+  Module& module = editable();
+  // (a warm frame would run the old code)
+  warm_frames.clear();
+  module.add(std::move(frame));
+}
+
+
+const VMFrameInfo& VM::function(Symbol name) const
+{
+  return code->function(name);
+}
+
+
+const VMFrameInfo& VM::callable(Symbol name)
+{
+  const VMFrameInfo& info = function(name);
+  if (info.stub) {
+    if (loader == nullptr)
+      error("No code for function '" + info.function_name + "'");
+    // the loader replaces the stub in place
+    if (tracer)
+      tracer->begin("codegen " + info.function_name);
+    loader(name);
+    if (tracer)
+      tracer->end();
+  }
+  return info;
+}
+
+
+void VM::add(const VMStructInfo& info)
+{
+  editable().add(info);
+}
+
+
+void VM::set_loader(const Loader& loader)
+{
+  this->loader = loader;
+}
+
+
+const unordered_map<string, VMFrameInfo>& VM::frames() const
+{
+  return code->frames();
+}
+
+
+const unordered_map<string, VMStructInfo>& VM::structs() const
+{
+  return code->structs();
+}
+
+
+uint64_t VM::instruction_count() const
+{
+  return run_stats.instructions;
+}
+
+
+const VMStats& VM::stats() const
+{
+  return run_stats;
+}
+
+
+void VM::add_phase_time(const string& phase, uint64_t ns)
+{
+  run_stats.add_phase(phase, ns);
+}
+
+
+void VM::set_profiler(Profiler* profiler)
+{
+  this->profiler = profiler;
+}
+
+
+void VM::set_sampler(Sampler* sampler)
+{
+  this->sampler = sampler;
+}
+
+
+void VM::set_tracer(Tracer* tracer)
+{
+  this->tracer = tracer;
+}
+
+
+void VM::set_counters(PerfCounters* counters)
+{
+  this->counters = counters;
+}
+
+
+void VM::set_heap_profiler(HeapProfiler* heap_profiler)
+{
+  this->heap_profiler = heap_profiler;
+}
+
+
+void VM::set_perf_map(PerfMap* perf_map)
+{
+  this->perf_map = perf_map;
+}
+
+
+void VM::set_step_hook(const Hook& hook)
+{
+  step_hook = hook;
+}
+
+
+void VM::set_break_hook(const Hook& hook)
+{
+  break_hook = hook;
+}
+
+
+void VM::add_breakpoint(const string& function, int pc)
+{
+  breakpoints[function].insert(pc);
+}
+
+
+void VM::remove_breakpoint(const string& function, int pc)
+{
+  auto entry = breakpoints.find(function);
+  if (entry == breakpoints.end())
+    return;
+  entry->second.erase(pc);
+  if (entry->second.empty())
+    breakpoints.erase(entry);
+}
+
+
+void VM::clear_breakpoints()
+{
+  breakpoints.clear();
+}
+
+
+string VM::dump(const VMFrame& frame) const
+{
+  string s = "frame " + frame.info->function_name + " at " +
+    to_string(frame.pc);
+  int line = frame.info->line(frame.pc);
+  if (line > 0)
+    s += " (line " + to_string(line) + ")";
+  if (frame.pc < frame.info->instructions.size())
+    s += ": " + to_string(frame.info->instructions[frame.pc], symbols().get());
+  // the operand stack is listed from its bottom to its top
+  vector<VMValue> operands;
+  for (stack<VMValue> rest = frame.operand_stack; !rest.empty(); rest.pop())
+    operands.push_back(rest.top());
+  s += "\n  operands:";
+  for (auto value = operands.rbegin(); value != operands.rend(); ++value)
+    s += " " + to_string(*value);
+  s += "\n  variables:";
+  for (int i = 0; i < frame.variables.size(); ++i)
+    s += " " + to_string(i) + "=" + to_string(frame.variables[i]);
+  return s + "\n";
+}
+
+
+void VM::debug(const VMFrame& frame, const VMInstr& instr, bool print)
+{
+  if (step_hook)
+    step_hook(frame, instr);
+  else if (print)
+    cerr << dump(frame);
+  auto entry = breakpoints.find(frame.info->function_name);
+  if (entry == breakpoints.end() or !entry->second.contains(frame.pc))
+    return;
+  if (break_hook)
+    break_hook(frame, instr);
+  else
+    cerr << "breakpoint: " << dump(frame);
+}
+
+
+bool VM::debugging(bool DEBUG) const
+{
+  // (the profiler also observes each instruction)
+  return DEBUG or step_hook or !breakpoints.empty() or profiler;
 }
 
 
 void VM::run(bool DEBUG)
 {
   // grab the "main" frame if it exists
-  if (!frame_info.contains("main"))
+  if (!frames().contains("main"))
     error("No 'main' function");
   shared_ptr<VMFrame> frame = make_shared<VMFrame>();
-  frame->info = frame_info["main"];
+  const VMFrameInfo& main_info = callable(Symbols::MAIN);
+  frame->info = &main_info;
+  if (debugging(DEBUG))
+    execute<true>(main_info, frame, DEBUG);
+  else
+    execute<false>(main_info, frame, false);
+}
+
+
+VM::Function VM::lookup(const string& name) const
+{
+  Symbol symbol = code->symbols()->find(name);
+  if (symbol == Symbols::NONE or function(symbol).function_name == "")
+    error("No '" + name + "' function");
+  return {symbol};
+}
+
+
+VMValue VM::call(const string& name, const vector<VMValue>& args)
+{
+  return call(lookup(name), args);
+}
+
+
+VMValue VM::call(Function function, const vector<VMValue>& args)
+{
+  const VMFrameInfo& info = callable(function.name);
+  if (args.size() != info.arg_count)
+    error("'" + info.function_name + "' takes " +
+          to_string(info.arg_count) + " arguments, not " +
+          to_string(args.size()));
+  // reuse the function's last frame unless it is still running (a call
+  // from within a run)
+  shared_ptr<VMFrame>& frame = warm_frames[function.name];
+  if (frame == nullptr or frame.use_count() > 1) {
+    frame = make_shared<VMFrame>();
+    frame->info = &info;
+  } else {
+    frame->pc = 0;
+    frame->variables.clear();
+    while (!frame->operand_stack.empty())
+      frame->operand_stack.pop();
+  }
+  // (as CALL passes them, the first argument on top)
+  for (auto arg = args.rbegin(); arg != args.rend(); ++arg)
+    frame->operand_stack.push(*arg);
+  if (debugging(false))
+    return execute<true>(info, frame, false);
+  return execute<false>(info, frame, false);
+}
+
+
+void VM::reset_heap()
+{
+  struct_heap.clear();
+  array_heap.clear();
+  next_obj_id = 2023;
+  if (heap_profiler)
+    heap_profiler->free_all();
+}
+
+
+void VM::set_output(ostream& out)
+{
+  output = &out;
+}
+
+
+void VM::set_input(istream& in)
+{
+  input = &in;
+}
+
+
+template<bool Debug>
+VMValue VM::execute(const VMFrameInfo& info, shared_ptr<VMFrame> frame,
+                    bool print)
+{
+  size_t outer_depth = entry_depth;
+  entry_depth = call_stack.size();
+  // (the observers' depths to unwind to on an error)
+  size_t sampler_depth = sampler ? sampler->depth() : 0;
+  size_t tracer_depth = tracer ? tracer->depth() : 0;
+  size_t counters_depth = counters ? counters->depth() : 0;
+  size_t profiler_depth = profiler ? profiler->depth() : 0;
+  returned = nullptr;
   call_stack.push(frame);
+  ++run_stats.calls;
+  if (call_stack.size() > run_stats.max_call_depth)
+    run_stats.max_call_depth = call_stack.size();
+  if (profiler)
+    profiler->enter(*frame->info);
+  if (sampler)
+    sampler->push(&info, &frame->pc);
+  if (tracer)
+    tracer->enter(info);
+  if (counters)
+    counters->enter(info);
+
+  try {
+    if (perf_map and perf_nesting < MAX_PERF_NESTING)
+      call_through<Debug>(info, print);
+    else
+      loop<Debug>(print);
+  } catch (...) {
+    // (the frames the error left behind are dropped, once the sampler
+    // no longer points into them)
+    if (sampler)
+      sampler->unwind(sampler_depth);
+    if (tracer)
+      tracer->unwind(tracer_depth);
+    if (counters)
+      counters->unwind(counters_depth);
+    if (profiler)
+      profiler->unwind(profiler_depth);
+    while (call_stack.size() > entry_depth)
+      call_stack.pop();
+    entry_depth = outer_depth;
+    throw;
+  }
+  while (call_stack.size() > entry_depth)
+    call_stack.pop();
+  entry_depth = outer_depth;
+
+  if (profiler)
+    profiler->finish();
+  if (counters)
+    counters->finish();
+  return returned;
+}
 
-  // run loop (keep going until we run out of instructions)
-  while (!call_stack.empty() and frame->pc < frame->info.instructions.size()) {
 
-    // get the next instruction
-    VMInstr& instr = frame->info.instructions[frame->pc];
+template<bool Debug>
+void VM::call_through(const VMFrameInfo& info, bool print)
+{
+  ++perf_nesting;
+  perf_map->trampoline(info)(this, print, &run_nested<Debug>);
+  --perf_nesting;
+  if (nested_error) {
+    exception_ptr error = nested_error;
+    nested_error = nullptr;
+    rethrow_exception(error);
+  }
+}
 
-    // increment the program counter
-    ++frame->pc;
-
-    // for debugging
-    if (DEBUG) {
-      // TODO
-      cerr << endl << endl;
-      cerr << "\t FRAME.........: " << frame->info.function_name << endl;
-      cerr << "\t PC............: " << (frame->pc - 1) << endl;
-      cerr << "\t INSTR.........: " << to_string(instr) << endl;
-      cerr << "\t NEXT OPERAND..: ";
-      if (!frame->operand_stack.empty())
-        cerr << to_string(frame->operand_stack.top()) << endl;
-      else
-        cerr << "empty" << endl;
-      cerr << "\t NEXT FUNCTION.: ";
-      if (!call_stack.empty())
-        cerr << call_stack.top()->info.function_name << endl;
-      else
-        cerr << "empty" << endl;
+
+template<bool Debug>
+void VM::run_nested(VM* vm, bool print)
+{
+  try {
+    vm->loop<Debug>(print);
+  } catch (...) {
+    vm->nested_error = current_exception();
+  }
+}
+
+
+template<bool Debug>
+void VM::loop(bool print)
+{
+  size_t depth = call_stack.size();
+
+  // the running frame, its instructions, and its program counter (kept
+  // in locals; frame->pc is written for errors, hooks, and the sampler,
+  // but only read back when switching frames)
+  VMFrame* frame = nullptr;
+  const VMInstr* instructions = nullptr;
+  int instruction_count = 0;
+  int pc = 0;
+
+  // the instructions executed and deepest operand stack, counted in
+  // locals and written to the run stats on calls and returns and
+  // however the loop ends (including by an error). Instructions are
+  // counted a straight run at a time (from where the run started up to
+  // pc) whenever pc jumps, rather than one by one.
+  struct Counts {
+    VMStats& stats;
+    const int& pc;
+    int run_start = 0;
+    size_t max_operands = 0;
+    // count the run so far (the next one starts at pc)
+    void flush()
+    {
+      stats.instructions += pc - run_start;
+      run_start = pc;
+      if (max_operands > stats.max_operand_depth)
+        stats.max_operand_depth = max_operands;
+    }
+    ~Counts()
+    {
+      flush();
     }
+  } counts {run_stats, pc};
+
+  auto switch_to = [&](VMFrame* f) {
+    frame = f;
+    instructions = f->info->instructions.data();
+    instruction_count = f->info->instructions.size();
+    pc = f->pc;
+    counts.run_start = pc;
+  };
+  auto jump = [&](int target) {
+    counts.flush();
+    pc = target;
+    counts.run_start = pc;
+  };
+  switch_to(call_stack.top().get());
+  // note the frame's operand stack depth (after a push)
+  auto note_operands = [&](const VMFrame& f) {
+    size_t operands = f.operand_stack.size();
+    if (operands > counts.max_operands)
+      counts.max_operands = operands;
+  };
+
+  // run loop (keep going until we run out of instructions, or the
+  // frame the loop started with returns)
+  while (pc < instruction_count) {
+
+    // get the next instruction (and its opcode, which each case below
+    // compares against)
+    const VMInstr& instr = instructions[pc];
+    const OpCode opcode = instr.opcode();
+
+    // for debugging (and profiling)
+    if constexpr (Debug) {
+      if (profiler)
+        profiler->step(opcode, pc);
+      frame->pc = pc;
+      counts.flush();
+      debug(*frame, instr, print);
+    }
+
+    // increment the program counter
+    frame->pc = ++pc;
 
     //----------------------------------------------------------------------
     // Literals and Variables
     //----------------------------------------------------------------------
 
-    if (instr.opcode() == OpCode::PUSH) {
+    if (opcode == OpCode::PUSH) {
       frame->operand_stack.push(instr.operand().value());
+      note_operands(*frame);
     }
 
-    else if (instr.opcode() == OpCode::POP) {
+    else if (opcode == OpCode::POP) {
       frame->operand_stack.pop();
     }
 
     // TODO: Finish LOAD and STORE
 
-    else if(instr.opcode() == OpCode::LOAD) {
+    else if(opcode == OpCode::LOAD) {
       VMValue x = frame->variables.at(get<int>(instr.operand().value()));
       frame->operand_stack.push(x);
+      note_operands(*frame);
     }
-    else if(instr.opcode() == OpCode::STORE) {
+    else if(opcode == OpCode::STORE) {
       VMValue x = frame->operand_stack.top();
       frame->operand_stack.pop();
 
@@ -123,7 +594,7 @@ void VM::run(bool DEBUG)
     // Operations
     //----------------------------------------------------------------------
 
-    else if (instr.opcode() == OpCode::ADD) {
+    else if (opcode == OpCode::ADD) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
@@ -136,7 +607,7 @@ void VM::run(bool DEBUG)
     // TODO: Finish SUB, MUL, DIV, AND, OR, NOT, COMPLT, COMPLE,
     // CMPGT, CMPGE, CMPEQ, CMPNE
 
-    else if (instr.opcode() == OpCode::SUB) {
+    else if (opcode == OpCode::SUB) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
@@ -145,7 +616,7 @@ void VM::run(bool DEBUG)
       frame->operand_stack.pop();
       frame->operand_stack.push(sub(y, x));
     }
-    else if (instr.opcode() == OpCode::MUL) {
+    else if (opcode == OpCode::MUL) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
@@ -154,7 +625,7 @@ void VM::run(bool DEBUG)
       frame->operand_stack.pop();
       frame->operand_stack.push(mul(y, x));
     }
-    else if (instr.opcode() == OpCode::DIV) {
+    else if (opcode == OpCode::DIV) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
@@ -163,7 +634,7 @@ void VM::run(bool DEBUG)
       frame->operand_stack.pop();
       frame->operand_stack.push(div(y, x));
     }
-    else if (instr.opcode() == OpCode::AND) {
+    else if (opcode == OpCode::AND) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
@@ -172,7 +643,7 @@ void VM::run(bool DEBUG)
       frame->operand_stack.pop();
       frame->operand_stack.push(get<bool>(y) && get<bool>(x));
     }
-    else if (instr.opcode() == OpCode::OR) {
+    else if (opcode == OpCode::OR) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
@@ -181,13 +652,13 @@ void VM::run(bool DEBUG)
       frame->operand_stack.pop();
       frame->operand_stack.push(get<bool>(y) || get<bool>(x));
     }
-    else if (instr.opcode() == OpCode::NOT) {
+    else if (opcode == OpCode::NOT) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
       frame->operand_stack.push(!get<bool>(x));
     }
-    else if (instr.opcode() == OpCode::CMPLT) {
+    else if (opcode == OpCode::CMPLT) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
@@ -196,7 +667,7 @@ void VM::run(bool DEBUG)
       frame->operand_stack.pop();
       frame->operand_stack.push(lt(y, x));
     }
-    else if (instr.opcode() == OpCode::CMPLE) {
+    else if (opcode == OpCode::CMPLE) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
@@ -205,7 +676,7 @@ void VM::run(bool DEBUG)
       frame->operand_stack.pop();
       frame->operand_stack.push(le(y, x));
     }
-    else if (instr.opcode() == OpCode::CMPGT) {
+    else if (opcode == OpCode::CMPGT) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
@@ -214,7 +685,7 @@ void VM::run(bool DEBUG)
       frame->operand_stack.pop();
       frame->operand_stack.push(gt(y, x));
     }
-    else if (instr.opcode() == OpCode::CMPGE) {
+    else if (opcode == OpCode::CMPGE) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
@@ -223,7 +694,7 @@ void VM::run(bool DEBUG)
       frame->operand_stack.pop();
       frame->operand_stack.push(ge(y, x));
     }
-    else if (instr.opcode() == OpCode::CMPEQ) {
+    else if (opcode == OpCode::CMPEQ) {
       VMValue x = frame->operand_stack.top();
       //ensure_not_null(*frame, x);
       frame->operand_stack.pop();
@@ -232,7 +703,7 @@ void VM::run(bool DEBUG)
       frame->operand_stack.pop();
       frame->operand_stack.push(eq(y,x));
     }
-    else if (instr.opcode() == OpCode::CMPNE) {
+    else if (opcode == OpCode::CMPNE) {
       VMValue x = frame->operand_stack.top();
       //ensure_not_null(*frame, x);
       frame->operand_stack.pop();
@@ -249,15 +720,15 @@ void VM::run(bool DEBUG)
     //----------------------------------------------------------------------
 
     // TODO: Finish JMP and JMPF
-    else if (instr.opcode() == OpCode::JMP) {
-      frame->pc = get<int>(instr.operand().value());
+    else if (opcode == OpCode::JMP) {
+      jump(get<int>(instr.operand().value()));
     }
-    else if (instr.opcode() == OpCode::JMPF) {
+    else if (opcode == OpCode::JMPF) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
       if(get<bool>(x) == false) {
-        frame->pc = get<int>(instr.operand().value());
+        jump(get<int>(instr.operand().value()));
       }
     }
     
@@ -268,37 +739,73 @@ void VM::run(bool DEBUG)
 
     // TODO: Finish CALL, RET
 
-    else if(instr.opcode() == OpCode::CALL)
+    else if(opcode == OpCode::CALL)
     {
-      string func_name = get<string>(instr.operand().value());
+      counts.flush();
+      const VMFrameInfo& callee = callable(get<int>(instr.operand().value()));
       shared_ptr<VMFrame> new_frame = make_shared<VMFrame>();
-      new_frame->info = frame_info[func_name];
+      new_frame->info = &callee;
+      if (profiler)
+        profiler->call(pc - 1, callee);
 
       call_stack.push(new_frame);
-
-      for(int i = 0; i < frame_info[func_name].arg_count; i++) {
+      ++run_stats.calls;
+      if (call_stack.size() > run_stats.max_call_depth)
+        run_stats.max_call_depth = call_stack.size();
+      if (sampler)
+        sampler->push(&callee, &new_frame->pc);
+      if (tracer)
+        tracer->enter(callee);
+      if (counters)
+        counters->enter(callee);
+
+      for(int i = 0; i < callee.arg_count; i++) {
         VMValue v = frame->operand_stack.top();
         new_frame->operand_stack.push(v);
         frame->operand_stack.pop();
       }
+      note_operands(*new_frame);
       
-      frame = new_frame;
+      if (perf_map and perf_nesting < MAX_PERF_NESTING) {
+        // (the callee returns before the trampoline does)
+        call_through<Debug>(callee, print);
+      }
+      else
+        switch_to(new_frame.get());
     }
 
-    else if(instr.opcode() == OpCode::RET)
+    else if(opcode == OpCode::RET)
     {
       // 1. Pop the return value off the current frame's operand stack
       VMValue v = frame->operand_stack.top();
       frame->operand_stack.pop();
 
       // 2. Pop the frame off the stack
+      counts.flush();
+      if (sampler)
+        sampler->pop();
       call_stack.pop();
-
-      if(!call_stack.empty())
+      if (profiler)
+        profiler->ret();
+      if (tracer)
+        tracer->ret();
+      if (counters)
+        counters->ret();
+
+      if(call_stack.size() > entry_depth)
       {
-        frame = call_stack.top();
+        frame = call_stack.top().get();
         frame->operand_stack.push(v);
+        note_operands(*frame);
       }
+      else
+        returned = v;
+
+      // case: the frame the loop started with returned (to the loop
+      // running its caller, if any)
+      if (call_stack.size() < depth)
+        return;
+      switch_to(frame);
 
     }
 
@@ -308,31 +815,34 @@ void VM::run(bool DEBUG)
     //----------------------------------------------------------------------
 
 
-    else if (instr.opcode() == OpCode::WRITE) {
+    else if (opcode == OpCode::WRITE) {
       VMValue x = frame->operand_stack.top();
       frame->operand_stack.pop();
-      cout << to_string(x);
+      *output << to_string(x);
     }
 
-    else if (instr.opcode() == OpCode::READ) {
+    else if (opcode == OpCode::READ) {
       string val = "";
-      getline(cin, val);
+      getline(*input, val);
+      run_stats.string_bytes += val.size();
       frame->operand_stack.push(val);
+      note_operands(*frame);
     }
 
     // TODO: Finish SLEN, ALEN, GETC, TODBL, TOSTR, CONCAT
 
-    else if(instr.opcode() == OpCode::SLEN)
+    else if(opcode == OpCode::SLEN)
     {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
 
       string x_str = get<string>(x);
+      run_stats.string_bytes += x_str.size();
       int size = x_str.size();
       frame->operand_stack.push(size);
     }
-    else if(instr.opcode() == OpCode::ALEN)
+    else if(opcode == OpCode::ALEN)
     {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
@@ -342,7 +852,7 @@ void VM::run(bool DEBUG)
       frame->operand_stack.push(size);
     }
 
-    else if(instr.opcode() == OpCode::TODBL)
+    else if(opcode == OpCode::TODBL)
     {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
@@ -364,7 +874,7 @@ void VM::run(bool DEBUG)
 
       frame->operand_stack.push(x_dub);
     }
-    else if (instr.opcode() == OpCode::TOINT) {
+    else if (opcode == OpCode::TOINT) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
@@ -385,14 +895,16 @@ void VM::run(bool DEBUG)
 
       frame->operand_stack.push(x_dub);
     }
-    else if (instr.opcode() == OpCode::TOSTR) {
+    else if (opcode == OpCode::TOSTR) {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
       //string x_dub = to_string(get<string>(x));
-      frame->operand_stack.push(to_string(x));
+      string s = to_string(x);
+      run_stats.string_bytes += s.size();
+      frame->operand_stack.push(s);
     }
-    else if(instr.opcode() == OpCode::CONCAT)
+    else if(opcode == OpCode::CONCAT)
     {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
@@ -400,9 +912,11 @@ void VM::run(bool DEBUG)
       VMValue y = frame->operand_stack.top();
       ensure_not_null(*frame, y);
       frame->operand_stack.pop();
-      frame->operand_stack.push(get<string>(y) + get<string>(x));
+      string s = get<string>(y) + get<string>(x);
+      run_stats.string_bytes += s.size();
+      frame->operand_stack.push(s);
     }
-    else if(instr.opcode() == OpCode::GETC)
+    else if(opcode == OpCode::GETC)
     {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
@@ -413,6 +927,7 @@ void VM::run(bool DEBUG)
       frame->operand_stack.pop();
 
       string x_str = get<string>(x);
+      run_stats.string_bytes += x_str.size();
       int size = x_str.size();
       if(get<int>(y) >= size) {
         string msg = "out-of-bounds string index";
@@ -434,33 +949,54 @@ void VM::run(bool DEBUG)
     //----------------------------------------------------------------------
 
     // TODO: Finish ALLOCS, ALLOCA, ADDF, SETF, GETF, SETI, GETI
-    else if(instr.opcode() == OpCode::ALLOCS)
+    else if(opcode == OpCode::ALLOCS)
     {
       struct_heap[next_obj_id] = {};
+      ++run_stats.struct_objects;
+      run_stats.struct_bytes += STRUCT_BYTES;
+      if (heap_profiler) {
+        optional<VMValue> type = instr.operand();
+        heap_profiler->allocate(next_obj_id, *frame->info, pc - 1,
+          type ? string(code->symbols()->name(get<int>(*type))) : "struct",
+          STRUCT_BYTES);
+      }
       frame->operand_stack.push(next_obj_id);
+      note_operands(*frame);
       ++next_obj_id;
     }
-    else if(instr.opcode() == OpCode::ALLOCA)
+    else if(opcode == OpCode::ALLOCA)
     {
       VMValue val = frame->operand_stack.top();
       frame->operand_stack.pop();
       int size = get<int>(frame->operand_stack.top());
       frame->operand_stack.pop();
       array_heap[next_obj_id] = vector<VMValue>(size, val);
+      ++run_stats.array_objects;
+      run_stats.array_bytes += array_bytes(size);
+      if (heap_profiler)
+        heap_profiler->allocate(next_obj_id, *frame->info, pc - 1,
+                                "array", array_bytes(size));
       frame->operand_stack.push(next_obj_id);
       ++next_obj_id;
     }
-    else if(instr.opcode() == OpCode::ADDF)
+    else if(opcode == OpCode::ADDF)
     {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
       frame->operand_stack.pop();
 
       int i = get<int>(x);
-      struct_heap[i][get<string>(instr.operand().value())];
+      auto& fields = struct_heap[i];
+      size_t count = fields.size();
+      fields[get<int>(instr.operand().value())];
+      if (fields.size() > count) {
+        run_stats.struct_bytes += FIELD_BYTES;
+        if (heap_profiler)
+          heap_profiler->grow(i, FIELD_BYTES);
+      }
     }
 
-    else if(instr.opcode() == OpCode::SETF)
+    else if(opcode == OpCode::SETF)
     {
       VMValue x = frame->operand_stack.top();
       //ensure_not_null(*frame, x);
@@ -471,20 +1007,20 @@ void VM::run(bool DEBUG)
       frame->operand_stack.pop();
 
       int i = get<int>(y);
-      struct_heap[i][get<string>(instr.operand().value())] = x;
+      struct_heap[i][get<int>(instr.operand().value())] = x;
     }
 
-    else if(instr.opcode() == OpCode::GETF)
+    else if(opcode == OpCode::GETF)
     {
       VMValue x = frame->operand_stack.top();
       //ensure_not_null(*frame, x);
       frame->operand_stack.pop();
 
       int i = get<int>(x);
-      frame->operand_stack.push(struct_heap[i][get<string>(instr.operand().value())]);
+      frame->operand_stack.push(struct_heap[i][get<int>(instr.operand().value())]);
     }
 
-    else if(instr.opcode() == OpCode::SETI)
+    else if(opcode == OpCode::SETI)
     {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
@@ -512,7 +1048,7 @@ void VM::run(bool DEBUG)
       }
     }
 
-    else if(instr.opcode() == OpCode::GETI)
+    else if(opcode == OpCode::GETI)
     {
       VMValue x = frame->operand_stack.top();
       ensure_not_null(*frame, x);
@@ -541,19 +1077,20 @@ void VM::run(bool DEBUG)
     //----------------------------------------------------------------------
 
     
-    else if (instr.opcode() == OpCode::DUP) {
+    else if (opcode == OpCode::DUP) {
       VMValue x = frame->operand_stack.top();
       frame->operand_stack.pop();
       frame->operand_stack.push(x);
       frame->operand_stack.push(x);      
+      note_operands(*frame);
     }
 
-    else if (instr.opcode() == OpCode::NOP) {
+    else if (opcode == OpCode::NOP) {
       // do nothing
     }
     
     else {
-      error("unsupported operation " + to_string(instr));
+      error("unsupported operation " + to_string(instr, symbols().get()));
     }
   }
 }
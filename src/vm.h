@@ -8,33 +8,170 @@
 #ifndef VM_H
 #define VM_H
 
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
 #include <memory>
+#include <set>
 #include <stack>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include "vm_instr.h"
 #include "vm_frame.h"
+#include "profiler.h"
+#include "sampler.h"
+#include "tracer.h"
+#include "perf_map.h"
+#include "perf_counters.h"
+#include "heap_profiler.h"
+#include "vm_stats.h"
+#include "module.h"
 
 
 class VM
 {
 public:
 
-  // add a new frame type to the vm
+  // a vm with its own (empty) module to add code to
+  VM();
+
+  // an isolate running the shared module, with its own heap and call
+  // stack (vms sharing a module can run on different threads)
+  explicit VM(std::shared_ptr<const Module> module);
+
+  // frames are indexed by address, so vms are never copied
+  VM(const VM&) = delete;
+  VM& operator=(const VM&) = delete;
+
+  // add a new frame type to the vm (throws a vm error once the vm's
+  // module is shared)
   void add(const VMFrameInfo& frame);
+  void add(VMFrameInfo&& frame);
+
+  // add a struct shape to the vm
+  void add(const VMStructInfo& info);
+
+  // share the vm's module (generating the bodies of any stub frames
+  // first), after which its code can't change
+  std::shared_ptr<const Module> module();
+
+  // called with the function's name the first time a stub frame is
+  // called, to add the function's real frame
+  typedef std::function<void(Symbol)> Loader;
+  void set_loader(const Loader& loader);
+
+  // the interner holding the symbols of the vm's code (the module's),
+  // which programs added to the vm are lexed with
+  std::shared_ptr<Interner> symbols() const;
 
-  // run the virtual machine
+  // use the interner (a program's) for the symbols of the vm's code
+  // (throws a vm error if the vm already has code with other symbols)
+  void set_symbols(std::shared_ptr<Interner> symbols);
+
+  // the frame "templates" identified by function name
+  const std::unordered_map<std::string, VMFrameInfo>& frames() const;
+
+  // the struct shapes identified by struct name
+  const std::unordered_map<std::string, VMStructInfo>& structs() const;
+
+  // run the virtual machine (a debug run, or one with hooks,
+  // breakpoints, or a profiler, runs a separately compiled loop that
+  // checks them before each instruction; other runs pay nothing for
+  // them)
   void run(bool DEBUG = false);
 
+  // a function the host can call (see lookup)
+  class Function
+  {
+  public:
+    Symbol name = Symbols::NONE;
+  };
+
+  // the named function (throws a vm error if there is no such
+  // function)
+  Function lookup(const std::string& name) const;
+
+  // run the function with the arguments (checks and hooks as in run),
+  // returning its return value. The heap, and the frames of functions
+  // called this way, are kept from call to call.
+  VMValue call(Function function, const std::vector<VMValue>& args);
+  VMValue call(const std::string& name, const std::vector<VMValue>& args);
+
+  // free every struct and array object (so object ids start over)
+  void reset_heap();
+
+  // where print writes and input reads (cout and cin by default)
+  void set_output(std::ostream& out);
+  void set_input(std::istream& in);
+
+  // tag each object the following runs allocate with its allocation
+  // site in the heap profiler (nullptr to stop)
+  void set_heap_profiler(HeapProfiler* heap_profiler);
+
+  // read the counters around each function activation of the
+  // following runs (nullptr to stop)
+  void set_counters(PerfCounters* counters);
+
+  // run each function call of the following runs through its
+  // trampoline in the perf map, so perf can tell the functions apart
+  // (nullptr to stop). Each call then nests on the native stack, so
+  // calls past MAX_PERF_NESTING deep run in their caller's loop (and
+  // are attributed to its trampoline) instead.
+  void set_perf_map(PerfMap* perf_map);
+
+  // called with the running frame (whose pc is that of the
+  // instruction) before an instruction executes in debug runs
+  typedef std::function<void(const VMFrame&, const VMInstr&)> Hook;
+
+  // call the hook before each instruction (instead of a debug run
+  // printing each frame), nullptr to stop
+  void set_step_hook(const Hook& hook);
+
+  // call the hook before each instruction at a breakpoint (instead of
+  // printing the frame), nullptr to stop
+  void set_break_hook(const Hook& hook);
+
+  // stop before the function's instruction at pc
+  void add_breakpoint(const std::string& function, int pc);
+  void remove_breakpoint(const std::string& function, int pc);
+  void clear_breakpoints();
+
+  // the frame's function, pc, and next instruction, its operand stack
+  // (bottom to top), and its variables
+  std::string dump(const VMFrame& frame) const;
+
+  // the number of instructions executed by run (so far)
+  uint64_t instruction_count() const;
+
+  // the counters of the runs so far (always kept), and the phase times
+  // added by the vm's owner
+  const VMStats& stats() const;
+
+  // add time spent in a phase (e.g., compiling) to the stats
+  void add_phase_time(const std::string& phase, uint64_t ns);
+
+  // profile the following runs with the profiler (nullptr to stop)
+  void set_profiler(Profiler* profiler);
+
+  // keep the sampler's view of the call stack current during the
+  // following runs (nullptr to stop)
+  void set_sampler(Sampler* sampler);
+
+  // log each call (and the generation of stub frames) of the following
+  // runs to the tracer (nullptr to stop)
+  void set_tracer(Tracer* tracer);
+
   // to print the instructions for each VM frame
   friend std::string to_string(const VM& vm);
 
   
 private:
 
-  // heap for struct objects mapping oid's to field values
-  std::unordered_map<int, std::unordered_map<std::string, VMValue>> struct_heap;
+  // heap for struct objects mapping oid's to field values (by field
+  // symbol)
+  std::unordered_map<int, std::unordered_map<Symbol, VMValue>> struct_heap;
 
   // heap for array objects
   std::unordered_map<int, std::vector<VMValue>> array_heap;
@@ -42,8 +179,93 @@ private:
   // next available object id 
   int next_obj_id = 2023;
 
-  // collection of frame "templates" identified by function name
-  std::unordered_map<std::string, VMFrameInfo> frame_info;
+  // the frame "templates" and struct shapes of the program
+  std::shared_ptr<const Module> code;
+
+  // the module, while the vm owns it alone and can add code to it
+  // (nullptr once shared)
+  Module* own_code = nullptr;
+
+  // the module to add code to (throws a vm error if it is shared)
+  Module& editable();
+
+  // the frame template of the function (or an empty one if undefined)
+  const VMFrameInfo& function(Symbol name) const;
+
+  // generates the bodies of stub frames
+  Loader loader = nullptr;
+
+  // the frame template of the function to call (loading it first if
+  // it is a stub)
+  const VMFrameInfo& callable(Symbol name);
+
+  // counters of the runs so far
+  VMStats run_stats;
+
+  Profiler* profiler = nullptr;
+
+  Sampler* sampler = nullptr;
+
+  Tracer* tracer = nullptr;
+
+  // debugging hooks and breakpoints (by function name)
+  Hook step_hook = nullptr;
+  Hook break_hook = nullptr;
+  std::unordered_map<std::string, std::set<int>> breakpoints;
+
+  PerfMap* perf_map = nullptr;
+
+  // the most trampolines nested on the native stack at once, and the
+  // number nested now
+  static const size_t MAX_PERF_NESTING = 1000;
+  size_t perf_nesting = 0;
+
+  PerfCounters* counters = nullptr;
+
+  HeapProfiler* heap_profiler = nullptr;
+
+  // an error thrown by a function run through a trampoline (which
+  // exceptions can't unwind through), rethrown once it returns
+  std::exception_ptr nested_error = nullptr;
+
+  // frames of the functions the host calls, reused by the next call
+  // (by function symbol)
+  std::unordered_map<Symbol, std::shared_ptr<VMFrame>> warm_frames;
+
+  std::ostream* output = &std::cout;
+  std::istream* input = &std::cin;
+
+  // the call stack depth below the function run or called by the host,
+  // and the value it returned
+  size_t entry_depth = 0;
+  VMValue returned = nullptr;
+
+  // true if a run needs the loop with the debugging checks (for a
+  // debug run, hooks, breakpoints, or a profiler)
+  bool debugging(bool DEBUG) const;
+
+  // the run loop over the function's (pushed) frame, with the
+  // debugging checks only if Debug (printing each frame if print and
+  // there is no step hook), returning its return value
+  template<bool Debug>
+  VMValue execute(const VMFrameInfo& info, std::shared_ptr<VMFrame> frame,
+                  bool print);
+
+  // run the top frame until it returns, along with the functions it
+  // calls (unless they run through trampolines)
+  template<bool Debug>
+  void loop(bool print);
+
+  // run the pushed frame of the function through its trampoline
+  template<bool Debug>
+  void call_through(const VMFrameInfo& info, bool print);
+
+  // the trampolines' entry (runs the loop, keeping any error)
+  template<bool Debug>
+  static void run_nested(VM* vm, bool print);
+
+  // run the hooks (or print) for the instruction about to execute
+  void debug(const VMFrame& frame, const VMInstr& instr, bool print);
 
   // VM function call stack
   std::stack<std::shared_ptr<VMFrame>> call_stack;
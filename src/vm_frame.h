@@ -9,6 +9,7 @@
 #ifndef VM_FRAME_H
 #define VM_FRAME_H
 
+#include <algorithm>
 #include <stack>
 #include <string>
 #include <vector>
@@ -18,6 +19,21 @@
 // The following are plain-old-data classes
 
 
+// the source position of a run of instructions generated from the
+// same line (starting at pc and ending at the next run)
+class VMLine
+{
+public:
+
+  int pc;
+
+  int line;
+
+  int column;
+
+};
+
+
 class VMFrameInfo
 {
 public:
@@ -31,6 +47,34 @@ public:
   // the program instructions
   std::vector<VMInstr> instructions;  
 
+  // true if the body has not been generated yet (see VM::set_loader)
+  bool stub = false;
+
+  // the source positions of the instructions, as runs sorted by pc
+  // (empty if unknown)
+  std::vector<VMLine> lines;
+
+  // the source line of the instruction at pc (0 if unknown)
+  int line(int pc) const
+  {
+    auto run = std::upper_bound(lines.begin(), lines.end(), pc,
+      [](int pc, const VMLine& l) {return pc < l.pc;});
+    return run == lines.begin() ? 0 : (run - 1)->line;
+  }
+
+};
+
+
+class VMStructInfo
+{
+public:
+
+  // the name of the struct type
+  std::string struct_name;
+
+  // the field names, in declaration order
+  std::vector<std::string> fields;
+
 };
 
 
@@ -38,8 +82,9 @@ class VMFrame
 {
 public:
 
-  // the type of the current frame
-  VMFrameInfo info;
+  // the type of the current frame (the module's frame template, which
+  // outlives its frames)
+  const VMFrameInfo* info = nullptr;
   
   // the program counter
   int pc = 0;
@@ -46,6 +46,14 @@ std::optional<VMValue> VMInstr::operand() const
 }
 
 
+bool VMInstr::has_symbol_operand(OpCode opcode)
+{
+  return opcode == OpCode::CALL or opcode == OpCode::ADDF or
+    opcode == OpCode::SETF or opcode == OpCode::GETF or
+    opcode == OpCode::ALLOCS;
+}
+
+
 void VMInstr::set_operand(VMValue value)
 {
   instr_operand = value;
@@ -166,9 +174,9 @@ VMInstr VMInstr::JMPF(int instruction_index)
 }
 
 
-VMInstr VMInstr::CALL(const std::string& function)
+VMInstr VMInstr::CALL(Symbol function)
 {
-  return VMInstr(OpCode::CALL, function);
+  return VMInstr(OpCode::CALL, (int)function);
 }
 
 
@@ -238,27 +246,33 @@ VMInstr VMInstr::ALLOCS()
 }
 
 
+VMInstr VMInstr::ALLOCS(Symbol type)
+{
+  return VMInstr(OpCode::ALLOCS, (int)type);
+}
+
+
 VMInstr VMInstr::ALLOCA()
 {
   return VMInstr(OpCode::ALLOCA);    
 }
 
 
-VMInstr VMInstr::ADDF(const string& field)
+VMInstr VMInstr::ADDF(Symbol field)
 {
-  return VMInstr(OpCode::ADDF, field);
+  return VMInstr(OpCode::ADDF, (int)field);
 }
 
 
-VMInstr VMInstr::SETF(const string& field)
+VMInstr VMInstr::SETF(Symbol field)
 {
-  return VMInstr(OpCode::SETF, field);      
+  return VMInstr(OpCode::SETF, (int)field);
 }
 
 
-VMInstr VMInstr::GETF(const string& field)
+VMInstr VMInstr::GETF(Symbol field)
 {
-  return VMInstr(OpCode::GETF, field);
+  return VMInstr(OpCode::GETF, (int)field);
 }
 
 
@@ -302,9 +316,9 @@ string to_string(const VMValue& val) {
 }
 
 
-std::string to_string(const VMInstr& instr)
+std::string to_string(OpCode opcode)
 {
-  std::unordered_map<OpCode, string> os = {
+  static const std::unordered_map<OpCode, string> os = {
     {OpCode::PUSH, "PUSH"}, {OpCode::POP, "POP"},
     {OpCode::LOAD, "LOAD"}, {OpCode::STORE, "STORE"},
     {OpCode::ADD, "ADD"}, {OpCode::SUB, "SUB"},
@@ -326,11 +340,22 @@ std::string to_string(const VMInstr& instr)
     {OpCode::SETI, "SETI"}, {OpCode::DUP, "DUP"},
     {OpCode::NOP, "NOP"}
   };
+  return os.at(opcode);
+}
+
+
+std::string to_string(const VMInstr& instr, const Interner* symbols)
+{
   string vstr = "";
   if (instr.operand().has_value()) {
-    vstr = to_string(instr.operand().value());
+    VMValue v = instr.operand().value();
+    if (symbols != nullptr and VMInstr::has_symbol_operand(instr.opcode()) and
+        holds_alternative<int>(v))
+      vstr = symbols->name(get<int>(v));
+    else
+      vstr = to_string(v);
   }
-  string s = os[instr.opcode()] + "(" + vstr + ")";
+  string s = to_string(instr.opcode()) + "(" + vstr + ")";
   if (instr.instr_comment != "")
     s += "  // " + instr.instr_comment;
   return s;
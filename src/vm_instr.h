@@ -12,6 +12,7 @@
 #include <variant>
 #include <optional>
 #include <string>
+#include "interner.h"
 #include "op_code.h"
 
 
@@ -21,6 +22,9 @@ typedef std::variant<int, double, bool, std::string, std::nullptr_t> VMValue;
 // function to get a string representation of a vm_value
 std::string to_string(const VMValue& val);
 
+// the name of the opcode (e.g., "PUSH")
+std::string to_string(OpCode opcode);
+
 
 class VMInstr
 {
@@ -46,7 +50,7 @@ public:
   static VMInstr CMPNE();
   static VMInstr JMP(int instruction_index);
   static VMInstr JMPF(int instruction_index);
-  static VMInstr CALL(const std::string& function);
+  static VMInstr CALL(Symbol function);
   static VMInstr RET();
   static VMInstr WRITE();
   static VMInstr READ();
@@ -58,10 +62,11 @@ public:
   static VMInstr TOSTR();
   static VMInstr CONCAT();
   static VMInstr ALLOCS();
+  static VMInstr ALLOCS(Symbol type);
   static VMInstr ALLOCA();
-  static VMInstr ADDF(const std::string& field);
-  static VMInstr SETF(const std::string& field);
-  static VMInstr GETF(const std::string& field);
+  static VMInstr ADDF(Symbol field);
+  static VMInstr SETF(Symbol field);
+  static VMInstr GETF(Symbol field);
   static VMInstr SETI();
   static VMInstr GETI();  
   static VMInstr DUP();
@@ -76,14 +81,23 @@ public:
   // returns the instruction's opcode
   OpCode opcode() const;
 
-  // returns the operand for those instructions with operands
+  // returns the operand for those instructions with operands (CALL,
+  // ADDF, SETF, and GETF operands, and the struct type of ALLOCS, are
+  // interned names stored as ints)
   std::optional<VMValue> operand() const;
 
+  // true if the opcode's operand is an interned name
+  static bool has_symbol_operand(OpCode opcode);
+
   // set the operand value
   void set_operand(VMValue value);
   
-  // pretty print the instruction
-  friend std::string to_string(const VMInstr& instr);
+  // pretty print the instruction (see below)
+  friend std::string to_string(const VMInstr& instr,
+                               const Interner* symbols);
+
+  // the bytecode loader rebuilds instructions directly from opcodes
+  friend class Bytecode;
   
 private:
 
@@ -105,4 +119,9 @@ private:
 };
 
 
+// pretty print the instruction (with the names of interned operands
+// if given the symbols they come from)
+std::string to_string(const VMInstr& instr, const Interner* symbols = nullptr);
+
+
 #endif
@@ -0,0 +1,49 @@
+//----------------------------------------------------------------------
+// FILE: vm_stats.cpp
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: VMStats implementation
+//----------------------------------------------------------------------
+
+#include <iomanip>
+#include "vm_stats.h"
+
+using namespace std;
+
+
+void VMStats::add_phase(const string& phase, uint64_t ns)
+{
+  for (auto& [name, total] : phase_ns) {
+    if (name == phase) {
+      total += ns;
+      return;
+    }
+  }
+  phase_ns.push_back({phase, ns});
+}
+
+
+void VMStats::report(ostream& out) const
+{
+  ios_base::fmtflags flags = out.flags();
+  auto row = [&](const string& name, uint64_t value) {
+    out << "  " << left << setw(28) << name << right << setw(14) << value
+        << endl;
+  };
+  out << endl << "Stats" << endl;
+  row("instructions", instructions);
+  row("calls", calls);
+  row("max call depth", max_call_depth);
+  row("max operand depth", max_operand_depth);
+  row("struct objects", struct_objects);
+  row("struct bytes", struct_bytes);
+  row("array objects", array_objects);
+  row("array bytes", array_bytes);
+  row("string bytes", string_bytes);
+  if (!phase_ns.empty()) {
+    out << "Phases (us)" << endl;
+    for (const auto& [name, ns] : phase_ns)
+      row(name, ns / 1000);
+  }
+  out.flags(flags);
+}
@@ -0,0 +1,55 @@
+//----------------------------------------------------------------------
+// FILE: vm_stats.h
+// DATE: CPSC 326, Spring 2023
+// AUTH: Jackie Ramsey
+// DESC: Counters the vm keeps in every run (see VM::stats), along with
+// the time spent in each phase of the pipeline that ran it.
+//----------------------------------------------------------------------
+
+#ifndef VM_STATS_H
+#define VM_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+class VMStats
+{
+public:
+
+  // instructions executed and functions called (including main)
+  uint64_t instructions = 0;
+  uint64_t calls = 0;
+
+  // the deepest call stack, and deepest operand stack of any frame
+  size_t max_call_depth = 0;
+  size_t max_operand_depth = 0;
+
+  // objects allocated and their (approximate) heap bytes, by kind
+  uint64_t struct_objects = 0;
+  uint64_t struct_bytes = 0;
+  uint64_t array_objects = 0;
+  uint64_t array_bytes = 0;
+
+  // bytes of the strings built or copied by the string instructions
+  // (e.g., CONCAT and TOSTR)
+  uint64_t string_bytes = 0;
+
+  // nanoseconds spent in each phase (e.g., "check"), in the order the
+  // phases first ran
+  std::vector<std::pair<std::string, uint64_t>> phase_ns;
+
+  // add time to the phase
+  void add_phase(const std::string& phase, uint64_t ns);
+
+  // write the counters and phase times
+  void report(std::ostream& out) const;
+
+};
+
+
+#endif
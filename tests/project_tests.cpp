@@ -7,10 +7,14 @@
 
 
 
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <gtest/gtest.h>
+#include <unistd.h>
 #include "mypl_exception.h"
 #include "lexer.h"
 #include "simple_parser.h"
@@ -18,6 +22,21 @@
 #include "vm.h"
 #include "code_generator.h"
 #include "semantic_checker.h"
+#include "bytecode.h"
+#include "compile_cache.h"
+#include "bundle.h"
+#include "thread_pool.h"
+#include "print_visitor.h"
+#include "incremental.h"
+#include "program_generator.h"
+#include "profiler.h"
+#include "sampler.h"
+#include "tracer.h"
+#include "perf_map.h"
+#include "perf_counters.h"
+#include "heap_profiler.h"
+#include "module.h"
+#include "server.h"
 
 using namespace std;
 
@@ -170,6 +189,74 @@ TEST(BasicLexerTest, SwitchWords) {
 
 
 
+TEST(BasicLexerTest, LongLexemes) {
+  // long enough to exercise the 16-byte scanning paths
+  stringstream in("                    abcdefghijklmnopqrstuvwxyz_01 "
+                  "\"a long string with a \\ backslash in it\" "
+                  "12345678901234567890.25 # a comment that runs to the end");
+  Lexer lexer(in);
+  Token t = lexer.next_token();
+  ASSERT_EQ(TokenType::ID, t.type());
+  ASSERT_EQ("abcdefghijklmnopqrstuvwxyz_01", t.lexeme());
+  ASSERT_EQ(21, t.column());
+  t = lexer.next_token();
+  ASSERT_EQ(TokenType::STRING_VAL, t.type());
+  ASSERT_EQ("a long string with a \\ backslash in it", t.lexeme());
+  ASSERT_EQ(51, t.column());
+  t = lexer.next_token();
+  ASSERT_EQ(TokenType::DOUBLE_VAL, t.type());
+  ASSERT_EQ("12345678901234567890.25", t.lexeme());
+  t = lexer.next_token();
+  ASSERT_EQ(TokenType::EOS, t.type());
+}
+
+TEST(BasicLexerTest, KeywordNearMisses) {
+  stringstream in("switches cas breaks default_ defaults elsif");
+  Lexer lexer(in);
+  for (int i = 0; i < 6; ++i)
+    ASSERT_EQ(TokenType::ID, lexer.next_token().type());
+  ASSERT_EQ(TokenType::EOS, lexer.next_token().type());
+}
+
+TEST(BasicLexerTest, LexemesViewSource) {
+  auto source = SourceBuffer::from_string("foo 42 \"bar\"");
+  Lexer lexer(source);
+  Token t = lexer.next_token();
+  ASSERT_EQ("foo", t.lexeme());
+  ASSERT_EQ(source->data(), t.lexeme().data());
+  t = lexer.next_token();
+  ASSERT_EQ("42", t.lexeme());
+  ASSERT_EQ(source->data() + 4, t.lexeme().data());
+  t = lexer.next_token();
+  ASSERT_EQ("bar", t.lexeme());
+  ASSERT_EQ(source->data() + 8, t.lexeme().data());
+}
+
+TEST(BasicLexerTest, SplitKeepsPositions) {
+  auto source = SourceBuffer::from_string(build_string({
+        "struct S { int x }  # a comment with a }",
+        "void f() { print(\"}\\t}\") }",
+        "\tvoid g() { char c = '}' }",
+        "void main() { if (true) { f() } g() }"
+      }));
+  vector<Lexer> chunks = Lexer(source).split(10);
+  ASSERT_EQ(4, chunks.size());
+  Lexer lexer(source);
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    Token t = chunks[i].next_token();
+    while (t.type() != TokenType::EOS) {
+      Token expected = lexer.next_token();
+      ASSERT_EQ(expected.type(), t.type());
+      ASSERT_EQ(expected.lexeme(), t.lexeme());
+      ASSERT_EQ(expected.line(), t.line());
+      ASSERT_EQ(expected.column(), t.column());
+      t = chunks[i].next_token();
+    }
+  }
+  ASSERT_EQ(TokenType::EOS, lexer.next_token().type());
+}
+
+
 //----------------------------------------------------------------------
 // simple_parser.cpp Tests
 //----------------------------------------------------------------------
@@ -716,6 +803,34 @@ TEST(BasicSemanticCheckerTests, EmpytySwitchExpr) {
   }
 }
 
+TEST(BasicSemanticCheckerTests, ConversionChecksItsOwnArgument) {
+  stringstream in(build_string({
+        "void main() {",
+        "  array int xs = new int[2]",
+        "  print(to_string(5))",
+        "}"
+      }));
+  SemanticChecker checker;
+  ASTParser(Lexer(in)).parse().accept(checker);
+}
+
+TEST(BasicSemanticCheckerTests, ConversionOfArrayArgument) {
+  stringstream in(build_string({
+        "void main() {",
+        "  array int xs = new int[2]",
+        "  print(to_string(xs))",
+        "}"
+      }));
+  SemanticChecker checker;
+  try {
+    ASTParser(Lexer(in)).parse().accept(checker);
+    FAIL();
+  } catch (MyPLException& ex) {
+    string msg = ex.what();
+    ASSERT_TRUE(msg.starts_with("Static Error:"));
+  }
+}
+
 
 
 //----------------------------------------------------------------------
@@ -854,6 +969,1599 @@ TEST(BasicCodeGenTest, NoBreakBreak) {
   restore_cout();
 }
 
+TEST(BasicCodeGenTest, SwitchesThenAnotherFunction) {
+  stringstream in(build_string({
+        "void g() {",
+        "  switch(1) {",
+        "    case 1:",
+        "      print(1)",
+        "      break",
+        "  }",
+        "  switch(1) {",
+        "    case 1:",
+        "      print(2)",
+        "      break",
+        "  }",
+        "}",
+        "int twice(int x) {",
+        "  return x * 2",
+        "}",
+        "void main() {",
+        "  g()",
+        "  print(twice(2))",
+        "}"
+      }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("124", out.str());
+  restore_cout();
+}
+
+TEST(BasicCodeGenTest, SkippedElseAndDefaultDeclarations) {
+  stringstream in(build_string({
+        "void main() {",
+        "  if (true) {",
+        "    print(1)",
+        "  }",
+        "  else {",
+        "    int a = 2",
+        "  }",
+        "  switch(0) {",
+        "    case 0:",
+        "      print(2)",
+        "      break",
+        "    default:",
+        "      int b = 3",
+        "  }",
+        "  int c = 3",
+        "  print(c)",
+        "}"
+      }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("123", out.str());
+  restore_cout();
+}
+
+TEST(BasicCodeGenTest, LazyGeneratesCalledFunctions) {
+  stringstream in(build_string({
+        "int unused() {",
+        "  return \"not an int\"",
+        "}",
+        "int twice(int x) {",
+        "  return x * 2",
+        "}",
+        "void main() {",
+        "  print(twice(21))",
+        "}"
+      }));
+  auto p = make_shared<Program>(ASTParser(Lexer(in)).parse());
+  auto checker = make_shared<SemanticChecker>();
+  checker->declare(*p);
+  VM vm;
+  CodeGenerator::generate_lazily(p, vm, checker);
+  ASSERT_TRUE(vm.frames().at("twice").stub);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  EXPECT_EQ("42", out.str());
+  restore_cout();
+  ASSERT_FALSE(vm.frames().at("twice").stub);
+  ASSERT_TRUE(vm.frames().at("unused").stub);
+}
+
+TEST(BasicCodeGenTest, LazyChecksOnFirstCall) {
+  stringstream in(build_string({
+        "int bad(int x) {",
+        "  return \"not an int\"",
+        "}",
+        "void main() {",
+        "  print(bad(1))",
+        "}"
+      }));
+  auto p = make_shared<Program>(ASTParser(Lexer(in)).parse());
+  auto checker = make_shared<SemanticChecker>();
+  checker->declare(*p);
+  VM vm;
+  CodeGenerator::generate_lazily(p, vm, checker);
+  try {
+    vm.run();
+    FAIL();
+  } catch (MyPLException& ex) {
+    EXPECT_EQ("Static Error: invalid return type", string(ex.what()));
+  }
+}
+
+TEST(BasicCodeGenTest, RecordsSourceLines) {
+  stringstream in(build_string({
+        "int f(int x,",
+        "      int y) {",
+        "  int z = x",
+        "  while (z < y) {",
+        "    z = z + 1",
+        "  }",
+        "  return z +",
+        "    null",
+        "}",
+        "void main() {",
+        "  print(f(1, 3))",
+        "}"
+      }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  const VMFrameInfo& f = vm.frames().at("f");
+  vector<int> lines;
+  for (int pc = 0; pc < f.instructions.size(); ++pc)
+    lines.push_back(f.line(pc));
+  // (the jump back to the loop condition is on the condition's line)
+  vector<int> expected {1, 1, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 4, 4, 7, 8, 7,
+                        7};
+  EXPECT_EQ(expected, lines);
+  EXPECT_EQ(0, f.line(-1));
+  EXPECT_EQ(7, f.line(100));
+  // runs of the same line are recorded once
+  EXPECT_EQ(8, f.lines.size());
+  EXPECT_EQ(5, f.lines[0].column);
+  try {
+    vm.run();
+    FAIL();
+  } catch (MyPLException& ex) {
+    EXPECT_NE(string::npos, string(ex.what()).find(", line 7)"));
+  }
+}
+
+//----------------------------------------------------------------------
+// bytecode.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicBytecodeTest, RoundTrip) {
+  stringstream in(build_string({
+        "struct T {int x, string s}",
+        "int f(int y) {",
+        "  return y + 1",
+        "}",
+        "void main() {", 
+        "  T t = new T",
+        "  t.x = f(2)",
+        "  t.s = \"ok\"",
+        "  print(t.x)",
+        "  print(t.s)",
+        "  print(2.5)",
+        "  print(true)",
+        "}"
+      }));
+  VM vm1;
+  CodeGenerator generator(vm1);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  string image = Bytecode::serialize(vm1);
+  VM vm2;
+  Bytecode::load(vm2, image.data(), image.size());
+  EXPECT_EQ(to_string(vm1), to_string(vm2));
+  EXPECT_EQ(1, vm2.structs().size());
+  EXPECT_EQ(2, vm2.structs().at("T").fields.size());
+  EXPECT_EQ(image, Bytecode::serialize(vm2));
+  const VMFrameInfo& main1 = vm1.frames().at("main");
+  const VMFrameInfo& main2 = vm2.frames().at("main");
+  ASSERT_EQ(main1.lines.size(), main2.lines.size());
+  for (size_t i = 0; i < main1.lines.size(); ++i) {
+    EXPECT_EQ(main1.lines[i].pc, main2.lines[i].pc);
+    EXPECT_EQ(main1.lines[i].line, main2.lines[i].line);
+    EXPECT_EQ(main1.lines[i].column, main2.lines[i].column);
+  }
+  stringstream out;
+  change_cout(out);
+  vm2.run();
+  EXPECT_EQ("3ok2.500000true", out.str());
+  restore_cout();
+}
+
+TEST(BasicBytecodeTest, BadImage) {
+  VM vm;
+  string image = "not bytecode at all, just some text that is long enough"
+    " to hold a header but has the wrong magic bytes";
+  try {
+    Bytecode::load(vm, image.data(), image.size());
+    FAIL();
+  } catch (MyPLException& ex) {
+    string msg = ex.what();
+    ASSERT_TRUE(msg.starts_with("Bytecode Error:"));
+  }
+}
+
+TEST(BasicBytecodeTest, TruncatedImage) {
+  stringstream in(build_string({"void main() {", "  print(1)", "}"}));
+  VM vm1;
+  CodeGenerator generator(vm1);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  string image = Bytecode::serialize(vm1);
+  VM vm2;
+  try {
+    Bytecode::load(vm2, image.data(), image.size() / 2);
+    FAIL();
+  } catch (MyPLException& ex) {
+    string msg = ex.what();
+    ASSERT_TRUE(msg.starts_with("Bytecode Error:"));
+  }
+}
+
+//----------------------------------------------------------------------
+// compile_cache.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicCompileCacheTest, KeyCoversSource) {
+  string k1 = CompileCache::key("void main() {}");
+  EXPECT_EQ(64, k1.size());
+  EXPECT_EQ(k1, CompileCache::key("void main() {}"));
+  EXPECT_NE(k1, CompileCache::key("void main() { }"));
+}
+
+TEST(BasicCompileCacheTest, StoreThenLookup) {
+  string dir = testing::TempDir() + "mypl_cache_test_" + to_string(getpid());
+  stringstream in(build_string({"void main() {", "  print(42)", "}"}));
+  VM vm1;
+  CodeGenerator generator(vm1);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  CompileCache cache(dir);
+  string key = CompileCache::key(in.str());
+  VM vm2;
+  EXPECT_FALSE(cache.lookup(key, vm2));
+  cache.store(key, vm1);
+  EXPECT_TRUE(cache.lookup(key, vm2));
+  stringstream out;
+  change_cout(out);
+  vm2.run();
+  EXPECT_EQ("42", out.str());
+  restore_cout();
+  filesystem::remove_all(dir);
+}
+
+TEST(BasicCompileCacheTest, EvictsToSizeBound) {
+  string dir = testing::TempDir() + "mypl_evict_test_" + to_string(getpid());
+  stringstream in(build_string({"void main() {", "  print(42)", "}"}));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  uintmax_t entry_size = Bytecode::serialize(vm).size();
+  CompileCache cache(dir, entry_size * 2);
+  for (int i = 0; i < 5; ++i)
+    cache.store(CompileCache::key(to_string(i)), vm);
+  int count = 0;
+  for ([[maybe_unused]] auto& f : filesystem::directory_iterator(dir))
+    ++count;
+  EXPECT_EQ(2, count);
+  VM vm2;
+  EXPECT_TRUE(cache.lookup(CompileCache::key("4"), vm2));
+  filesystem::remove_all(dir);
+}
+
+TEST(BasicCompileCacheTest, EvictsIncrementalState) {
+  string dir = testing::TempDir() + "mypl_evict_state_test_" +
+    to_string(getpid());
+  stringstream in(build_string({"void main() {", "  print(42)", "}"}));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  uintmax_t entry_size = Bytecode::serialize(vm).size();
+  CompileCache cache(dir, entry_size * 2);
+  // state files older than the entries are evicted first
+  auto old = filesystem::file_time_type::clock::now() - chrono::hours(1);
+  for (int i = 0; i < 3; ++i) {
+    string state = dir + "/" + to_string(i) + INCREMENTAL_EXT;
+    ofstream(state) << string(entry_size, 'x');
+    filesystem::last_write_time(state, old);
+  }
+  cache.store(CompileCache::key("0"), vm);
+  cache.store(CompileCache::key("1"), vm);
+  int count = 0;
+  for (auto& f : filesystem::directory_iterator(dir)) {
+    EXPECT_EQ(BYTECODE_EXT, f.path().extension());
+    ++count;
+  }
+  EXPECT_EQ(2, count);
+  filesystem::remove_all(dir);
+}
+
+//----------------------------------------------------------------------
+// bundle.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicBundleTest, PlainExecutableHasNoProgram) {
+  VM vm;
+  EXPECT_FALSE(Bundle::load(vm, Bundle::self_path()));
+  EXPECT_EQ(0, vm.frames().size());
+}
+
+TEST(BasicBundleTest, WriteThenLoad) {
+  string runtime = testing::TempDir() + "mypl_runtime_" + to_string(getpid());
+  string bundled = testing::TempDir() + "mypl_bundle_" + to_string(getpid());
+  {
+    ofstream out(runtime, ios::binary);
+    out << "not really an executable";
+  }
+  stringstream in(build_string({"void main() {", "  print(7)", "}"}));
+  VM vm1;
+  CodeGenerator generator(vm1);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  Bundle::write(vm1, runtime, bundled);
+  // bundling a bundle replaces the program rather than stacking them
+  Bundle::write(vm1, bundled, bundled + "2");
+  EXPECT_EQ(filesystem::file_size(bundled), filesystem::file_size(bundled + "2"));
+  VM vm2;
+  EXPECT_TRUE(Bundle::load(vm2, bundled + "2"));
+  stringstream out;
+  change_cout(out);
+  vm2.run();
+  EXPECT_EQ("7", out.str());
+  restore_cout();
+  filesystem::remove(runtime);
+  filesystem::remove(bundled);
+  filesystem::remove(bundled + "2");
+}
+
+//----------------------------------------------------------------------
+// arena.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicArenaTest, MakeAndDestroy) {
+  int destroyed = 0;
+  struct Counted {
+    int& count;
+    ~Counted() {++count;}
+  };
+  {
+    Arena arena;
+    for (int i = 0; i < 10000; ++i)
+      arena.make<Counted>(destroyed);
+    int* big = (int*)arena.allocate(2 * Arena::BLOCK_SIZE, alignof(int));
+    big[0] = 1;
+    ASSERT_EQ(0, destroyed);
+    ASSERT_LT(arena.block_count(), 10);
+  }
+  ASSERT_EQ(10000, destroyed);
+}
+
+TEST(BasicArenaTest, ParsedNodesLiveInArena) {
+  stringstream in(build_string({
+        "void main() {",
+        "  int x = f(1, 2)",
+        "  while (x > 0) {",
+        "    x = x - 1",
+        "  }",
+        "}"
+      }));
+  Program p = ASTParser(Lexer(in)).parse();
+  FunDef& f = p.fun_defs[0];
+  ASSERT_EQ(p.arena.get(), f.stmts.get_allocator().arena);
+  WhileStmt& w = (WhileStmt&)*f.stmts[1];
+  ASSERT_EQ(p.arena.get(), w.stmts.get_allocator().arena);
+  // copies made after parsing don't share the arena
+  Program q = p;
+  ASSERT_EQ(nullptr, q.fun_defs[0].stmts.get_allocator().arena);
+  ASSERT_EQ(f.stmts[0], q.fun_defs[0].stmts[0]);
+}
+
+//----------------------------------------------------------------------
+// interner.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicInternerTest, FixedAndNewSymbols) {
+  Interner interner;
+  ASSERT_EQ(Symbols::INT, interner.intern("int"));
+  ASSERT_EQ(Symbols::CONCAT, interner.intern("concat"));
+  ASSERT_EQ("main", interner.name(Symbols::MAIN));
+  Symbol s = interner.intern("an_interned_name");
+  ASSERT_GT(s, Symbols::CONCAT);
+  ASSERT_EQ(s, interner.intern(string("an_interned") + "_name"));
+  ASSERT_EQ("an_interned_name", interner.name(s));
+  ASSERT_EQ(s, interner.find("an_interned_name"));
+  ASSERT_EQ(Symbols::NONE, interner.find("never_interned"));
+}
+
+TEST(BasicInternerTest, TokensCarrySymbols) {
+  stringstream in("x int x 42");
+  Lexer lexer(in);
+  Token t1 = lexer.next_token();
+  Token t2 = lexer.next_token();
+  Token t3 = lexer.next_token();
+  Token t4 = lexer.next_token();
+  ASSERT_EQ(lexer.symbols()->find("x"), t1.symbol());
+  ASSERT_EQ(Symbols::INT, t2.symbol());
+  ASSERT_EQ(t1.symbol(), t3.symbol());
+  ASSERT_EQ(Symbols::NONE, t4.symbol());
+}
+
+TEST(BasicInternerTest, ModulesOwnTheirSymbols) {
+  shared_ptr<const Module> m1 = Module::compile(
+    "int only_in_one() { return 1 }");
+  shared_ptr<const Module> m2 = Module::compile(
+    "int only_in_two() { return 2 }");
+  ASSERT_NE(m1->symbols(), m2->symbols());
+  ASSERT_EQ(Symbols::NONE, m2->symbols()->find("only_in_one"));
+  ASSERT_EQ(1, get<int>(VM(m1).call("only_in_one", {})));
+  ASSERT_THROW(VM(m1).lookup("only_in_two"), MyPLException);
+  // a program lexed with other symbols can't join a vm's code
+  VM vm;
+  Module::compile(vm, "int f() { return 1 }");
+  stringstream in("int g() { return 2 }");
+  Program p = ASTParser(Lexer(in)).parse();
+  CodeGenerator generator(vm);
+  ASSERT_THROW(p.accept(generator), MyPLException);
+}
+
+//----------------------------------------------------------------------
+// thread_pool.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicThreadPoolTest, RunsEachTaskOnce) {
+  ThreadPool pool(4);
+  ASSERT_EQ(4, pool.size());
+  vector<int> hits(1000, 0);
+  for (int batch = 0; batch < 3; ++batch)
+    pool.run(hits.size(), [&](size_t worker, size_t i) {
+      ASSERT_LT(worker, pool.size());
+      ++hits[i];
+    });
+  for (int h : hits)
+    ASSERT_EQ(3, h);
+  EXPECT_THROW(pool.run(10, [](size_t, size_t i) {
+    if (i == 5) throw MyPLException::VMError("task failed");
+  }), MyPLException);
+}
+
+// a program of n functions each calling the previous one, where the
+// bad functions use an undefined variable
+string many_functions(int n, const vector<int>& bad = {})
+{
+  string s = "int f0(int x) { return x }\n";
+  for (int i = 1; i < n; ++i) {
+    string arg = count(bad.begin(), bad.end(), i) ? "y" : "x";
+    string body = "return f" + to_string(i - 1) + "(" + arg + " + 1)";
+    s += "int f" + to_string(i) + "(int x) { " + body + " }\n";
+  }
+  s += "void main() { print(f" + to_string(n - 1) + "(0)) }\n";
+  return s;
+}
+
+TEST(BasicThreadPoolTest, ParallelCompileMatchesSerial) {
+  stringstream in1(many_functions(300));
+  stringstream in2(many_functions(300));
+  Program p1 = ASTParser(Lexer(in1)).parse();
+  Program p2 = ASTParser(Lexer(in2)).parse();
+  ThreadPool pool(4);
+  SemanticChecker checker1;
+  SemanticChecker checker2(&pool);
+  p1.accept(checker1);
+  p2.accept(checker2);
+  VM vm1;
+  VM vm2;
+  CodeGenerator generator1(vm1);
+  CodeGenerator generator2(vm2, &pool);
+  p1.accept(generator1);
+  p2.accept(generator2);
+  ASSERT_EQ(to_string(vm1), to_string(vm2));
+  stringstream out;
+  change_cout(out);
+  vm2.run();
+  EXPECT_EQ("299", out.str());
+  restore_cout();
+}
+
+TEST(BasicThreadPoolTest, ParallelParseMatchesSerial) {
+  // big enough to be split into chunks
+  string source = many_functions(8000);
+  ThreadPool pool(4);
+  stringstream in1(source);
+  stringstream in2(source);
+  Program p1 = ASTParser(Lexer(in1)).parse();
+  Program p2 = ASTParser(Lexer(in2), &pool).parse();
+  stringstream out1;
+  stringstream out2;
+  PrintVisitor v1(out1);
+  PrintVisitor v2(out2);
+  p1.accept(v1);
+  p2.accept(v2);
+  ASSERT_EQ(out1.str(), out2.str());
+  // errors are reported from the first bad definition
+  source.insert(source.find("int f7000"), "int 7000");
+  source.insert(source.find("int f5000"), "@");
+  stringstream in3(source);
+  stringstream in4(source);
+  string serial_error;
+  string parallel_error;
+  try {
+    ASTParser(Lexer(in3)).parse();
+  } catch (MyPLException& ex) {
+    serial_error = ex.what();
+  }
+  try {
+    ASTParser(Lexer(in4), &pool).parse();
+  } catch (MyPLException& ex) {
+    parallel_error = ex.what();
+  }
+  ASSERT_NE(string::npos, serial_error.find("line 5001"));
+  ASSERT_EQ(serial_error, parallel_error);
+}
+
+TEST(BasicThreadPoolTest, ParallelCheckReportsFirstError) {
+  for (int i = 0; i < 5; ++i) {
+    stringstream in1(many_functions(300, {40, 41, 299}));
+    stringstream in2(many_functions(300, {40, 41, 299}));
+    Program p1 = ASTParser(Lexer(in1)).parse();
+    Program p2 = ASTParser(Lexer(in2)).parse();
+    string serial_error;
+    string parallel_error;
+    try {
+      SemanticChecker checker;
+      p1.accept(checker);
+    } catch (MyPLException& ex) {
+      serial_error = ex.what();
+    }
+    try {
+      ThreadPool pool(4);
+      SemanticChecker checker(&pool);
+      p2.accept(checker);
+    } catch (MyPLException& ex) {
+      parallel_error = ex.what();
+    }
+    ASSERT_NE(string::npos, serial_error.find("line 41"));
+    ASSERT_EQ(serial_error, parallel_error);
+  }
+}
+
+//----------------------------------------------------------------------
+// incremental.cpp Tests
+//----------------------------------------------------------------------
+
+// parse the source with its definitions fingerprinted (and lexed with
+// the compiler's symbols)
+Program parse_fingerprinted(const IncrementalCompiler& compiler,
+                            const string& src, ThreadPool* pool = nullptr)
+{
+  stringstream in(src);
+  ASTParser parser(Lexer(in, compiler.symbols()), pool);
+  parser.set_fingerprinting(true);
+  return parser.parse();
+}
+
+// compile the source with the compiler and return what it prints
+string run_incrementally(IncrementalCompiler& compiler, const string& src,
+                         ThreadPool* pool = nullptr)
+{
+  Program p = parse_fingerprinted(compiler, src, pool);
+  VM vm;
+  compiler.compile(p, vm, pool);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  return out.str();
+}
+
+TEST(BasicIncrementalTest, RecompilesOnlyChangedFunctions) {
+  IncrementalCompiler compiler;
+  string v1 = build_string({
+      "int f(int x) {", "  return x + 1", "}",
+      "int g(int x) {", "  return x * 2", "}",
+      "void main() {", "  print(f(1) + g(2))", "}"});
+  EXPECT_EQ("6", run_incrementally(compiler, v1));
+  EXPECT_EQ(3, compiler.recompiled());
+  EXPECT_EQ("6", run_incrementally(compiler, v1));
+  EXPECT_EQ(0, compiler.recompiled());
+  string v2 = build_string({
+      "int f(int x) {", "  return x + 10", "}",
+      "int g(int x) {", "  return x * 2", "}",
+      "void main() {", "  print(f(1) + g(2))", "}"});
+  EXPECT_EQ("15", run_incrementally(compiler, v2));
+  EXPECT_EQ(1, compiler.recompiled());
+}
+
+TEST(BasicIncrementalTest, SignatureChangeRecompilesCallers) {
+  IncrementalCompiler compiler;
+  run_incrementally(compiler, build_string({
+      "int f(int x) {", "  return x", "}",
+      "int g() {", "  return 1", "}",
+      "void main() {", "  print(f(2))", "}"}));
+  string v2 = build_string({
+      "double f(int x) {", "  return 2.5", "}",
+      "int g() {", "  return 1", "}",
+      "void main() {", "  print(f(2))", "}"});
+  EXPECT_EQ("2.500000", run_incrementally(compiler, v2));
+  EXPECT_EQ(2, compiler.recompiled());
+  // a caller that no longer type checks is still caught
+  IncrementalCompiler other;
+  run_incrementally(other, build_string({
+      "int f() {", "  return 1", "}",
+      "void main() {", "  int x = f()", "}"}));
+  Program p = parse_fingerprinted(other, build_string({
+      "double f() {", "  return 1.0", "}",
+      "void main() {", "  int x = f()", "}"}));
+  VM vm;
+  try {
+    other.compile(p, vm);
+    FAIL();
+  } catch (MyPLException& ex) {
+    EXPECT_TRUE(string(ex.what()).starts_with("Static Error:"));
+  }
+}
+
+TEST(BasicIncrementalTest, NestedStructChangeRecompilesUsers) {
+  IncrementalCompiler compiler;
+  auto source = [](const string& y_type) {
+    return build_string({
+        "struct P {", "  int x, " + y_type + " y", "}",
+        "struct Q {", "  P p", "}",
+        "int k(Q q) {", "  int v = q.p.y", "  return v", "}",
+        "void main() {", "  Q q = new Q", "  q.p = new P",
+        "  q.p.y = 2", "  print(k(q))", "}"});
+  };
+  EXPECT_EQ("2", run_incrementally(compiler, source("int")));
+  // k only names Q, but reaches P's field through it
+  Program p = parse_fingerprinted(compiler, source("string"));
+  VM vm;
+  try {
+    compiler.compile(p, vm);
+    FAIL();
+  } catch (MyPLException& ex) {
+    EXPECT_TRUE(string(ex.what()).starts_with("Static Error: type mismatch"));
+  }
+}
+
+TEST(BasicIncrementalTest, SaveThenLoad) {
+  string path = testing::TempDir() + "mypl_incremental_test_" +
+    to_string(getpid());
+  string src = build_string({
+      "struct S {", "  int v", "}",
+      "int f(S s) {", "  return s.v", "}",
+      "void main() {", "  S s = new S", "  s.v = 3", "  print(f(s))", "}"});
+  IncrementalCompiler compiler;
+  EXPECT_FALSE(compiler.load(path));
+  EXPECT_EQ("3", run_incrementally(compiler, src));
+  compiler.save(path);
+  IncrementalCompiler restored;
+  EXPECT_TRUE(restored.load(path));
+  EXPECT_EQ("3", run_incrementally(restored, src));
+  EXPECT_EQ(0, restored.recompiled());
+  // changing the struct recompiles the functions that name it
+  string changed = build_string({
+      "struct S {", "  double w, int v", "}",
+      "int f(S s) {", "  return s.v", "}",
+      "void main() {", "  S s = new S", "  s.v = 3", "  print(f(s))", "}"});
+  EXPECT_EQ("3", run_incrementally(restored, changed));
+  EXPECT_EQ(2, restored.recompiled());
+  filesystem::remove(path);
+}
+
+TEST(BasicIncrementalTest, SaveReferringToBytecode) {
+  string path = testing::TempDir() + "mypl_incremental_ref_" +
+    to_string(getpid());
+  string image = path + BYTECODE_EXT;
+  string src = build_string({
+      "int f(int x) {", "  return x + 1", "}",
+      "void main() {", "  print(f(1))", "}"});
+  IncrementalCompiler compiler;
+  Program p = parse_fingerprinted(compiler, src);
+  VM vm;
+  compiler.compile(p, vm);
+  Bytecode::write(vm, image);
+  compiler.save(path, image);
+  // only the fingerprints are in the state file
+  EXPECT_LT(filesystem::file_size(path), filesystem::file_size(image));
+  IncrementalCompiler restored;
+  EXPECT_TRUE(restored.load(path));
+  EXPECT_EQ("2", run_incrementally(restored, src));
+  EXPECT_EQ(0, restored.recompiled());
+  // without the bytecode there is no saved state
+  filesystem::remove(image);
+  IncrementalCompiler missing;
+  EXPECT_FALSE(missing.load(path));
+  EXPECT_EQ("2", run_incrementally(missing, src));
+  EXPECT_EQ(2, missing.recompiled());
+  filesystem::remove(path);
+}
+
+TEST(BasicIncrementalTest, MovedFunctionKeepsItsLines) {
+  IncrementalCompiler compiler;
+  string v1 = build_string({
+      "int f(int x) {", "  return x / 0", "}",
+      "void main() {", "  print(f(1))", "}"});
+  string v2 = build_string({
+      "", "", "int f(int x) {", "  return x / 0", "}",
+      "void main() {", "  print(f(1))", "}"});
+  Program p1 = parse_fingerprinted(compiler, v1);
+  VM vm1;
+  compiler.compile(p1, vm1);
+  EXPECT_EQ(2, vm1.frames().at("f").line(1));
+  Program p2 = parse_fingerprinted(compiler, v2);
+  VM vm2;
+  compiler.compile(p2, vm2);
+  EXPECT_EQ(0, compiler.recompiled());
+  EXPECT_EQ(4, vm2.frames().at("f").line(1));
+  // a blank line inside a function recompiles it
+  string v3 = build_string({
+      "", "", "int f(int x) {", "", "  return x / 0", "}",
+      "void main() {", "  print(f(1))", "}"});
+  Program p3 = parse_fingerprinted(compiler, v3);
+  VM vm3;
+  compiler.compile(p3, vm3);
+  EXPECT_EQ(1, compiler.recompiled());
+  EXPECT_EQ(5, vm3.frames().at("f").line(1));
+}
+
+TEST(BasicIncrementalTest, CommentsOutsideDefinitionsKeepFunctions) {
+  IncrementalCompiler compiler;
+  string v1 = build_string({
+      "int f(int x) {", "  return x + 1", "}",
+      "void main() {", "  print(f(1))", "}"});
+  string v2 = build_string({
+      "int f(int x) {", "  return x + 1", "}  # one more",
+      "void main() {", "  print(f(1))", "}"});
+  EXPECT_EQ("2", run_incrementally(compiler, v1));
+  EXPECT_EQ("2", run_incrementally(compiler, v2));
+  EXPECT_EQ(0, compiler.recompiled());
+  // unfingerprinted programs are compiled in full
+  stringstream in(v2);
+  Program p = ASTParser(Lexer(in, compiler.symbols())).parse();
+  VM vm;
+  compiler.compile(p, vm);
+  EXPECT_EQ(2, compiler.recompiled());
+}
+
+TEST(BasicIncrementalTest, SkipsSavingUnchangedState) {
+  string path = testing::TempDir() + "mypl_incremental_unchanged_" +
+    to_string(getpid());
+  string src = build_string({
+      "int f(int x) {", "  return x + 1", "}",
+      "void main() {", "  print(f(1))", "}"});
+  IncrementalCompiler compiler;
+  run_incrementally(compiler, src);
+  compiler.save(path);
+  ASSERT_TRUE(filesystem::exists(path));
+  IncrementalCompiler restored;
+  EXPECT_TRUE(restored.load(path));
+  filesystem::remove(path);
+  run_incrementally(restored, src);
+  restored.save(path);
+  EXPECT_FALSE(filesystem::exists(path));
+  // moving a function changes its line table, so it is saved
+  run_incrementally(restored, "\n" + src);
+  restored.save(path);
+  EXPECT_TRUE(filesystem::exists(path));
+  filesystem::remove(path);
+}
+
+TEST(BasicIncrementalTest, RecompilesInParallel) {
+  ThreadPool pool(4);
+  IncrementalCompiler compiler;
+  vector<string> lines;
+  for (int i = 0; i < 20; ++i) {
+    lines.push_back("int f" + to_string(i) + "(int x) {");
+    lines.push_back("  return x + " + to_string(i));
+    lines.push_back("}");
+  }
+  lines.push_back("void main() {");
+  lines.push_back("  print(f3(1) + f17(2))");
+  lines.push_back("}");
+  auto source = [&]() {
+    string src = "";
+    for (const string& line : lines)
+      src += line + "\n";
+    return src;
+  };
+  EXPECT_EQ("23", run_incrementally(compiler, source(), &pool));
+  EXPECT_EQ(21, compiler.recompiled());
+  lines[10] = "  return x + 30";
+  EXPECT_EQ("50", run_incrementally(compiler, source(), &pool));
+  EXPECT_EQ(1, compiler.recompiled());
+  // the error reported is the first in program order
+  lines[10] = "  return y";
+  lines[52] = "  return z";
+  IncrementalCompiler other;
+  Program p = parse_fingerprinted(other, source(), &pool);
+  VM vm;
+  try {
+    other.compile(p, vm, &pool);
+    FAIL();
+  } catch (MyPLException& ex) {
+    EXPECT_NE(string::npos, string(ex.what()).find("line 11"));
+  }
+}
+
+//----------------------------------------------------------------------
+// program_generator.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicProgramGeneratorTest, SameSeedSameProgram) {
+  ProgramGenerator::Shape shape;
+  shape.functions = 10;
+  shape.structs = 2;
+  string p1 = ProgramGenerator(shape, 7).generate();
+  EXPECT_EQ(p1, ProgramGenerator(shape, 7).generate());
+  EXPECT_NE(p1, ProgramGenerator(shape, 8).generate());
+}
+
+TEST(BasicProgramGeneratorTest, GeneratedProgramsCheckAndRun) {
+  ProgramGenerator::Shape shape;
+  shape.functions = 12;
+  shape.structs = 3;
+  shape.depth = 2;
+  for (unsigned seed = 1; seed <= 5; ++seed) {
+    stringstream in(ProgramGenerator(shape, seed).generate());
+    Program p = ASTParser(Lexer(in)).parse();
+    SemanticChecker checker;
+    p.accept(checker);
+    VM vm;
+    CodeGenerator generator(vm);
+    p.accept(generator);
+    stringstream out;
+    change_cout(out);
+    vm.run();
+    restore_cout();
+    EXPECT_NE("", out.str());
+  }
+}
+
+//----------------------------------------------------------------------
+// vm.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicVMTest, CountsExecutedInstructions) {
+  VM vm;
+  VMFrameInfo main {};
+  main.function_name = "main";
+  main.instructions.push_back(VMInstr::PUSH(false));
+  main.instructions.push_back(VMInstr::JMPF(3));
+  main.instructions.push_back(VMInstr::NOP());
+  main.instructions.push_back(VMInstr::NOP());
+  vm.add(main);
+  EXPECT_EQ(0, vm.instruction_count());
+  vm.run();
+  // (skips the first nop)
+  EXPECT_EQ(3, vm.instruction_count());
+}
+
+TEST(BasicVMTest, KeepsRunStats) {
+  stringstream in(build_string({
+        "struct P {",
+        "  int x",
+        "}",
+        "int f(int n) {",
+        "  if (n == 0) {",
+        "    return 0",
+        "  }",
+        "  P p = new P",
+        "  return 1 + f(n - 1)",
+        "}",
+        "void main() {",
+        "  array int xs = new int[4]",
+        "  print(concat(\"ab\", to_string(f(3))))",
+        "}"
+      }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  EXPECT_EQ("ab3", out.str());
+  const VMStats& stats = vm.stats();
+  EXPECT_EQ(vm.instruction_count(), stats.instructions);
+  EXPECT_EQ(5, stats.calls);
+  EXPECT_EQ(5, stats.max_call_depth);
+  EXPECT_GE(stats.max_operand_depth, 2);
+  EXPECT_EQ(3, stats.struct_objects);
+  EXPECT_GT(stats.struct_bytes, 0);
+  EXPECT_EQ(1, stats.array_objects);
+  EXPECT_GE(stats.array_bytes, 4 * sizeof(VMValue));
+  // "3" from to_string and "ab3" from concat
+  EXPECT_EQ(4, stats.string_bytes);
+  vm.add_phase_time("check", 5000);
+  vm.add_phase_time("run", 2000);
+  vm.add_phase_time("check", 1000);
+  ASSERT_EQ(2, stats.phase_ns.size());
+  EXPECT_EQ("check", stats.phase_ns[0].first);
+  EXPECT_EQ(6000, stats.phase_ns[0].second);
+  stringstream report;
+  stats.report(report);
+  EXPECT_NE(string::npos, report.str().find("  calls     "));
+  EXPECT_NE(string::npos, report.str().find("  check     "));
+}
+
+TEST(BasicVMTest, DebugHooksAndBreakpoints) {
+  stringstream in(build_string({
+        "int f(int x) {",
+        "  int y = x * 2",
+        "  return y",
+        "}",
+        "void main() {",
+        "  print(f(3) + f(4))",
+        "}"
+      }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  int steps = 0;
+  vm.set_step_hook([&](const VMFrame&, const VMInstr&) {
+    ++steps;
+  });
+  // the RET of f, once y is stored
+  vector<string> dumps;
+  vm.add_breakpoint("f", 6);
+  vm.set_break_hook([&](const VMFrame& frame, const VMInstr& instr) {
+    EXPECT_EQ(OpCode::RET, instr.opcode());
+    dumps.push_back(vm.dump(frame));
+  });
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  EXPECT_EQ("14", out.str());
+  EXPECT_EQ(vm.instruction_count(), steps);
+  ASSERT_EQ(2, dumps.size());
+  EXPECT_EQ("frame f at 6 (line 3): RET()\n  operands: 6\n"
+            "  variables: 0=3 1=6\n", dumps[0]);
+  // without hooks or breakpoints a run skips the checks
+  vm.set_step_hook(nullptr);
+  vm.clear_breakpoints();
+  steps = 0;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  EXPECT_EQ(0, steps);
+  EXPECT_EQ(2, dumps.size());
+}
+
+//----------------------------------------------------------------------
+// profiler.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicProfilerTest, CountsCallsAndInstructions) {
+  stringstream in(build_string({
+        "int f(int x) {",
+        "  return x + 1",
+        "}",
+        "void main() {",
+        "  int y = 0",
+        "  for (int i = 0; i < 3; i = i + 1) {",
+        "    y = f(y)",
+        "  }",
+        "  print(y)",
+        "}"
+      }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  Profiler profiler;
+  vm.set_profiler(&profiler);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  EXPECT_EQ("3", out.str());
+  stringstream json;
+  profiler.write_json(json);
+  EXPECT_NE(string::npos, json.str().find("{\"name\": \"f\", \"calls\": 3"));
+  EXPECT_NE(string::npos, json.str().find("\"callee\": \"f\", \"count\": 3"));
+  EXPECT_NE(string::npos, json.str().find("\"CALL\": 3"));
+  stringstream report;
+  profiler.report(report, vm);
+  EXPECT_NE(string::npos, report.str().find("main:"));
+  EXPECT_NE(string::npos, report.str().find("-> f"));
+}
+
+TEST(BasicProfilerTest, CountsSourceLines) {
+  string src = build_string({
+        "void main() {",
+        "  int y = 0",
+        "  for (int i = 0; i < 3; i = i + 1) {",
+        "    y = y + 2",
+        "  }",
+        "  print(y)",
+        "}"
+      });
+  stringstream in(src);
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  Profiler profiler;
+  vm.set_profiler(&profiler);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  profiler.finish();
+  EXPECT_EQ("6", out.str());
+  // y = y + 2 is LOAD, PUSH, ADD, STORE run three times
+  stringstream json;
+  profiler.write_json(json);
+  EXPECT_NE(string::npos, json.str().find("{\"line\": 4, \"count\": 12,"));
+  stringstream annotated;
+  profiler.annotate(annotated, src);
+  vector<string> rows;
+  string row;
+  while (getline(annotated, row))
+    rows.push_back(row);
+  // a header, then each source line
+  ASSERT_EQ(8, rows.size());
+  EXPECT_TRUE(rows[4].starts_with("          12"));
+  EXPECT_TRUE(rows[4].ends_with("      4      y = y + 2"));
+  EXPECT_TRUE(rows[5].starts_with("            "));
+}
+
+//----------------------------------------------------------------------
+// sampler.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicSamplerTest, FoldsSampledStacks) {
+  VMFrameInfo main_info {};
+  main_info.function_name = "main";
+  VMFrameInfo f_info {};
+  f_info.function_name = "f";
+  f_info.arg_count = 1;
+  int main_pc = 3;
+  int f_pc = 0;
+  Sampler sampler;
+  sampler.push(&main_info, &main_pc);
+  sampler.sample();
+  sampler.push(&f_info, &f_pc);
+  sampler.sample();
+  f_pc = 2;
+  sampler.sample();
+  sampler.pop();
+  sampler.pop();
+  sampler.sample();
+  stringstream out;
+  sampler.write_folded(out);
+  EXPECT_EQ("main 1\nmain;f 2\n", out.str());
+  f_info.lines = {{0, 5, 3}, {2, 6, 3}};
+  stringstream lines;
+  sampler.write_folded(lines, true);
+  // (the sampled pcs are of the instructions after the running ones)
+  EXPECT_EQ("main 1\nmain;f 1\nmain;f:5 1\n", lines.str());
+  EXPECT_EQ(3, sampler.sample_count());
+  EXPECT_EQ(0, sampler.dropped());
+}
+
+TEST(BasicSamplerTest, SamplesRunningProgram) {
+  stringstream in(build_string({
+        "int f(int x) {",
+        "  int y = 0",
+        "  for (int i = 0; i < x; i = i + 1) {",
+        "    y = y + i",
+        "  }",
+        "  return y",
+        "}",
+        "void main() {",
+        "  print(f(20000))",
+        "}"
+      }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  Sampler sampler(1000);
+  vm.set_sampler(&sampler);
+  stringstream out;
+  change_cout(out);
+  sampler.start();
+  vm.run();
+  sampler.stop();
+  restore_cout();
+  EXPECT_EQ("199990000", out.str());
+  EXPECT_GT(sampler.sample_count(), 0);
+  stringstream folded;
+  sampler.write_folded(folded);
+  EXPECT_NE(string::npos, folded.str().find("main;f "));
+}
+
+TEST(BasicSamplerTest, UnwindsAfterFailedCall) {
+  stringstream in(build_string({
+        "char at(string s, int i) {",
+        "  return get(i, s)",
+        "}",
+        "int fail(string s) {",
+        "  char c = at(s, 10)",
+        "  return 0",
+        "}",
+        "int sum(int x) {",
+        "  int y = 0",
+        "  for (int i = 0; i < x; i = i + 1) {",
+        "    y = y + i",
+        "  }",
+        "  return y",
+        "}",
+        "void main() {",
+        "}"
+      }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  Sampler sampler(1000);
+  Tracer tracer;
+  vm.set_sampler(&sampler);
+  vm.set_tracer(&tracer);
+  sampler.start();
+  EXPECT_THROW(vm.call("fail", {string("abc")}), MyPLException);
+  // the frames of fail and at are no longer on the observers' stacks
+  EXPECT_EQ(0, sampler.depth());
+  EXPECT_EQ(0, tracer.depth());
+  EXPECT_EQ(199990000, get<int>(vm.call("sum", {20000})));
+  sampler.stop();
+  EXPECT_EQ(0, tracer.depth());
+  stringstream folded;
+  sampler.write_folded(folded);
+  // (sum's samples aren't stacked on the failed call's frames)
+  EXPECT_EQ(string::npos, folded.str().find("at;sum"));
+}
+
+//----------------------------------------------------------------------
+// tracer.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicTracerTest, LogsPhasesAndCalls) {
+  stringstream in(build_string({
+        "int f(int x) {",
+        "  return x + 1",
+        "}",
+        "void main() {",
+        "  print(f(f(1)))",
+        "}"
+      }));
+  Tracer tracer;
+  VM vm;
+  vm.set_tracer(&tracer);
+  {
+    Tracer::Phase compiling(&tracer, "compile");
+    CodeGenerator generator(vm);
+    ASTParser(Lexer(in)).parse().accept(generator);
+  }
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  tracer.finish();
+  EXPECT_EQ("3", out.str());
+  // a phase, main, and two calls of f, each starting and ending
+  EXPECT_EQ(8, tracer.event_count());
+  stringstream json;
+  tracer.write_json(json);
+  string text = json.str();
+  EXPECT_TRUE(text.starts_with("{\"displayTimeUnit\": \"ns\", "
+                               "\"traceEvents\": ["));
+  EXPECT_NE(string::npos, text.find("{\"name\": \"compile\", \"cat\": "
+                                    "\"phase\", \"ph\": \"X\""));
+  EXPECT_NE(string::npos, text.find("{\"name\": \"main\", \"cat\": "
+                                    "\"call\""));
+  size_t first = text.find("\"name\": \"f\"");
+  ASSERT_NE(string::npos, first);
+  EXPECT_NE(string::npos, text.find("\"name\": \"f\"", first + 1));
+  // calls shorter than the minimum are left out (but not phases)
+  stringstream filtered;
+  tracer.write_json(filtered, UINT64_MAX);
+  EXPECT_EQ(string::npos, filtered.str().find("\"cat\": \"call\""));
+  EXPECT_NE(string::npos, filtered.str().find("\"name\": \"compile\""));
+}
+
+TEST(BasicTracerTest, ClosesCallsAfterError) {
+  VM vm;
+  VMFrameInfo main {};
+  main.function_name = "main";
+  main.instructions.push_back(VMInstr::PUSH(nullptr));
+  main.instructions.push_back(VMInstr::PUSH(1));
+  main.instructions.push_back(VMInstr::ADD());
+  vm.add(main);
+  Tracer tracer;
+  vm.set_tracer(&tracer);
+  EXPECT_THROW(vm.run(), MyPLException);
+  tracer.finish();
+  EXPECT_EQ(2, tracer.event_count());
+  stringstream json;
+  tracer.write_json(json);
+  EXPECT_NE(string::npos, json.str().find("\"name\": \"main\""));
+}
+
+//----------------------------------------------------------------------
+// perf_map.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicPerfMapTest, RunsCallsThroughTrampolines) {
+  if (!PerfMap::supported())
+    GTEST_SKIP();
+  stringstream in(build_string({
+        "int fib(int n) {",
+        "  if (n < 2) {",
+        "    return n",
+        "  }",
+        "  return fib(n - 1) + fib(n - 2)",
+        "}",
+        "int fail(int n) {",
+        "  return n + null",
+        "}",
+        "void main() {",
+        "  print(fib(15))",
+        "  print(fail(1))",
+        "}"
+      }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  string path;
+  {
+    PerfMap perf_map;
+    path = perf_map.path();
+    vm.set_perf_map(&perf_map);
+    stringstream out;
+    change_cout(out);
+    // an error in a nested call still reaches the caller of run
+    try {
+      vm.run();
+      FAIL();
+    } catch (MyPLException& ex) {
+      EXPECT_TRUE(string(ex.what()).starts_with("VM Error: null reference"));
+    }
+    restore_cout();
+    EXPECT_EQ("610", out.str());
+    vm.set_perf_map(nullptr);
+  }
+  // a line naming each function that ran
+  ifstream map(path);
+  vector<string> names;
+  string start, size, name;
+  while (map >> start >> size >> name)
+    names.push_back(name);
+  EXPECT_EQ(vector<string>({"mypl::main", "mypl::fib", "mypl::fail"}), names);
+  filesystem::remove(path);
+}
+
+TEST(BasicPerfMapTest, DeepRecursionRunsInTheCallersLoop) {
+  if (!PerfMap::supported())
+    GTEST_SKIP();
+  stringstream in(build_string({
+        "int depth(int n) {",
+        "  if (n == 0) {",
+        "    return 0",
+        "  }",
+        "  return 1 + depth(n - 1)",
+        "}",
+        "void main() {",
+        "  print(depth(100000))",
+        "}"
+      }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  PerfMap perf_map;
+  string path = perf_map.path();
+  vm.set_perf_map(&perf_map);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  vm.set_perf_map(nullptr);
+  EXPECT_EQ("100000", out.str());
+  filesystem::remove(path);
+}
+
+//----------------------------------------------------------------------
+// perf_counters.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicPerfCountersTest, CountsEachFunction) {
+  stringstream in(build_string({
+        "int f(int x) {",
+        "  int y = 0",
+        "  for (int i = 0; i < x; i = i + 1) {",
+        "    y = y + i",
+        "  }",
+        "  return y",
+        "}",
+        "void main() {",
+        "  print(f(20000) + f(10))",
+        "}"
+      }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  // (whichever counters the host allows)
+  PerfCounters counters;
+  ASSERT_FALSE(counters.names().empty());
+  vm.set_counters(&counters);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  EXPECT_EQ("199990045", out.str());
+  vector<uint64_t> f = counters.counts("f");
+  ASSERT_EQ(counters.names().size(), f.size());
+  EXPECT_GT(f[0], 0);
+  EXPECT_GT(f[0], counters.counts("main")[0]);
+  EXPECT_TRUE(counters.counts("g").empty());
+  stringstream report;
+  counters.report(report);
+  EXPECT_NE(string::npos, report.str().find("           2"));
+  EXPECT_NE(string::npos, report.str().find("  f\n"));
+}
+
+//----------------------------------------------------------------------
+// heap_profiler.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicHeapProfilerTest, TalliesSitesAndTypes) {
+  stringstream in(build_string({
+        "struct Node {",
+        "  int val,",
+        "  Node next",
+        "}",
+        "Node push(Node head, int val) {",
+        "  Node n = new Node",
+        "  n.val = val",
+        "  n.next = head",
+        "  return n",
+        "}",
+        "void main() {",
+        "  Node head = null",
+        "  for (int i = 0; i < 10; i = i + 1) {",
+        "    head = push(head, i)",
+        "  }",
+        "  array int xs = new int[5]",
+        "  print(head.val)",
+        "}"
+      }));
+  VM vm;
+  CodeGenerator generator(vm);
+  ASTParser(Lexer(in)).parse().accept(generator);
+  EXPECT_EQ("ALLOCS(Node)", to_string(vm.frames().at("push").instructions[2],
+                                      vm.symbols().get()));
+  HeapProfiler heap;
+  vm.set_heap_profiler(&heap);
+  stringstream out;
+  change_cout(out);
+  vm.run();
+  restore_cout();
+  EXPECT_EQ("9", out.str());
+  // the first object is the first node
+  EXPECT_EQ("push:2", heap.site(2023));
+  EXPECT_EQ("main:", heap.site(2033).substr(0, 5));
+  EXPECT_EQ("", heap.site(2034));
+  EXPECT_GT(heap.total_bytes(), 0);
+  EXPECT_EQ(heap.total_bytes(), heap.live_bytes());
+  stringstream report;
+  heap.report(report);
+  EXPECT_NE(string::npos, report.str().find("Heap: 11 objects"));
+  EXPECT_NE(string::npos, report.str().find("  push:2 (line 6) Node\n"));
+  EXPECT_NE(string::npos, report.str().find("          10"));
+  EXPECT_NE(string::npos, report.str().find("  array\n"));
+  heap.free(2023);
+  EXPECT_EQ("", heap.site(2023));
+  EXPECT_LT(heap.live_bytes(), heap.total_bytes());
+  heap.free_all();
+  EXPECT_EQ(0, heap.live_bytes());
+  EXPECT_GT(heap.total_bytes(), 0);
+}
+
+//----------------------------------------------------------------------
+// module.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicModuleTest, CallsFunctionsRepeatedly) {
+  VM vm;
+  Module::compile(vm, build_string({
+        "struct Box {",
+        "  int n",
+        "}",
+        "int score(int x, string s) {",
+        "  return (x * 10) + length(s)",
+        "}",
+        "Box box(int n) {",
+        "  Box b = new Box",
+        "  b.n = n",
+        "  return b",
+        "}",
+        "int unbox(Box b) {",
+        "  return b.n",
+        "}",
+        "void main() {",
+        "}"
+      }));
+  VM::Function score = vm.lookup("score");
+  for (int i = 0; i < 100; ++i)
+    EXPECT_EQ(i * 10 + 3, get<int>(vm.call(score, {i, string("abc")})));
+  EXPECT_EQ(100, vm.stats().calls);
+  // objects stay on the heap between calls (until it is reset)
+  VMValue b = vm.call("box", {7});
+  EXPECT_EQ(2023, get<int>(b));
+  EXPECT_EQ(7, get<int>(vm.call("unbox", {b})));
+  vm.reset_heap();
+  EXPECT_EQ(2023, get<int>(vm.call("box", {8})));
+  EXPECT_EQ(8, get<int>(vm.call("unbox", {b})));
+  EXPECT_TRUE(holds_alternative<nullptr_t>(vm.call("main", {})));
+  EXPECT_THROW(vm.lookup("nope"), MyPLException);
+  EXPECT_THROW(vm.call(score, {1}), MyPLException);
+}
+
+TEST(BasicModuleTest, RecoversFromErrors) {
+  VM vm;
+  Module::compile(vm, build_string({
+        "int f(int x) {",
+        "  char c = get(x, \"abcdef\")",
+        "  return x",
+        "}",
+        "int g(int x) {",
+        "  return f(x) + 1",
+        "}"
+      }));
+  EXPECT_EQ(3, get<int>(vm.call("g", {2})));
+  EXPECT_THROW(vm.call("g", {10}), MyPLException);
+  // (the failed call's frames are gone)
+  EXPECT_EQ(6, get<int>(vm.call("g", {5})));
+}
+
+TEST(BasicModuleTest, LoadsScriptsAndBytecode) {
+  string path = filesystem::temp_directory_path() / "mypl_module_test.mypl";
+  {
+    ofstream out(path);
+    out << "int twice(int x) {\n  return 2 * x\n}\n";
+  }
+  VM vm;
+  Module::load(vm, path);
+  EXPECT_EQ(42, get<int>(vm.call("twice", {21})));
+  string compiled = path + "c";
+  Bytecode::write(vm, compiled);
+  VM loaded;
+  Module::load(loaded, compiled);
+  EXPECT_EQ(8, get<int>(loaded.call("twice", {4})));
+  filesystem::remove(path);
+  filesystem::remove(compiled);
+  EXPECT_THROW(Module::load(vm, path), MyPLException);
+}
+
+TEST(BasicModuleTest, SharesCodeBetweenIsolates) {
+  shared_ptr<const Module> module = Module::compile(build_string({
+        "struct Node {",
+        "  int val,",
+        "  Node next",
+        "}",
+        "int sum(int n) {",
+        "  Node head = null",
+        "  for (int i = 1; i <= n; i = i + 1) {",
+        "    Node node = new Node",
+        "    node.val = i",
+        "    node.next = head",
+        "    head = node",
+        "  }",
+        "  int total = 0",
+        "  while (head != null) {",
+        "    total = total + head.val",
+        "    head = head.next",
+        "  }",
+        "  return total",
+        "}"
+      }));
+  ASSERT_TRUE(module->frames().contains("sum"));
+  vector<thread> threads;
+  vector<int> failures(8, 0);
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t]() {
+      VM isolate(module);
+      VM::Function sum = isolate.lookup("sum");
+      for (int i = 0; i < 20; ++i) {
+        int n = t + i;
+        if (get<int>(isolate.call(sum, {n})) != n * (n + 1) / 2)
+          ++failures[t];
+        isolate.reset_heap();
+      }
+    });
+  }
+  for (thread& t : threads)
+    t.join();
+  EXPECT_EQ(vector<int>(8, 0), failures);
+  // (the shared code can't change)
+  VM isolate(module);
+  VMFrameInfo f {};
+  f.function_name = "f";
+  EXPECT_THROW(isolate.add(f), MyPLException);
+}
+
+TEST(BasicModuleTest, SharingGeneratesStubs) {
+  stringstream in(build_string({
+        "int twice(int x) {",
+        "  return x * 2",
+        "}",
+        "void main() {",
+        "  print(twice(21))",
+        "}"
+      }));
+  auto p = make_shared<Program>(ASTParser(Lexer(in)).parse());
+  auto checker = make_shared<SemanticChecker>();
+  checker->declare(*p);
+  VM vm;
+  CodeGenerator::generate_lazily(p, vm, checker);
+  ASSERT_TRUE(vm.frames().at("twice").stub);
+  shared_ptr<const Module> module = vm.module();
+  EXPECT_FALSE(module->frames().at("twice").stub);
+  EXPECT_EQ(module, vm.module());
+  VMFrameInfo f {};
+  f.function_name = "f";
+  EXPECT_THROW(vm.add(f), MyPLException);
+  VM isolate(module);
+  stringstream out;
+  change_cout(out);
+  isolate.run();
+  restore_cout();
+  EXPECT_EQ("42", out.str());
+}
+
+TEST(BasicModuleTest, DroppedModulesFreeTheirSymbols) {
+  shared_ptr<const Module> module = Module::compile(
+    "int a_long_forgotten_name() { return 1 }");
+  weak_ptr<Interner> symbols = module->symbols();
+  {
+    VM isolate(module);
+    EXPECT_EQ(1, get<int>(isolate.call("a_long_forgotten_name", {})));
+  }
+  module = nullptr;
+  // (so a server dropping a module past MAX_MODULES drops its names)
+  EXPECT_TRUE(symbols.expired());
+}
+
+//----------------------------------------------------------------------
+// server.cpp Tests
+//----------------------------------------------------------------------
+
+TEST(BasicServerTest, RunsJobsFromClients) {
+  string path = testing::TempDir() + "mypl_server_" + to_string(getpid());
+  Server server(path, 4);
+  thread serving([&]() { server.serve(); });
+  Server::Job job;
+  job.source = build_string({
+      "void main() {",
+      "  string name = input()",
+      "  print(concat(\"hi \", name))",
+      "}"
+    });
+  vector<thread> clients;
+  vector<string> outputs(8);
+  vector<int> statuses(8, -1);
+  for (int i = 0; i < 8; ++i) {
+    clients.emplace_back([&, i]() {
+      Server::Job mine = job;
+      mine.input = "client " + to_string(i) + "\n";
+      stringstream out, err;
+      statuses[i] = Server::submit(path, mine, out, err);
+      outputs[i] = out.str() + err.str();
+    });
+  }
+  for (thread& t : clients)
+    t.join();
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(0, statuses[i]);
+    EXPECT_EQ("hi client " + to_string(i), outputs[i]);
+  }
+  // (the program was compiled once, unless two clients raced)
+  EXPECT_LE(server.compile_count(), 4);
+  // errors come back on the error stream with a failing status
+  Server::Job bad;
+  bad.source = "void main() {\n  print(get(5, \"abc\"))\n}\n";
+  stringstream out, err;
+  EXPECT_EQ(1, Server::submit(path, bad, out, err));
+  EXPECT_EQ("", out.str());
+  EXPECT_NE(string::npos, err.str().find("out-of-bounds"));
+  EXPECT_EQ(9, server.job_count());
+  // (a second server can't take over the socket)
+  EXPECT_THROW(Server(path, 1), MyPLException);
+  server.stop();
+  serving.join();
+  EXPECT_THROW(Server::submit(path, job, out, err), MyPLException);
+}
+
 //----------------------------------------------------------------------
 // main
 //----------------------------------------------------------------------